@@ -0,0 +1,145 @@
+/*
+ * Compare loading a plot of tree files one after another with the batch loader.
+ * Usage: bench_batch_load [--files N] [--nodes N] [--in-flight N] [directory]
+ * Without a directory a plot of 500 synthetic trees of 20000 nodes (--files, --nodes) is
+ * written to /tmp. The files are loaded and their branches extracted sequentially, then
+ * with CTreeBatchLoader on 1, 2, 4, ... up to the hardware threads. Every batch tree is
+ * checked to be identical to the sequential one, nodes and branches, and the program fails
+ * if one differs. The wall time of every run is reported with its bound: the total bytes
+ * over the threads times the sequential bytes per second.
+*/
+
+#include "bench_common.h"
+#include "../cdagtree.h"
+#include "../ctreebatchloader.h"
+#include "../cworkstealingpool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+/*
+ * The graph and the branches of a tree flattened into one array of values,
+ * bitwise for the positions and radii.
+*/
+static vector<int> flatten_tree(const CDAGTree<float>& aTree) {
+    vector<int> values;
+    auto add_floats = [&values](const std::pmr::vector<float>& aValues) {
+        const size_t first = values.size();
+        values.resize(first + aValues.size());
+        memcpy(values.data() + first, aValues.data(), aValues.size() * sizeof(float));
+    };
+    add_floats(aTree.get_node_xs());
+    add_floats(aTree.get_node_ys());
+    add_floats(aTree.get_node_zs());
+    add_floats(aTree.get_node_radii());
+    values.insert(values.end(), aTree.get_parent_indices().begin(), aTree.get_parent_indices().end());
+    for(const auto& bs : aTree.get_branches()) {
+        values.push_back(int(bs.get_branch_nums()));
+        for(const auto& b : bs.get_branch_array()) {
+            values.push_back(b->get_branch_level());
+            values.push_back(int(b->get_branch_nodes_nums()));
+            values.insert(values.end(), b->get_branch_nodes().begin(), b->get_branch_nodes().end());
+        }
+    }
+    return values;
+}
+
+int main(int argc, char** argv) {
+    string directory;
+    long num_files(500), num_nodes(20000);
+    size_t max_in_flight(0);
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--files") == 0 && i + 1 < argc)
+            num_files = max(atol(argv[++i]), 1L);
+        else if(strcmp(argv[i], "--nodes") == 0 && i + 1 < argc)
+            num_nodes = max(atol(argv[++i]), 2L);
+        else if(strcmp(argv[i], "--in-flight") == 0 && i + 1 < argc)
+            max_in_flight = size_t(atol(argv[++i]));
+        else
+            directory = argv[i];
+    }
+    vector<string> file_names;
+    bool is_synthetic = directory.empty();
+    if(is_synthetic) {
+        directory = "/tmp/bench_batch_load_plot";
+        mkdir(directory.c_str(), 0755);
+        for(long f = 0; f < num_files; ++f) {
+            char a_name[64];
+            snprintf(a_name, sizeof(a_name), "/tree%04ld.tree", f);
+            file_names.push_back(directory + a_name);
+            if(!write_random_tree_file(file_names.back(), num_nodes, unsigned(f + 1))) {
+                fprintf(stderr, "ERROR: could not write the synthetic tree %s\n", file_names.back().c_str());
+                return 1;
+            }
+        }
+    } else if(!CTreeBatchLoader::list_tree_files(directory, file_names)) {
+        return 1;
+    }
+
+    // the sequential reference
+    vector<vector<int>> references;
+    size_t num_bytes(0);
+    for(const string& f : file_names) {
+        CDAGTree<float> a_tree;
+        if(!a_tree.load_tree_file(f)) {
+            fprintf(stderr, "ERROR: failed loading the tree file %s\n", f.c_str());
+            return 1;
+        }
+        a_tree.extract_branches();
+        references.push_back(flatten_tree(a_tree));
+        struct stat file_stat;
+        if(stat(f.c_str(), &file_stat) == 0)
+            num_bytes += size_t(file_stat.st_size);
+    }
+    // flattening is not part of the load, so time it again without
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(const string& f : file_names) {
+        CDAGTree<float> a_tree;
+        a_tree.load_tree_file(f);
+        a_tree.extract_branches();
+    }
+    const double sequential_seconds = seconds_since(start);
+    const double sequential_speed = num_bytes / sequential_seconds;
+
+    printf("%s: %zu files, %.1f MB\n", directory.c_str(), file_names.size(), num_bytes * 1e-6);
+    printf("%-10s %10s %10s %10s %10s %10s\n", "threads", "in flight", "wall ms", "MB/s", "bound ms", "result");
+    printf("%-10s %10s %10.1f %10.1f %10.1f %10s\n", "sequential", "1", sequential_seconds*1e3,
+           sequential_speed*1e-6, sequential_seconds*1e3, "reference");
+
+    int exit_code(0);
+    const unsigned max_threads = max(1u, thread::hardware_concurrency());
+    for(unsigned n = 1; ; n = min(2*n, max_threads)) {
+        CWorkStealingPool a_pool(n);
+        CTreeBatchLoader a_loader(max_in_flight);
+        bool is_identical(true);
+        size_t r(0);
+        is_identical = a_loader.load(file_names, a_pool, [&](CTreeBatchResult& aResult) {
+            is_identical = is_identical && aResult.m_tree_ptr && flatten_tree(*aResult.m_tree_ptr) == references[r];
+            ++r;
+        }) && is_identical;
+        start = chrono::steady_clock::now();
+        a_loader.load(file_names, a_pool, [](CTreeBatchResult&) {});
+        const double seconds = seconds_since(start);
+        const size_t in_flight = max_in_flight > 0 ? max_in_flight : 2*size_t(n);
+        printf("%-10u %10zu %10.1f %10.1f %10.1f %10s\n", n, in_flight, seconds*1e3, num_bytes / seconds * 1e-6,
+               num_bytes / (n * sequential_speed) * 1e3, is_identical ? "identical" : "DIFFERENT");
+        if(!is_identical)
+            exit_code = 1;
+        if(n == max_threads)
+            break;
+    }
+
+    if(is_synthetic) {
+        for(const string& f : file_names)
+            remove(f.c_str());
+        rmdir(directory.c_str());
+    }
+    return exit_code;
+}
@@ -0,0 +1,92 @@
+/*
+ * Measure the branch cache: loading a tree and extracting its branches
+ * without the cache, with a cold cache (hash, extract and write the cache file)
+ * and with a warm cache (hash and read the cache file).
+ * Usage: bench_branch_cache [tree files...]
+ * Without arguments the bundled TestData trees are used. The files are copied
+ * to /tmp first so that the cache files are not written next to the originals.
+*/
+
+#include "../cdagtree.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+enum CacheRun {
+    NO_CACHE,
+    COLD_CACHE,
+    WARM_CACHE
+};
+
+/*
+ * Load the file and extract the branches repeatedly until at least aMinSeconds have elapsed.
+ * Returns the average seconds per run, or a negative value on failure.
+*/
+static double time_extract(const string& aFileName, CacheRun aRun, double aMinSeconds, size_t& aNumBranches) {
+    using clock = chrono::steady_clock;
+    int runs(0);
+    double elapsed(0.0);
+    do {
+        CDAGTree<float> a_tree;
+        a_tree.set_branch_cache_enabled(aRun != NO_CACHE);
+        if(aRun == COLD_CACHE)
+            remove((aFileName + TREEBC_FILE_SUFFIX).c_str());
+        clock::time_point start = clock::now();
+        bool is_loaded = a_tree.load_tree_file(aFileName);
+        a_tree.extract_branches();
+        elapsed += chrono::duration<double>(clock::now() - start).count();
+        if(!is_loaded || a_tree.is_branch_cache_hit() != (aRun == WARM_CACHE))
+            return -1.0;
+        aNumBranches = a_tree.get_total_num_of_branches();
+        ++runs;
+    } while(elapsed < aMinSeconds || runs < 3);
+    return elapsed / runs;
+}
+
+int main(int argc, char** argv) {
+    vector<string> file_names;
+    for(int i = 1; i < argc; ++i)
+        file_names.push_back(argv[i]);
+    if(file_names.empty()) {
+        for(int i = 1; i <= 5; ++i)
+            file_names.push_back("TestData/Tree" + to_string(i) + ".tree");
+    }
+
+    const CacheRun runs[] = {NO_CACHE, COLD_CACHE, WARM_CACHE};
+    const char* run_names[] = {"none", "cold", "warm"};
+
+    printf("%-32s %-6s %10s %12s %8s\n", "file", "cache", "branches", "ms/load", "speedup");
+    for(size_t f = 0; f < file_names.size(); ++f) {
+        const string copy_name = "/tmp/bench_branch_cache_" + to_string(f) + ".tree";
+        {
+            ifstream inputs(file_names[f], ios::binary);
+            ofstream outputs(copy_name, ios::binary | ios::trunc);
+            if(!inputs.is_open() || !(outputs << inputs.rdbuf())) {
+                fprintf(stderr, "ERROR: failed copying the tree file %s\n", file_names[f].c_str());
+                return 1;
+            }
+        }
+
+        double none_seconds(0.0);
+        for(int r = 0; r < 3; ++r) {
+            size_t num_branches(0);
+            double seconds = time_extract(copy_name, runs[r], 0.5, num_branches);
+            if(seconds < 0.0) {
+                fprintf(stderr, "ERROR: failed the %s cache run of the tree file %s\n",
+                        run_names[r], file_names[f].c_str());
+                return 1;
+            }
+            if(r == 0)
+                none_seconds = seconds;
+            printf("%-32s %-6s %10zu %12.3f %7.2fx\n", file_names[f].c_str(), run_names[r],
+                   num_branches, seconds*1e3, none_seconds/seconds);
+        }
+        remove(copy_name.c_str());
+        remove((copy_name + TREEBC_FILE_SUFFIX).c_str());
+    }
+    return 0;
+}
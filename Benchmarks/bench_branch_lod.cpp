@@ -0,0 +1,93 @@
+/*
+ * Show how the branch level of detail follows the screen size of the tree.
+ * Usage: bench_branch_lod [--pixel-error E] [tree file]
+ * Without a file a synthetic tree of 10^6 nodes is used. The levels are built once,
+ * then the camera looks at the tree centre from distances of 1 to 256 tree diagonals
+ * through a 600 pixel high viewport with a 60 degree field of view. For every distance
+ * the per-frame selection is timed and the elements it chooses are compared with the
+ * full skeleton. The maximum pixel error defaults to 1.
+ * No OpenGL is needed.
+*/
+
+#include "bench_common.h"
+#include "../cdagtree.h"
+#include "../ctreebranchlod.h"
+#include "../ctreeskeletonarrays.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+int main(int argc, char** argv) {
+    string file_name;
+    float max_pixel_error(1.f);
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--pixel-error") == 0 && i + 1 < argc)
+            max_pixel_error = float(atof(argv[++i]));
+        else
+            file_name = argv[i];
+    }
+    bool is_synthetic = file_name.empty();
+    if(is_synthetic) {
+        file_name = "/tmp/bench_branch_lod_1000000.tree";
+        if(!write_random_tree_file(file_name, 1000000)) {
+            fprintf(stderr, "ERROR: could not write the synthetic tree %s\n", file_name.c_str());
+            return 1;
+        }
+    }
+
+    CDAGTree<float> a_tree;
+    if(!a_tree.load_tree_file(file_name)) {
+        fprintf(stderr, "ERROR: failed loading the tree file %s\n", file_name.c_str());
+        return 1;
+    }
+    a_tree.extract_branches();
+
+    CTreeSkeletonArrays full_arrays;
+    full_arrays.build(a_tree);
+    CTreeBranchLOD a_lod;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    a_lod.build(a_tree);
+    double build_seconds = seconds_since(start);
+
+    // the elements of the full skeleton without the restart indices
+    const size_t full_elements = full_arrays.get_num_elements() + 1 - full_arrays.get_num_strips();
+    printf("%s: %zu nodes, %zu branches, %zu levels, %zu stored elements (full skeleton %zu), built in %.3f ms\n",
+           file_name.c_str(), a_tree.get_total_num_of_nodes(), a_lod.get_num_branches(), a_lod.get_num_levels(),
+           a_lod.get_element_indices().size(), full_elements, build_seconds*1e3);
+
+    CBBox<float> a_box;
+    a_tree.compute_bounding_box(a_box);
+    const Eigen::Vector3f center(0.5f*(a_box.m_x_min + a_box.m_x_max), 0.5f*(a_box.m_y_min + a_box.m_y_max),
+                                 0.5f*(a_box.m_z_min + a_box.m_z_max));
+    const float diagonal = Eigen::Vector3f(a_box.m_x_max - a_box.m_x_min, a_box.m_y_max - a_box.m_y_min,
+                                           a_box.m_z_max - a_box.m_z_min).norm();
+    const float pixel_scale = 600.f / (2.f * tan(float(M_PI) / 6.f));
+
+    printf("%-12s %12s %10s %12s %10s %12s\n", "diagonals", "tree pixels", "strips", "elements", "of full", "select us");
+    vector<uint32_t> firsts;
+    vector<int> counts;
+    for(float d = 1.f; d <= 256.f; d *= 2.f) {
+        const Eigen::Vector3f eye = center + Eigen::Vector3f(0.f, 0.f, d*diagonal);
+        size_t num_elements(0);
+        int runs(0);
+        start = chrono::steady_clock::now();
+        do {
+            firsts.clear();
+            counts.clear();
+            num_elements = a_lod.select(eye, pixel_scale, max_pixel_error, 0, nullptr, firsts, counts);
+            ++runs;
+        } while(seconds_since(start) < 0.2 || runs < 3);
+        double select_seconds = seconds_since(start) / runs;
+        printf("%-12g %12.1f %10zu %12zu %9.1f%% %12.1f\n", d, pixel_scale / d, counts.size(), num_elements,
+               100.0 * double(num_elements) / double(max<size_t>(full_elements, 1)), select_seconds*1e6);
+    }
+
+    if(is_synthetic)
+        remove(file_name.c_str());
+    return 0;
+}
@@ -0,0 +1,121 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+/*
+ * Shared helpers of the benchmark programs:
+ *  a global allocation counter
+ *  a wall clock timer
+ *  a writer of synthetic random-branching tree files (see CTreeGenerator)
+ * The global operator new/delete replacements are defined here, so this header
+ * must be included by exactly one translation unit of a benchmark program.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+#include <string>
+#include <vector>
+
+#include "../ctreegenerator.h"
+
+/*
+ * The number of allocations and allocated bytes since the program started,
+ * and the bytes currently alive together with their high-water mark.
+ * The bytes are the usable sizes of the blocks reported by the allocator.
+*/
+struct CAllocCounters {
+    std::atomic<size_t> m_num_allocs{0};
+    std::atomic<size_t> m_num_bytes{0};
+    std::atomic<size_t> m_live_bytes{0};
+    std::atomic<size_t> m_peak_live_bytes{0};
+
+    // restart the high-water mark from the bytes currently alive
+    void reset_peak() {
+        m_peak_live_bytes.store(m_live_bytes.load());
+    }
+};
+
+inline CAllocCounters& alloc_counters() {
+    static CAllocCounters counters;
+    return counters;
+}
+
+// the usable size is also known on delete, so the live bytes can be tracked
+inline void count_allocation(void* p) {
+    size_t a_size = malloc_usable_size(p);
+    CAllocCounters& counters = alloc_counters();
+    counters.m_num_allocs.fetch_add(1, std::memory_order_relaxed);
+    counters.m_num_bytes.fetch_add(a_size, std::memory_order_relaxed);
+    size_t live = counters.m_live_bytes.fetch_add(a_size, std::memory_order_relaxed) + a_size;
+    size_t peak = counters.m_peak_live_bytes.load(std::memory_order_relaxed);
+    while(live > peak && !counters.m_peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        ;
+}
+
+void* operator new(size_t aSize) {
+    void* p = std::malloc(aSize ? aSize : 1);
+    if(!p)
+        throw std::bad_alloc();
+    count_allocation(p);
+    return p;
+}
+
+// the over-aligned allocations, e.g. from std::pmr::new_delete_resource
+void* operator new(size_t aSize, std::align_val_t aAlignment) {
+    size_t alignment = std::max(size_t(aAlignment), sizeof(void*));
+    void* p(nullptr);
+    if(posix_memalign(&p, alignment, aSize ? aSize : 1) != 0)
+        throw std::bad_alloc();
+    count_allocation(p);
+    return p;
+}
+
+// the blocks of the replaced operator new come from malloc
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept {
+    if(!p)
+        return;
+    alloc_counters().m_live_bytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+    std::free(p);
+}
+#pragma GCC diagnostic pop
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    operator delete(p);
+}
+
+/*
+ * Returns the seconds elapsed since the start time point.
+*/
+inline double seconds_since(std::chrono::steady_clock::time_point aStart) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - aStart).count();
+}
+
+/*
+ * Write a random-branching tree with exactly aNumNodes nodes in the
+ * 7-column pre-order .tree format, with the default shape of CTreeGenerator.
+ * Returns false if the file can not be written.
+*/
+inline bool write_random_tree_file(const std::string& aFileName, long aNumNodes, unsigned aSeed = 1) {
+    CTreeGeneratorParams params;
+    params.m_num_nodes = aNumNodes;
+    params.m_seed = aSeed;
+    CTreeGenerator generator(params);
+    return generator.write_tree_file(aFileName);
+}
+
+#endif // BENCH_COMMON_H
@@ -0,0 +1,83 @@
+/*
+ * Stress the graph construction with a synthetic single chain of nodes,
+ * i.e. a trunk with one internode per line and no side branches.
+ * Usage: bench_deep_chain [number of nodes] [max seconds]
+ * The default is a chain of one million nodes which must load within 30 seconds.
+ * Returns a non-zero exit code if a load fails, the graph is wrong or too slow.
+*/
+
+#include "../cdagtree.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+using namespace std;
+
+static bool write_chain_file(const string& aFileName, long aNumNodes) {
+    FILE* p_file = fopen(aFileName.c_str(), "w");
+    if(!p_file)
+        return false;
+    for(long i = 0; i < aNumNodes; ++i) {
+        int num_children = (i + 1 < aNumNodes) ? 1 : 0;
+        fprintf(p_file, "%f %f %f %f %d %d %d\n",
+                0.001*(i % 7), 0.01*i, 0.0, 1.0, num_children, num_children ? 0 : 1, 1);
+    }
+    fclose(p_file);
+    return true;
+}
+
+/*
+ * Check the chain by walking from the root along the first child nodes.
+*/
+static bool check_chain(const CDAGTree<float>& aTree, long aNumNodes) {
+    if(long(aTree.get_total_num_of_nodes()) != aNumNodes)
+        return false;
+    int p = aTree.get_root_node_index();
+    long depth(0);
+    while(aTree.get_num_children(p) > 0) {
+        int c = aTree.get_child_indices(p)[0];
+        if(aTree.get_parent_index(c) != p)
+            return false;
+        p = c;
+        ++depth;
+    }
+    return depth == aNumNodes - 1;
+}
+
+int main(int argc, char** argv) {
+    long num_nodes = argc > 1 ? atol(argv[1]) : 1000000;
+    double max_seconds = argc > 2 ? atof(argv[2]) : 30.0;
+    string file_name = "deep_chain_" + to_string(num_nodes) + ".tree";
+
+    if(num_nodes < 1 || !write_chain_file(file_name, num_nodes)) {
+        fprintf(stderr, "ERROR: could not write the chain file %s\n", file_name.c_str());
+        return 1;
+    }
+
+    using clock = chrono::steady_clock;
+    const TreeLoadMode modes[] = {TreeLoadMode::Stream, TreeLoadMode::Mapped};
+    const char* mode_names[] = {"stream", "mapped"};
+    int exit_code(0);
+    for(int m = 0; m < 2; ++m) {
+        CDAGTree<float> a_tree;
+        clock::time_point start = clock::now();
+        bool is_loaded = a_tree.load_tree_file(file_name, modes[m]);
+        double load_seconds = chrono::duration<double>(clock::now() - start).count();
+        start = clock::now();
+        if(is_loaded)
+            a_tree.extract_branches();
+        double extract_seconds = chrono::duration<double>(clock::now() - start).count();
+
+        bool is_ok = is_loaded && check_chain(a_tree, num_nodes)
+                && a_tree.get_total_num_of_branches() == 1
+                && load_seconds + extract_seconds <= max_seconds;
+        printf("%-8s nodes %ld load %.3f s extract %.3f s %s\n",
+               mode_names[m], num_nodes, load_seconds, extract_seconds, is_ok ? "OK" : "FAILED");
+        if(!is_ok)
+            exit_code = 1;
+    }
+
+    remove(file_name.c_str());
+    return exit_code;
+}
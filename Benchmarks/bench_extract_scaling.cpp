@@ -0,0 +1,90 @@
+/*
+ * Measure how the parallel branch extraction scales with the number of threads.
+ * Usage: bench_extract_scaling [tree file] [max threads]
+ * Without a file a synthetic tree of 10^6 nodes is used; the threads default
+ * to the number of hardware threads. Every parallel result is compared with
+ * the serial extraction and the program fails if they differ.
+*/
+
+#include "bench_common.h"
+#include "../cdagtree.h"
+#include "../cworkstealingpool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/*
+ * Flatten the branch sets into one array: per set the branch count,
+ * per branch its level, node count and nodes.
+*/
+static vector<int> flatten_branches(const CDAGTree<float>& aTree) {
+    vector<int> values;
+    for(const auto& bs : aTree.get_branches()) {
+        values.push_back(int(bs.get_branch_nums()));
+        for(const auto& b : bs.get_branch_array()) {
+            values.push_back(b->get_branch_level());
+            values.push_back(int(b->get_branch_nodes_nums()));
+            values.insert(values.end(), b->get_branch_nodes().begin(), b->get_branch_nodes().end());
+        }
+    }
+    return values;
+}
+
+int main(int argc, char** argv) {
+    string file_name = argc > 1 ? argv[1] : "";
+    unsigned max_threads = argc > 2 ? unsigned(atoi(argv[2])) : max(1u, thread::hardware_concurrency());
+    bool is_synthetic = file_name.empty();
+    if(is_synthetic) {
+        file_name = "synthetic_extract_1000000.tree";
+        if(!write_random_tree_file(file_name, 1000000)) {
+            fprintf(stderr, "ERROR: could not write the synthetic tree %s\n", file_name.c_str());
+            return 1;
+        }
+    }
+
+    // the serial reference
+    CDAGTree<float> serial_tree;
+    if(!serial_tree.load_tree_file(file_name)) {
+        fprintf(stderr, "ERROR: failed loading the tree file %s\n", file_name.c_str());
+        return 1;
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    serial_tree.extract_branches();
+    double serial_seconds = seconds_since(start);
+    vector<int> reference = flatten_branches(serial_tree);
+
+    printf("%s: %zu nodes, %zu branches\n", file_name.c_str(),
+           serial_tree.get_total_num_of_nodes(), serial_tree.get_total_num_of_branches());
+    printf("%-8s %12s %10s %10s\n", "threads", "extract ms", "speedup", "result");
+    printf("%-8s %12.3f %9.2fx %10s\n", "serial", serial_seconds*1e3, 1.0, "reference");
+
+    int exit_code(0);
+    for(unsigned n = 1; n <= max_threads; ++n) {
+        CWorkStealingPool a_pool(n);
+        // the best of a few runs, each on a freshly loaded tree
+        double best_seconds(0.0);
+        bool is_identical(true);
+        for(int r = 0; r < 3; ++r) {
+            CDAGTree<float> a_tree;
+            a_tree.load_tree_file(file_name);
+            start = chrono::steady_clock::now();
+            a_tree.extract_branches_parallel(a_pool);
+            double seconds = seconds_since(start);
+            if(r == 0 || seconds < best_seconds)
+                best_seconds = seconds;
+            is_identical = is_identical && flatten_branches(a_tree) == reference;
+        }
+        printf("%-8u %12.3f %9.2fx %10s\n", n, best_seconds*1e3, serial_seconds/best_seconds,
+               is_identical ? "identical" : "DIFFERENT");
+        if(!is_identical)
+            exit_code = 1;
+    }
+
+    if(is_synthetic)
+        remove(file_name.c_str());
+    return exit_code;
+}
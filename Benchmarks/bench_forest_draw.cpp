@@ -0,0 +1,319 @@
+/*
+ * Measure the frame time of a forest of placed trees against the number of instances.
+ * Usage: bench_forest_draw [--max-instances N] [--nodes N] [--viewport W H] [tree files...]
+ * Without tree files five synthetic trees of 32 nodes (--nodes) are used, small enough for
+ * the cost of the draw calls to show under software rendering; the TestData trees can be
+ * given instead, at a much higher vertex cost per instance. The trees are placed on a square grid
+ * with a random yaw and scale, 1000, 10000 and 100000 instances (up to --max-instances),
+ * and every forest is drawn with the basic shaders, from a camera that sees all of it, as
+ *  indirect     CTreeForest, one glMultiDrawElementsIndirect per frame
+ *  per-instance one glDrawElements per instance, with its model matrix written into the
+ *               uniform buffer of the matrices
+ * Each frame is finished with glFinish. The OpenGL context is a surfaceless EGL one rendering
+ * into a framebuffer object, so no display is needed; software rendering (llvmpipe) is
+ * asked for unless LIBGL_ALWAYS_SOFTWARE is already set, so the numbers can be compared
+ * on machines without a GPU. Run it from the repository root, where basic.vert and
+ * basic.frag are read from.
+ * Besides the tree sources it needs ctreeforest.cpp, ctreeskeletonarrays.cpp,
+ * GLUtilities/transformation_3d.cpp, GLEW and EGL.
+*/
+
+#include "bench_common.h"
+#include "../cdagtree.h"
+#include "../ctreeforest.h"
+#include "../ctreeskeletonarrays.h"
+#include "../GLUtilities/transformation_3d.h"
+
+#include "GL/glew.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+/*
+ * A skeleton in its own buffers, drawn once per instance.
+*/
+struct CSingleTree {
+    unsigned m_vao;
+    unsigned m_buffers[2];
+    GLsizei m_num_elements;
+};
+
+static bool create_gl_context(int aWidth, int aHeight) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay a_display = get_platform_display ?
+                get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr) :
+                eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major(0), minor(0);
+    if(a_display == EGL_NO_DISPLAY || !eglInitialize(a_display, &major, &minor))
+        return false;
+    if(!eglBindAPI(EGL_OPENGL_API))
+        return false;
+    const EGLint context_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE
+    };
+    // the rendering goes into a framebuffer object, so no config nor surface is needed
+    EGLContext a_context = eglCreateContext(a_display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attributes);
+    if(a_context == EGL_NO_CONTEXT || !eglMakeCurrent(a_display, EGL_NO_SURFACE, EGL_NO_SURFACE, a_context))
+        return false;
+    // GLEW may report a missing GLX display, but it has loaded the entry points by then
+    glewExperimental = GL_TRUE;
+    const GLenum glew_result = glewInit();
+    if(glew_result != GLEW_OK && glew_result != GLEW_ERROR_NO_GLX_DISPLAY)
+        return false;
+    // glMultiDrawElementsIndirect is core since OpenGL 4.3
+    if(!GLEW_VERSION_4_3)
+        return false;
+
+    unsigned framebuffer, renderbuffers[2];
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, aWidth, aHeight);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, aWidth, aHeight);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        return false;
+    glViewport(0, 0, aWidth, aHeight);
+    glEnable(GL_DEPTH_TEST);
+    return true;
+}
+
+static unsigned compile_shader(GLenum aType, const string& aFileName) {
+    ifstream a_file(aFileName);
+    if(!a_file) {
+        fprintf(stderr, "ERROR: failed read the shader %s\n", aFileName.c_str());
+        return 0;
+    }
+    stringstream a_stream;
+    a_stream << a_file.rdbuf();
+    const string source = a_stream.str();
+    const char* source_ptr = source.c_str();
+    unsigned a_shader = glCreateShader(aType);
+    glShaderSource(a_shader, 1, &source_ptr, nullptr);
+    glCompileShader(a_shader);
+    int status(0);
+    glGetShaderiv(a_shader, GL_COMPILE_STATUS, &status);
+    if(!status) {
+        char info_log[512];
+        glGetShaderInfoLog(a_shader, sizeof(info_log), nullptr, info_log);
+        fprintf(stderr, "ERROR: failed compile the shader %s\n%s\n", aFileName.c_str(), info_log);
+        return 0;
+    }
+    return a_shader;
+}
+
+static unsigned create_program() {
+    unsigned vertex_shader = compile_shader(GL_VERTEX_SHADER, "basic.vert");
+    unsigned fragment_shader = compile_shader(GL_FRAGMENT_SHADER, "basic.frag");
+    if(vertex_shader == 0 || fragment_shader == 0)
+        return 0;
+    unsigned a_program = glCreateProgram();
+    glAttachShader(a_program, vertex_shader);
+    glAttachShader(a_program, fragment_shader);
+    glLinkProgram(a_program);
+    int status(0);
+    glGetProgramiv(a_program, GL_LINK_STATUS, &status);
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+    return status ? a_program : 0;
+}
+
+static CSingleTree create_single_tree(const CTreeSkeletonArrays& aArrays) {
+    CSingleTree a_tree;
+    a_tree.m_num_elements = GLsizei(aArrays.get_num_elements());
+    glGenVertexArrays(1, &a_tree.m_vao);
+    glGenBuffers(2, a_tree.m_buffers);
+    glBindVertexArray(a_tree.m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, a_tree.m_buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float)*aArrays.get_vertex_positions().size(),
+                 aArrays.get_vertex_positions().data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, a_tree.m_buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t)*aArrays.get_num_elements(),
+                 aArrays.get_element_indices().data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    return a_tree;
+}
+
+/*
+ * The average seconds of one finished frame, repeated for at least 0.5 seconds and 3 frames.
+*/
+template<typename DRAW_FUNC>
+static double time_frames(DRAW_FUNC aDraw) {
+    aDraw();
+    glFinish();
+    int frames(0);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    do {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        aDraw();
+        glFinish();
+        ++frames;
+    } while(seconds_since(start) < 0.5 || frames < 3);
+    return seconds_since(start) / frames;
+}
+
+int main(int argc, char** argv) {
+    vector<string> file_names;
+    vector<string> temp_files;
+    size_t max_instances(100000);
+    long num_nodes(32);
+    int width(800), height(600);
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--max-instances") == 0 && i + 1 < argc)
+            max_instances = size_t(atol(argv[++i]));
+        else if(strcmp(argv[i], "--nodes") == 0 && i + 1 < argc)
+            num_nodes = max(atol(argv[++i]), 2L);
+        else if(strcmp(argv[i], "--viewport") == 0 && i + 2 < argc) {
+            width = max(atoi(argv[++i]), 1);
+            height = max(atoi(argv[++i]), 1);
+        } else
+            file_names.push_back(argv[i]);
+    }
+    if(file_names.empty()) {
+        for(unsigned i = 1; i <= 5; ++i) {
+            const string f = "/tmp/bench_forest_draw_" + to_string(num_nodes) + "_" + to_string(i) + ".tree";
+            if(!write_random_tree_file(f, num_nodes, i)) {
+                fprintf(stderr, "ERROR: could not write the synthetic tree %s\n", f.c_str());
+                return 1;
+            }
+            file_names.push_back(f);
+            temp_files.push_back(f);
+        }
+    }
+    // compare with the software rasterizer of a CI machine unless told otherwise
+    setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+    if(!create_gl_context(width, height)) {
+        fprintf(stderr, "ERROR: no OpenGL 4.3 context\n");
+        return 1;
+    }
+    printf("renderer: %s, %s, viewport %dx%d\n", (const char*)glGetString(GL_RENDERER),
+           (const char*)glGetString(GL_VERSION), width, height);
+    unsigned a_program = create_program();
+    if(a_program == 0) {
+        fprintf(stderr, "ERROR: failed create the shader program\n");
+        return 1;
+    }
+    glUseProgram(a_program);
+    // the Matrices block of basic.vert: proj, view and model
+    unsigned matrices_buffer;
+    glGenBuffers(1, &matrices_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, matrices_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, 3*sizeof(Eigen::Matrix4f), nullptr, GL_DYNAMIC_DRAW);
+    glUniformBlockBinding(a_program, glGetUniformBlockIndex(a_program, "Matrices"), 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, matrices_buffer);
+    const int instanced_loc = glGetUniformLocation(a_program, "instanced");
+
+    vector<CTreeSkeletonArrays> tree_arrays(file_names.size());
+    vector<CSingleTree> single_trees;
+    float tree_size(0.f);
+    for(size_t t = 0; t < file_names.size(); ++t) {
+        CDAGTree<float> a_tree;
+        if(!a_tree.load_tree_file(file_names[t])) {
+            fprintf(stderr, "ERROR: failed loading the tree file %s\n", file_names[t].c_str());
+            return 1;
+        }
+        a_tree.extract_branches();
+        tree_arrays[t].build(a_tree);
+        single_trees.push_back(create_single_tree(tree_arrays[t]));
+        CBBox<float> a_box;
+        a_tree.compute_bounding_box(a_box);
+        tree_size = max(tree_size, max(a_box.m_x_max - a_box.m_x_min, a_box.m_z_max - a_box.m_z_min));
+    }
+
+    printf("%10s %-13s %8s %10s %10s\n", "instances", "drawing", "trees", "draws", "ms/frame");
+    for(size_t num_instances = 1000; num_instances <= max_instances; num_instances *= 10) {
+        // a square grid of trees, a tree wide apart, seen from above one of its corners
+        mt19937 a_random(1);
+        uniform_real_distribution<float> yaw(0.f, 360.f), scale(0.7f, 1.3f);
+        uniform_int_distribution<size_t> pick(0, file_names.size() - 1);
+        const size_t side = size_t(ceil(sqrt(double(num_instances))));
+        const float spacing = 2.f * tree_size;
+        unique_ptr<CTreeForest> a_forest(new CTreeForest());
+        for(size_t t = 0; t < file_names.size(); ++t) {
+            CTreeSkeletonArrays arrays(tree_arrays[t]);
+            a_forest->add_tree(arrays);
+        }
+        vector<int> instance_trees(num_instances);
+        vector<Eigen::Matrix4f> instance_matrices(num_instances);
+        for(size_t i = 0; i < num_instances; ++i) {
+            const float radians = yaw(a_random) * float(M_PI) / 180.f;
+            const float s = scale(a_random);
+            Eigen::Matrix4f model_mat = Eigen::Matrix4f::Identity();
+            model_mat(0, 0) = s * cos(radians);
+            model_mat(0, 2) = s * sin(radians);
+            model_mat(1, 1) = s;
+            model_mat(2, 0) = -s * sin(radians);
+            model_mat(2, 2) = s * cos(radians);
+            model_mat(0, 3) = spacing * float(i % side);
+            model_mat(2, 3) = spacing * float(i / side);
+            instance_trees[i] = int(pick(a_random));
+            instance_matrices[i] = model_mat;
+            a_forest->add_instance(instance_trees[i], model_mat);
+        }
+        a_forest->create_buffers();
+
+        const float extent = spacing * float(side);
+        const Eigen::Vector3f center(0.5f * extent, 0.f, 0.5f * extent);
+        const Eigen::Vector3f eye(-0.2f * extent, 0.6f * extent, -0.2f * extent);
+        const Eigen::Matrix4f view_mat = view_transform(eye, center, Eigen::Vector3f(0.f, 1.f, 0.f));
+        const Eigen::Matrix4f proj_mat = perspective(60.f, float(width) / float(height), 1e-2f * extent, 4.f * extent);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Eigen::Matrix4f), proj_mat.data());
+        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(Eigen::Matrix4f), sizeof(Eigen::Matrix4f), view_mat.data());
+
+        glUniform1i(instanced_loc, GL_TRUE);
+        const double indirect_seconds = time_frames([&]() {
+            a_forest->draw();
+        });
+        printf("%10zu %-13s %8zu %10zu %10.2f\n", num_instances, "indirect", a_forest->get_num_trees(),
+               size_t(1), indirect_seconds*1e3);
+
+        glUniform1i(instanced_loc, GL_FALSE);
+        const double single_seconds = time_frames([&]() {
+            glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+            for(size_t i = 0; i < num_instances; ++i) {
+                const CSingleTree& a_tree = single_trees[size_t(instance_trees[i])];
+                glBufferSubData(GL_UNIFORM_BUFFER, 2*sizeof(Eigen::Matrix4f), sizeof(Eigen::Matrix4f),
+                                instance_matrices[i].data());
+                glBindVertexArray(a_tree.m_vao);
+                glDrawElements(GL_LINE_STRIP, a_tree.m_num_elements, GL_UNSIGNED_INT, (void*)0);
+            }
+            glBindVertexArray(0);
+            glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+        });
+        printf("%10zu %-13s %8zu %10zu %10.2f\n", num_instances, "per-instance", single_trees.size(),
+               num_instances, single_seconds*1e3);
+
+        if(glGetError() != GL_NO_ERROR) {
+            fprintf(stderr, "ERROR: OpenGL error while drawing %zu instances\n", num_instances);
+            return 1;
+        }
+    }
+
+    for(CSingleTree& a_tree : single_trees) {
+        glDeleteBuffers(2, a_tree.m_buffers);
+        glDeleteVertexArrays(1, &a_tree.m_vao);
+    }
+    glDeleteBuffers(1, &matrices_buffer);
+    glDeleteProgram(a_program);
+    for(const auto& f : temp_files)
+        remove(f.c_str());
+    return 0;
+}
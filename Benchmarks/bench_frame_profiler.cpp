@@ -0,0 +1,336 @@
+/*
+ * Measure what the frame profiler costs and check that it never stalls the pipeline.
+ * Usage: bench_frame_profiler [--frames N] [--nodes N] [--viewport W H] [tree file]
+ * Without a file a synthetic tree of 200000 nodes (--nodes) is used. Its skeleton is drawn
+ * N frames (300 by default) in each of the modes
+ *  none        the draw call and a flush, not timed
+ *  profiled    CFrameProfiler around it: scoped CPU timers and a double buffered
+ *              GL_TIME_ELAPSED query, while another thread reads the last 240 frames
+ *              from the ring over and over
+ *  blocking    one query per frame whose result is read right after it ends, which
+ *              waits for the GPU, for comparison
+ * The percentiles of the wall time of a frame are reported for every mode, with the
+ * statistics the profiler exported and the frames whose GPU time was not ready in time.
+ * Every frame copied by the reading thread is checked to be whole; the program fails
+ * if one is torn. The OpenGL context is a surfaceless EGL one rendering into a
+ * framebuffer object, with software rendering (llvmpipe) unless LIBGL_ALWAYS_SOFTWARE
+ * is already set. Run it from the repository root, where basic.vert and basic.frag are read from.
+ * Besides the tree sources it needs cframeprofiler.cpp, ctreeskeletonarrays.cpp,
+ * GLUtilities/transformation_3d.cpp, GLEW and EGL.
+*/
+
+#include "bench_common.h"
+#include "../cdagtree.h"
+#include "../cframeprofiler.h"
+#include "../ctreeskeletonarrays.h"
+#include "../GLUtilities/transformation_3d.h"
+
+#include "GL/glew.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+static bool create_gl_context(int aWidth, int aHeight) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay a_display = get_platform_display ?
+                get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr) :
+                eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major(0), minor(0);
+    if(a_display == EGL_NO_DISPLAY || !eglInitialize(a_display, &major, &minor))
+        return false;
+    if(!eglBindAPI(EGL_OPENGL_API))
+        return false;
+    const EGLint context_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE
+    };
+    // the rendering goes into a framebuffer object, so no config nor surface is needed
+    EGLContext a_context = eglCreateContext(a_display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attributes);
+    if(a_context == EGL_NO_CONTEXT || !eglMakeCurrent(a_display, EGL_NO_SURFACE, EGL_NO_SURFACE, a_context))
+        return false;
+    // GLEW may report a missing GLX display, but it has loaded the entry points by then
+    glewExperimental = GL_TRUE;
+    const GLenum glew_result = glewInit();
+    if(glew_result != GLEW_OK && glew_result != GLEW_ERROR_NO_GLX_DISPLAY)
+        return false;
+    // the GL_TIME_ELAPSED queries
+    if(!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query)
+        return false;
+
+    unsigned framebuffer, renderbuffers[2];
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, aWidth, aHeight);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, aWidth, aHeight);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        return false;
+    glViewport(0, 0, aWidth, aHeight);
+    glEnable(GL_DEPTH_TEST);
+    return true;
+}
+
+static unsigned compile_shader(GLenum aType, const string& aFileName) {
+    ifstream a_file(aFileName);
+    if(!a_file) {
+        fprintf(stderr, "ERROR: failed read the shader %s\n", aFileName.c_str());
+        return 0;
+    }
+    stringstream a_stream;
+    a_stream << a_file.rdbuf();
+    const string source = a_stream.str();
+    const char* source_ptr = source.c_str();
+    unsigned a_shader = glCreateShader(aType);
+    glShaderSource(a_shader, 1, &source_ptr, nullptr);
+    glCompileShader(a_shader);
+    int status(0);
+    glGetShaderiv(a_shader, GL_COMPILE_STATUS, &status);
+    if(!status) {
+        char info_log[512];
+        glGetShaderInfoLog(a_shader, sizeof(info_log), nullptr, info_log);
+        fprintf(stderr, "ERROR: failed compile the shader %s\n%s\n", aFileName.c_str(), info_log);
+        return 0;
+    }
+    return a_shader;
+}
+
+static unsigned create_program() {
+    unsigned vertex_shader = compile_shader(GL_VERTEX_SHADER, "basic.vert");
+    unsigned fragment_shader = compile_shader(GL_FRAGMENT_SHADER, "basic.frag");
+    if(vertex_shader == 0 || fragment_shader == 0)
+        return 0;
+    unsigned a_program = glCreateProgram();
+    glAttachShader(a_program, vertex_shader);
+    glAttachShader(a_program, fragment_shader);
+    glLinkProgram(a_program);
+    int status(0);
+    glGetProgramiv(a_program, GL_LINK_STATUS, &status);
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+    return status ? a_program : 0;
+}
+
+// the frames whose statistics are exported, as in CGLScene
+static const size_t FRAME_STATS_WINDOW = 240;
+
+static float get_percentile(vector<float> aTimes, double aFraction) {
+    if(aTimes.empty())
+        return 0.f;
+    vector<float>::iterator nth = aTimes.begin() + min(size_t(aFraction * aTimes.size()), aTimes.size() - 1);
+    nth_element(aTimes.begin(), nth, aTimes.end());
+    return *nth;
+}
+
+// a copied frame is whole if its parts are consistent with each other
+static bool is_whole(const CFrameTimes& aTimes, uint64_t aFrameIndex) {
+    return aTimes.m_frame_index == aFrameIndex && aTimes.m_cpu_ms >= aTimes.m_draw_ms &&
+           aTimes.m_frame_ms >= aTimes.m_cpu_ms && aTimes.m_update_ms == float(aFrameIndex % 7);
+}
+
+int main(int argc, char** argv) {
+    string file_name;
+    int num_frames(300);
+    long num_nodes(200000);
+    int width(800), height(600);
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            num_frames = max(atoi(argv[++i]), 1);
+        else if(strcmp(argv[i], "--nodes") == 0 && i + 1 < argc)
+            num_nodes = max(atol(argv[++i]), 2L);
+        else if(strcmp(argv[i], "--viewport") == 0 && i + 2 < argc) {
+            width = max(atoi(argv[++i]), 1);
+            height = max(atoi(argv[++i]), 1);
+        } else
+            file_name = argv[i];
+    }
+    bool is_synthetic = file_name.empty();
+    if(is_synthetic) {
+        file_name = "/tmp/bench_frame_profiler_" + to_string(num_nodes) + ".tree";
+        if(!write_random_tree_file(file_name, num_nodes)) {
+            fprintf(stderr, "ERROR: could not write the synthetic tree %s\n", file_name.c_str());
+            return 1;
+        }
+    }
+    setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+    if(!create_gl_context(width, height)) {
+        fprintf(stderr, "ERROR: no OpenGL 4.3 context\n");
+        return 1;
+    }
+    printf("renderer: %s, %s, viewport %dx%d\n", (const char*)glGetString(GL_RENDERER),
+           (const char*)glGetString(GL_VERSION), width, height);
+    unsigned a_program = create_program();
+    if(a_program == 0) {
+        fprintf(stderr, "ERROR: failed create the shader program\n");
+        return 1;
+    }
+    glUseProgram(a_program);
+    glUniform1i(glGetUniformLocation(a_program, "instanced"), GL_FALSE);
+
+    CDAGTree<float> a_tree;
+    if(!a_tree.load_tree_file(file_name)) {
+        fprintf(stderr, "ERROR: failed loading the tree file %s\n", file_name.c_str());
+        return 1;
+    }
+    a_tree.extract_branches();
+    CTreeSkeletonArrays arrays;
+    arrays.build(a_tree);
+    unsigned vao, buffers[2];
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(2, buffers);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float)*arrays.get_vertex_positions().size(),
+                 arrays.get_vertex_positions().data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t)*arrays.get_num_elements(),
+                 arrays.get_element_indices().data(), GL_STATIC_DRAW);
+    glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    const GLsizei num_elements = GLsizei(arrays.get_num_elements());
+
+    // the Matrices block of basic.vert, a camera in front of the tree
+    CBBox<float> a_box;
+    a_tree.compute_bounding_box(a_box);
+    const Eigen::Vector3f center(0.5f*(a_box.m_x_min + a_box.m_x_max), 0.5f*(a_box.m_y_min + a_box.m_y_max),
+                                 0.5f*(a_box.m_z_min + a_box.m_z_max));
+    const float diagonal = Eigen::Vector3f(a_box.m_x_max - a_box.m_x_min, a_box.m_y_max - a_box.m_y_min,
+                                           a_box.m_z_max - a_box.m_z_min).norm();
+    Eigen::Matrix4f matrices[3];
+    matrices[0] = perspective(60.f, float(width) / float(height), 1e-2f * diagonal, 4.f * diagonal);
+    matrices[1] = view_transform(center + Eigen::Vector3f(0.f, 0.f, diagonal), center, Eigen::Vector3f(0.f, 1.f, 0.f));
+    matrices[2] = Eigen::Matrix4f::Identity();
+    unsigned matrices_buffer;
+    glGenBuffers(1, &matrices_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, matrices_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(matrices), matrices, GL_STATIC_DRAW);
+    glUniformBlockBinding(a_program, glGetUniformBlockIndex(a_program, "Matrices"), 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, matrices_buffer);
+    printf("%s: %zu nodes, %zu elements, %d frames per mode\n", file_name.c_str(),
+           a_tree.get_total_num_of_nodes(), arrays.get_num_elements(), num_frames);
+
+    auto draw = [num_elements]() {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glDrawElements(GL_LINE_STRIP, num_elements, GL_UNSIGNED_INT, (void*)0);
+    };
+    // the frames of the software rasterizer run ahead until it has caught up
+    draw();
+    glFinish();
+
+    int exit_code(0);
+    printf("%-10s %9s %9s %9s %9s\n", "mode", "p50 ms", "p95 ms", "p99 ms", "gpu p50");
+    const char* modes[] = {"none", "profiled", "blocking"};
+    for(int mode = 0; mode < 3; ++mode) {
+        CFrameProfiler a_profiler;
+        a_profiler.create_queries();
+        unsigned blocking_query;
+        glGenQueries(1, &blocking_query);
+        // the reading thread, checking every frame it copies
+        atomic<bool> is_stopping(false);
+        atomic<uint64_t> num_read(0), num_torn(0);
+        thread reader;
+        if(mode == 1) {
+            reader = thread([&a_profiler, &is_stopping, &num_read, &num_torn]() {
+                vector<CFrameTimes> times;
+                while(!is_stopping.load()) {
+                    a_profiler.get_ring().copy_last(FRAME_STATS_WINDOW, times);
+                    for(const CFrameTimes& t : times) {
+                        if(!is_whole(t, t.m_frame_index))
+                            ++num_torn;
+                    }
+                    for(size_t i = 1; i < times.size(); ++i) {
+                        if(times[i].m_frame_index <= times[i-1].m_frame_index)
+                            ++num_torn;
+                    }
+                    num_read += times.size();
+                    this_thread::yield();
+                }
+            });
+        }
+        vector<float> frame_ms, gpu_ms;
+        for(int f = 0; f < num_frames; ++f) {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            if(mode == 0) {
+                draw();
+            } else if(mode == 1) {
+                a_profiler.begin_frame();
+                CFrameTimes& frame_times = a_profiler.get_current_times();
+                frame_times.m_update_ms = float(frame_times.m_frame_index % 7);
+                {
+                    CScopedCpuTimer cpu_timer(frame_times.m_cpu_ms);
+                    CScopedCpuTimer draw_timer(frame_times.m_draw_ms);
+                    a_profiler.begin_gpu_timer();
+                    draw();
+                    a_profiler.end_gpu_timer();
+                }
+                glFlush();
+                a_profiler.end_frame();
+            } else {
+                glBeginQuery(GL_TIME_ELAPSED, blocking_query);
+                draw();
+                glEndQuery(GL_TIME_ELAPSED);
+                GLuint64 nanoseconds(0);
+                glGetQueryObjectui64v(blocking_query, GL_QUERY_RESULT, &nanoseconds);
+                gpu_ms.push_back(float(double(nanoseconds) * 1e-6));
+            }
+            glFlush();
+            frame_ms.push_back(float(seconds_since(start) * 1e3));
+        }
+        glFinish();
+        is_stopping.store(true);
+        if(reader.joinable())
+            reader.join();
+        if(mode == 1) {
+            vector<CFrameTimes> times;
+            a_profiler.get_ring().copy_last(FRAME_STATS_WINDOW, times);
+            for(const CFrameTimes& t : times) {
+                if(t.m_gpu_ms >= 0.f)
+                    gpu_ms.push_back(t.m_gpu_ms);
+            }
+        }
+        printf("%-10s %9.3f %9.3f %9.3f %9.3f\n", modes[mode], get_percentile(frame_ms, 0.5),
+               get_percentile(frame_ms, 0.95), get_percentile(frame_ms, 0.99), get_percentile(gpu_ms, 0.5));
+        if(mode == 1) {
+            vector<CFrameTimes> times;
+            a_profiler.get_ring().copy_last(FRAME_STATS_WINDOW, times);
+            CFrameStatistics statistics;
+            statistics.compute(times);
+            printf("  %s\n  %s\n", statistics.to_log_line().c_str(), statistics.to_json().c_str());
+            printf("  frames in the ring %llu, GPU times not ready in time %llu, frames read %llu, torn %llu\n",
+                   (unsigned long long)a_profiler.get_ring().get_num_pushed(),
+                   (unsigned long long)a_profiler.get_num_missed_gpu_times(),
+                   (unsigned long long)num_read.load(), (unsigned long long)num_torn.load());
+            if(num_torn.load() > 0)
+                exit_code = 1;
+        }
+        glDeleteQueries(1, &blocking_query);
+        a_profiler.delete_queries();
+    }
+    if(glGetError() != GL_NO_ERROR) {
+        fprintf(stderr, "ERROR: OpenGL error while drawing\n");
+        exit_code = 1;
+    }
+
+    glDeleteBuffers(1, &matrices_buffer);
+    glDeleteBuffers(2, buffers);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(a_program);
+    if(is_synthetic)
+        remove(file_name.c_str());
+    return exit_code;
+}
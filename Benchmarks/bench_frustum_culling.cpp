@@ -0,0 +1,141 @@
+/*
+ * Show how many branches the frustum culling leaves out when the camera is in the crown.
+ * Usage: bench_frustum_culling [--pixel-error E] [tree file]
+ * Without a file a synthetic tree of 10^6 nodes is used. The camera stands at the centre
+ * of the tree's bounding box and looks along the six axis directions through a 60 degree,
+ * 4:3 frustum, then looks at the whole tree from two diagonals away. For every view the
+ * branches are selected with and without culling, and the program fails if a branch
+ * with a node inside the frustum is culled. The pixel error defaults to 0, the full branches.
+ * No OpenGL is needed.
+*/
+
+#include "bench_common.h"
+#include "../cdagtree.h"
+#include "../cfrustum.h"
+#include "../ctreebranchlod.h"
+#include "../GLUtilities/transformation_3d.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+using namespace std;
+
+/*
+ * The average seconds of one selection, repeated for at least 0.2 seconds.
+*/
+static double time_select(const CTreeBranchLOD& aLod, const Eigen::Vector3f& aEye, float aPixelScale,
+                          float aMaxPixelError, const CFrustum* aFrustum,
+                          vector<uint32_t>& aFirsts, vector<int>& aCounts, size_t& aNumCulled) {
+    int runs(0);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    do {
+        aFirsts.clear();
+        aCounts.clear();
+        aLod.select(aEye, aPixelScale, aMaxPixelError, 0, aFrustum, aFirsts, aCounts, &aNumCulled);
+        ++runs;
+    } while(seconds_since(start) < 0.2 || runs < 3);
+    return seconds_since(start) / runs;
+}
+
+int main(int argc, char** argv) {
+    string file_name;
+    float max_pixel_error(0.f);
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--pixel-error") == 0 && i + 1 < argc)
+            max_pixel_error = float(atof(argv[++i]));
+        else
+            file_name = argv[i];
+    }
+    bool is_synthetic = file_name.empty();
+    if(is_synthetic) {
+        file_name = "/tmp/bench_frustum_culling_1000000.tree";
+        if(!write_random_tree_file(file_name, 1000000)) {
+            fprintf(stderr, "ERROR: could not write the synthetic tree %s\n", file_name.c_str());
+            return 1;
+        }
+    }
+
+    CDAGTree<float> a_tree;
+    if(!a_tree.load_tree_file(file_name)) {
+        fprintf(stderr, "ERROR: failed loading the tree file %s\n", file_name.c_str());
+        return 1;
+    }
+    a_tree.extract_branches();
+    CTreeBranchLOD a_lod;
+    a_lod.build(a_tree);
+    printf("%s: %zu nodes, %zu branches\n", file_name.c_str(), a_tree.get_total_num_of_nodes(),
+           a_lod.get_num_branches());
+
+    CBBox<float> a_box;
+    a_tree.compute_bounding_box(a_box);
+    const Eigen::Vector3f center(0.5f*(a_box.m_x_min + a_box.m_x_max), 0.5f*(a_box.m_y_min + a_box.m_y_max),
+                                 0.5f*(a_box.m_z_min + a_box.m_z_max));
+    const float diagonal = Eigen::Vector3f(a_box.m_x_max - a_box.m_x_min, a_box.m_y_max - a_box.m_y_min,
+                                           a_box.m_z_max - a_box.m_z_min).norm();
+    const float pixel_scale = 600.f / (2.f * tan(float(M_PI) / 6.f));
+    const Eigen::Matrix4f proj_mat = perspective(60.f, 4.f / 3.f, 1e-3f * diagonal, 10.f * diagonal);
+
+    struct CView {
+        const char* m_name;
+        Eigen::Vector3f m_eye;
+        Eigen::Vector3f m_direction;
+    };
+    const CView views[] = {
+        {"crown +x", center, Eigen::Vector3f(1.f, 0.f, 0.f)},
+        {"crown -x", center, Eigen::Vector3f(-1.f, 0.f, 0.f)},
+        {"crown +y", center, Eigen::Vector3f(0.f, 1.f, 0.f)},
+        {"crown -y", center, Eigen::Vector3f(0.f, -1.f, 0.f)},
+        {"crown +z", center, Eigen::Vector3f(0.f, 0.f, 1.f)},
+        {"crown -z", center, Eigen::Vector3f(0.f, 0.f, -1.f)},
+        {"outside", center + Eigen::Vector3f(0.f, 0.f, 2.f*diagonal), Eigen::Vector3f(0.f, 0.f, -1.f)}
+    };
+
+    printf("%-10s %10s %10s %12s %12s %14s %14s\n", "view", "strips", "culled", "elements", "unculled",
+           "select us", "unculled us");
+    const vector<uint32_t>& elements = a_lod.get_element_indices();
+    vector<uint32_t> firsts, culled_firsts;
+    vector<int> counts, culled_counts;
+    bool is_correct(true);
+    for(const CView& a_view : views) {
+        const Eigen::Vector3f up = fabs(a_view.m_direction.y()) > 0.5f ? Eigen::Vector3f(0.f, 0.f, 1.f)
+                                                                      : Eigen::Vector3f(0.f, 1.f, 0.f);
+        const Eigen::Matrix4f view_mat = view_transform(a_view.m_eye, a_view.m_eye + a_view.m_direction, up);
+        const CFrustum a_frustum(proj_mat, view_mat);
+        size_t num_culled(0), num_unculled(0);
+        double unculled_seconds = time_select(a_lod, a_view.m_eye, pixel_scale, max_pixel_error, nullptr,
+                                              firsts, counts, num_unculled);
+        double culled_seconds = time_select(a_lod, a_view.m_eye, pixel_scale, max_pixel_error, &a_frustum,
+                                            culled_firsts, culled_counts, num_culled);
+        size_t num_elements(0), num_unculled_elements(0);
+        for(int c : culled_counts)
+            num_elements += size_t(c);
+        for(int c : counts)
+            num_unculled_elements += size_t(c);
+
+        // every strip with a vertex inside the frustum must have been kept
+        const Eigen::Matrix4f view_proj = proj_mat * view_mat;
+        const set<uint32_t> kept(culled_firsts.begin(), culled_firsts.end());
+        for(size_t s = 0; s < firsts.size(); ++s) {
+            if(kept.count(firsts[s]))
+                continue;
+            for(int i = 0; i < counts[s]; ++i) {
+                const Eigen::Vector4f clip = view_proj * a_tree.get_node_position(int(elements[firsts[s] + i])).homogeneous();
+                if(fabs(clip.x()) < clip.w() && fabs(clip.y()) < clip.w() && fabs(clip.z()) < clip.w()) {
+                    fprintf(stderr, "ERROR: %s: a strip with a visible vertex is culled\n", a_view.m_name);
+                    is_correct = false;
+                    break;
+                }
+            }
+        }
+        printf("%-10s %10zu %10zu %12zu %12zu %14.1f %14.1f\n", a_view.m_name, culled_counts.size(), num_culled,
+               num_elements, num_unculled_elements, culled_seconds*1e6, unculled_seconds*1e6);
+    }
+
+    if(is_synthetic)
+        remove(file_name.c_str());
+    return is_correct ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+/*
+ * Measure the memory footprint of the tree node storage and the speed of the
+ * traversals running on it: extract_branches and compute_bounding_box.
+ * Usage: bench_node_storage [tree files...]
+ * Without arguments the TestData trees and synthetic trees of 10^5 and 10^6
+ * nodes are used.
+*/
+
+#include "bench_common.h"
+#include "../cdagtree.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+using namespace std;
+
+int main(int argc, char** argv) {
+    vector<string> file_names;
+    vector<string> temp_files;
+    for(int i = 1; i < argc; ++i)
+        file_names.push_back(argv[i]);
+    if(file_names.empty()) {
+        for(int i = 1; i <= 5; ++i)
+            file_names.push_back("TestData/Tree" + to_string(i) + ".tree");
+        for(long n : {100000L, 1000000L}) {
+            string f = "synthetic_" + to_string(n) + ".tree";
+            if(!write_random_tree_file(f, n)) {
+                fprintf(stderr, "ERROR: could not write the synthetic tree %s\n", f.c_str());
+                return 1;
+            }
+            file_names.push_back(f);
+            temp_files.push_back(f);
+        }
+    }
+
+    printf("%-28s %10s %12s %12s %14s %14s\n",
+           "file", "nodes", "bytes/node", "peak b/node", "extract ns/n", "bbox ns/n");
+    for(const auto& f : file_names) {
+        CAllocCounters& counters = alloc_counters();
+        size_t live_before = counters.m_live_bytes.load();
+        counters.reset_peak();
+
+        CDAGTree<float>* p_tree = new CDAGTree<float>();
+        if(!p_tree->load_tree_file(f)) {
+            fprintf(stderr, "ERROR: failed loading the tree file %s\n", f.c_str());
+            return 1;
+        }
+        double num_nodes = double(p_tree->get_total_num_of_nodes());
+        double steady_bytes = double(counters.m_live_bytes.load() - live_before);
+        double peak_bytes = double(counters.m_peak_live_bytes.load() - live_before);
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        p_tree->extract_branches();
+        double extract_seconds = seconds_since(start);
+
+        // the bounding box is cheap, so it is averaged over several runs
+        const int num_box_runs(20);
+        CBBox<float> a_box;
+        volatile float box_sink(0.f);
+        start = chrono::steady_clock::now();
+        for(int r = 0; r < num_box_runs; ++r) {
+            p_tree->compute_bounding_box(a_box);
+            box_sink = box_sink + a_box.m_x_max;
+        }
+        double box_seconds = seconds_since(start) / num_box_runs;
+
+        printf("%-28s %10.0f %12.1f %12.1f %14.1f %14.3f\n",
+               f.c_str(), num_nodes, steady_bytes/num_nodes, peak_bytes/num_nodes,
+               extract_seconds*1e9/num_nodes, box_seconds*1e9/num_nodes);
+        delete p_tree;
+    }
+
+    for(const auto& f : temp_files)
+        remove(f.c_str());
+    return 0;
+}
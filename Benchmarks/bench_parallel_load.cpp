@@ -0,0 +1,163 @@
+/*
+ * Compare the sequential mapped loader with the parallel chunked loader.
+ * Usage: bench_parallel_load [tree files...]
+ * Without arguments the bundled TestData trees and a generated 4M-node tree are used.
+ * The parallel loader runs with 1, 2, 4, ... up to the hardware threads, and its
+ * node arrays are checked to be bitwise identical to the ones of the sequential loader.
+ * First a few small files ending early or oddly, e.g. a last node whose child nodes are
+ * missing, are checked to give the same graph with the stream, mapped and parallel loaders.
+*/
+
+#include "../cdagtree.h"
+#include "bench_common.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+using namespace std;
+
+template<typename V>
+static bool is_same_array(const V& aLhs, const V& aRhs) {
+    return aLhs.size() == aRhs.size() &&
+           memcmp(aLhs.data(), aRhs.data(), aLhs.size() * sizeof(aLhs[0])) == 0;
+}
+
+static bool is_same_graph(const CDAGTree<float>& aLhs, const CDAGTree<float>& aRhs) {
+    if(!is_same_array(aLhs.get_node_xs(), aRhs.get_node_xs()) ||
+       !is_same_array(aLhs.get_node_ys(), aRhs.get_node_ys()) ||
+       !is_same_array(aLhs.get_node_zs(), aRhs.get_node_zs()) ||
+       !is_same_array(aLhs.get_node_radii(), aRhs.get_node_radii()) ||
+       !is_same_array(aLhs.get_parent_indices(), aRhs.get_parent_indices()))
+        return false;
+    for(size_t i = 0; i < aLhs.get_total_num_of_nodes(); ++i) {
+        CNodeIndexRange lhs_children = aLhs.get_child_indices(int(i));
+        CNodeIndexRange rhs_children = aRhs.get_child_indices(int(i));
+        if(lhs_children.size() != rhs_children.size() ||
+           !equal(lhs_children.begin(), lhs_children.end(), rhs_children.begin()))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Load small files with unusual ends with every loader, and check that the graphs agree.
+ * Returns false if one differs.
+*/
+static bool check_end_of_input() {
+    struct CEndCase {
+        const char* m_name;
+        const char* m_content;
+    };
+    const CEndCase cases[] = {
+        {"truncated", "0 0 0 1 2 0 1\n1 1 1 1 3 0 1\n"},
+        {"truncated, no line end", "0 0 0 1 2 0 1\n1 1 1 1 3 0 1"},
+        {"truncated, CRLF", "0 0 0 1 2 0 1\r\n1 1 1 1 3 0 1\r\n"},
+        {"complete, no line end", "0 0 0 1 1 0 1\n1 1 1 1 0 3 0"},
+        {"blank lines after", "0 0 0 1 1 0 1\n1 1 1 1 0 3 0\n\n\n"},
+        {"blank line inside", "0 0 0 1 2 0 1\n\n1 1 1 1 0 3 0\n"},
+    };
+    const string file_name = "/tmp/bench_parallel_load_end.tree";
+    bool is_same(true);
+    for(const CEndCase& a_case : cases) {
+        {
+            ofstream outputs(file_name, ios::binary | ios::trunc);
+            outputs << a_case.m_content;
+        }
+        CDAGTree<float> stream_tree, mapped_tree, parallel_tree;
+        CWorkStealingPool a_pool(2);
+        const bool is_loaded = stream_tree.load_tree_file(file_name, TreeLoadMode::Stream) &&
+                               mapped_tree.load_tree_file(file_name, TreeLoadMode::Mapped) &&
+                               parallel_tree.load_tree_file_parallel(file_name, a_pool);
+        const bool is_case_same = is_loaded && is_same_graph(stream_tree, mapped_tree) &&
+                                  is_same_graph(stream_tree, parallel_tree);
+        printf("%-24s stream %zu, mapped %zu, parallel %zu nodes: %s\n", a_case.m_name,
+               stream_tree.get_total_num_of_nodes(), mapped_tree.get_total_num_of_nodes(),
+               parallel_tree.get_total_num_of_nodes(), is_case_same ? "same" : "DIFFERENT");
+        is_same = is_same && is_case_same;
+    }
+    remove(file_name.c_str());
+    return is_same;
+}
+
+/*
+ * Load the file repeatedly until at least aMinSeconds have elapsed, with the sequential
+ * loader if aPool is null. Returns the average seconds per load, or a negative value on failure.
+*/
+static double time_load(const string& aFileName, CWorkStealingPool* aPool, double aMinSeconds,
+                        const CDAGTree<float>* aReference) {
+    using clock = chrono::steady_clock;
+    int runs(0);
+    double elapsed(0.0);
+    do {
+        CDAGTree<float> a_tree;
+        clock::time_point start = clock::now();
+        bool is_loaded = aPool != nullptr ? a_tree.load_tree_file_parallel(aFileName, *aPool)
+                                          : a_tree.load_tree_file(aFileName);
+        elapsed += chrono::duration<double>(clock::now() - start).count();
+        if(!is_loaded)
+            return -1.0;
+        if(runs == 0 && aReference != nullptr && !is_same_graph(a_tree, *aReference)) {
+            fprintf(stderr, "ERROR: the parallel load of %s differs from the sequential load\n", aFileName.c_str());
+            return -1.0;
+        }
+        ++runs;
+    } while(elapsed < aMinSeconds || runs < 3);
+    return elapsed / runs;
+}
+
+int main(int argc, char** argv) {
+    if(!check_end_of_input()) {
+        fprintf(stderr, "ERROR: the loaders disagree on the end of a file\n");
+        return 1;
+    }
+    printf("\n");
+
+    vector<string> file_names;
+    for(int i = 1; i < argc; ++i)
+        file_names.push_back(argv[i]);
+    if(file_names.empty()) {
+        for(int i = 1; i <= 5; ++i)
+            file_names.push_back("TestData/Tree" + to_string(i) + ".tree");
+        const string synthetic_name = "/tmp/bench_parallel_load_4m.tree";
+        if(!write_random_tree_file(synthetic_name, 4000000)) {
+            fprintf(stderr, "ERROR: failed writing the tree file %s\n", synthetic_name.c_str());
+            return 1;
+        }
+        file_names.push_back(synthetic_name);
+    }
+
+    vector<unsigned> thread_counts;
+    const unsigned max_threads = max(1u, thread::hardware_concurrency());
+    for(unsigned n = 1; n < max_threads; n *= 2)
+        thread_counts.push_back(n);
+    thread_counts.push_back(max_threads);
+
+    printf("%-36s %-10s %10s %12s %10s %8s\n", "file", "loader", "nodes", "ms/load", "MB/s", "speedup");
+    for(const auto& f : file_names) {
+        CDAGTree<float> reference;
+        if(!reference.load_tree_file(f)) {
+            fprintf(stderr, "ERROR: failed loading the tree file %s\n", f.c_str());
+            return 1;
+        }
+        struct stat file_stat;
+        const double num_mbytes = stat(f.c_str(), &file_stat) == 0 ? double(file_stat.st_size) / 1e6 : 0.0;
+
+        double sequential_seconds = time_load(f, nullptr, 0.5, nullptr);
+        printf("%-36s %-10s %10zu %12.3f %10.1f %7.2fx\n", f.c_str(), "mapped",
+               reference.get_total_num_of_nodes(), sequential_seconds*1e3, num_mbytes/sequential_seconds, 1.0);
+        for(unsigned n : thread_counts) {
+            CWorkStealingPool a_pool(n);
+            double seconds = time_load(f, &a_pool, 0.5, &reference);
+            if(seconds < 0.0)
+                return 1;
+            string loader_name = "par x" + to_string(n);
+            printf("%-36s %-10s %10zu %12.3f %10.1f %7.2fx\n", f.c_str(), loader_name.c_str(),
+                   reference.get_total_num_of_nodes(), seconds*1e3, num_mbytes/seconds, sequential_seconds/seconds);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Show the frame times of the rendering thread with the level of detail selection done
+ * inline, as display() did, and on the worker thread of CSceneUpdater.
+ * Usage: bench_scene_updater [--frames N] [--pixel-error E] [tree file]
+ * Without a file a synthetic tree of 10^6 nodes is used. The camera circles the tree, one
+ * step per frame, and the frames are paced at 60 per second. For every frame the time the
+ * rendering thread spends is recorded, and its 50th, 95th and 99th percentiles are reported
+ * for both modes, with the time of the selection and the frames drawn without a new state.
+ * Both modes run once alone and once while another thread extracts the branches of the tree
+ * over and over, as a load in the background does. No OpenGL is needed.
+*/
+
+#include "bench_common.h"
+#include "../cdagtree.h"
+#include "../csceneupdater.h"
+#include "../ctreebranchlod.h"
+#include "../GLUtilities/transformation_3d.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// the time between two paced frames
+static const chrono::microseconds FRAME_INTERVAL(16667);
+
+struct CFrameStats {
+    vector<float> m_frame_ms;           // the time of the rendering thread in every frame
+    vector<float> m_select_ms;          // the time of every selection
+    int m_num_stale_frames;             // the frames drawn without a new state
+};
+
+static float get_percentile(vector<float> aTimes, double aFraction) {
+    if(aTimes.empty())
+        return 0.f;
+    vector<float>::iterator nth = aTimes.begin() + min(size_t(aFraction * aTimes.size()), aTimes.size() - 1);
+    nth_element(aTimes.begin(), nth, aTimes.end());
+    return *nth;
+}
+
+/*
+ * The camera of a frame, circling the tree at its own height.
+*/
+static Camera get_frame_camera(const Eigen::Vector3f& aCenter, float aDistance, int aFrame) {
+    const float angle = 0.01f * float(aFrame);
+    const Eigen::Vector3f eye = aCenter + aDistance * Eigen::Vector3f(sin(angle), 0.f, cos(angle));
+    return Camera(eye, aCenter, Eigen::Vector3f(0.f, 1.f, 0.f));
+}
+
+/*
+ * Run the paced frames, selecting on the rendering thread if aUpdater is null.
+*/
+static CFrameStats run_frames(const CTreeBranchLOD& aLod, CSceneUpdater* aUpdater, int aNumFrames,
+                              const Eigen::Vector3f& aCenter, float aDistance, const Eigen::Matrix4f& aProjMat,
+                              float aPixelScale, float aMaxPixelError) {
+    using clock = chrono::steady_clock;
+    CFrameStats stats;
+    stats.m_num_stale_frames = 0;
+    CSceneFrame a_frame;
+    vector<uint32_t> firsts;
+    vector<int> counts;
+    clock::time_point next_frame = clock::now();
+    for(int f = 0; f < aNumFrames; ++f) {
+        this_thread::sleep_until(next_frame);
+        next_frame += FRAME_INTERVAL;
+        clock::time_point start = clock::now();
+        const Camera a_camera = get_frame_camera(aCenter, aDistance, f);
+        if(aUpdater == nullptr) {
+            Eigen::Matrix4f view_mat = Camera(a_camera).get_view_mat();
+            CFrustum a_frustum(aProjMat, view_mat);
+            firsts.clear();
+            counts.clear();
+            aLod.select(a_camera.get_cam_pos(), aPixelScale, aMaxPixelError, 0, &a_frustum, firsts, counts);
+            stats.m_select_ms.push_back(chrono::duration<float, milli>(clock::now() - start).count());
+        } else {
+            // the input of the next frame, then the latest state
+            aUpdater->set_camera(a_camera);
+            aUpdater->request_frame();
+            if(aUpdater->take_frame(a_frame))
+                stats.m_select_ms.push_back(float(a_frame.m_update_seconds * 1e3));
+            else
+                ++stats.m_num_stale_frames;
+        }
+        stats.m_frame_ms.push_back(chrono::duration<float, milli>(clock::now() - start).count());
+    }
+    return stats;
+}
+
+int main(int argc, char** argv) {
+    string file_name;
+    int num_frames(240);
+    float max_pixel_error(1.f);
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            num_frames = max(atoi(argv[++i]), 1);
+        else if(strcmp(argv[i], "--pixel-error") == 0 && i + 1 < argc)
+            max_pixel_error = float(atof(argv[++i]));
+        else
+            file_name = argv[i];
+    }
+    bool is_synthetic = file_name.empty();
+    if(is_synthetic) {
+        file_name = "/tmp/bench_scene_updater_1000000.tree";
+        if(!write_random_tree_file(file_name, 1000000)) {
+            fprintf(stderr, "ERROR: could not write the synthetic tree %s\n", file_name.c_str());
+            return 1;
+        }
+    }
+
+    CDAGTree<float> a_tree;
+    if(!a_tree.load_tree_file(file_name)) {
+        fprintf(stderr, "ERROR: failed loading the tree file %s\n", file_name.c_str());
+        return 1;
+    }
+    a_tree.extract_branches();
+    CTreeBranchLOD a_lod;
+    a_lod.build(a_tree);
+    printf("%s: %zu nodes, %zu branches, %d frames at 60 per second\n", file_name.c_str(),
+           a_tree.get_total_num_of_nodes(), a_lod.get_num_branches(), num_frames);
+
+    CBBox<float> a_box;
+    a_tree.compute_bounding_box(a_box);
+    const Eigen::Vector3f center(0.5f*(a_box.m_x_min + a_box.m_x_max), 0.5f*(a_box.m_y_min + a_box.m_y_max),
+                                 0.5f*(a_box.m_z_min + a_box.m_z_max));
+    const float diagonal = Eigen::Vector3f(a_box.m_x_max - a_box.m_x_min, a_box.m_y_max - a_box.m_y_min,
+                                           a_box.m_z_max - a_box.m_z_min).norm();
+    const float pixel_scale = 600.f / (2.f * tan(float(M_PI) / 6.f));
+    const Eigen::Matrix4f proj_mat = perspective(60.f, 4.f / 3.f, 1e-3f * diagonal, 10.f * diagonal);
+
+    printf("%-10s %-10s %9s %9s %9s %12s %8s\n", "background", "selection", "p50 ms", "p95 ms", "p99 ms",
+           "select p50", "stale");
+    for(int with_load = 0; with_load < 2; ++with_load) {
+        // the background work, extracting the branches of a copy of the tree again and again
+        atomic<bool> is_stopping(false);
+        thread load_thread;
+        if(with_load) {
+            load_thread = thread([&file_name, &is_stopping]() {
+                while(!is_stopping.load()) {
+                    CDAGTree<float> a_copy;
+                    a_copy.load_tree_file(file_name);
+                    a_copy.extract_branches();
+                }
+            });
+        }
+        for(int decoupled = 0; decoupled < 2; ++decoupled) {
+            CSceneUpdater an_updater(get_frame_camera(center, 0.5f * diagonal, 0));
+            an_updater.set_view(proj_mat, Eigen::Matrix4f::Identity(), pixel_scale);
+            an_updater.set_lod_settings(max_pixel_error, true, 0);
+            an_updater.set_branch_lod(&a_lod);
+            CFrameStats stats = run_frames(a_lod, decoupled ? &an_updater : nullptr, num_frames, center,
+                                           0.5f * diagonal, proj_mat, pixel_scale, max_pixel_error);
+            printf("%-10s %-10s %9.3f %9.3f %9.3f %12.3f %8d\n", with_load ? "load" : "idle",
+                   decoupled ? "worker" : "inline", get_percentile(stats.m_frame_ms, 0.5),
+                   get_percentile(stats.m_frame_ms, 0.95), get_percentile(stats.m_frame_ms, 0.99),
+                   get_percentile(stats.m_select_ms, 0.5), stats.m_num_stale_frames);
+        }
+        is_stopping.store(true);
+        if(load_thread.joinable())
+            load_thread.join();
+    }
+
+    if(is_synthetic)
+        remove(file_name.c_str());
+    return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * Measure building the segment hierarchy and picking with it.
+ * Usage: bench_segment_picking [--threads N] [--rays N] [tree file]
+ * Without a file a synthetic tree of 10^6 nodes is used. The hierarchy is built serially
+ * and on a work-stealing pool (all the hardware threads by default), then random rays from
+ * one diagonal outside the tree towards random points of its bounding box are cast, at a
+ * minimum radius of 2 pixels of a 600 pixel viewport at that distance. The first rays are
+ * checked against intersecting every capsule, and the program fails on a mismatch.
+ * No OpenGL is needed.
+*/
+
+#include "bench_common.h"
+#include "../cdagtree.h"
+#include "../ctreesegmentbvh.h"
+#include "../cworkstealingpool.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+// the rays checked against every capsule
+static const int NUM_CHECKED_RAYS = 200;
+
+/*
+ * The distance at which the ray hits the capsule, or a negative value, as CTreeSegmentBVH does.
+*/
+static float intersect_capsule(const Eigen::Vector3f& aOrigin, const Eigen::Vector3f& aDir,
+                               const Eigen::Vector3f& aBegin, const Eigen::Vector3f& aEnd, float aRadius) {
+    const Eigen::Vector3f ba = aEnd - aBegin;
+    const Eigen::Vector3f oa = aOrigin - aBegin;
+    const float baba = ba.dot(ba), bard = ba.dot(aDir), baoa = ba.dot(oa);
+    const float a = baba - bard*bard;
+    float b = baba*aDir.dot(oa) - baoa*bard;
+    float c = baba*oa.dot(oa) - baoa*baoa - aRadius*aRadius*baba;
+    float h = b*b - a*c;
+    if(h < 0.f)
+        return -1.f;
+    float y = (bard > 0.f) ? 0.f : baba;
+    if(a > 0.f) {
+        const float t = (-b - sqrt(h)) / a;
+        y = baoa + t*bard;
+        if(y > 0.f && y < baba)
+            return t;
+    }
+    const Eigen::Vector3f oc = (y <= 0.f) ? oa : Eigen::Vector3f(aOrigin - aEnd);
+    b = aDir.dot(oc);
+    c = oc.dot(oc) - aRadius*aRadius;
+    h = b*b - c;
+    return h < 0.f ? -1.f : -b - sqrt(h);
+}
+
+/*
+ * The closest capsule distance of every parent-child segment, or a negative value.
+*/
+static float intersect_all(const CDAGTree<float>& aTree, const Eigen::Vector3f& aOrigin,
+                           const Eigen::Vector3f& aDir, float aMinRadius) {
+    float best(-1.f);
+    for(size_t i = 0; i < aTree.get_total_num_of_nodes(); ++i) {
+        const int p = aTree.get_parent_index(int(i));
+        if(p < 0)
+            continue;
+        const float radius = max(max(aTree.get_node_radius(p), aTree.get_node_radius(int(i))), aMinRadius);
+        const float t = intersect_capsule(aOrigin, aDir, aTree.get_node_position(p),
+                                          aTree.get_node_position(int(i)), radius);
+        if(t >= 0.f && (best < 0.f || t < best))
+            best = t;
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    string file_name;
+    unsigned num_threads(0);
+    int num_rays(100000);
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            num_threads = unsigned(atoi(argv[++i]));
+        else if(strcmp(argv[i], "--rays") == 0 && i + 1 < argc)
+            num_rays = max(atoi(argv[++i]), 1);
+        else
+            file_name = argv[i];
+    }
+    bool is_synthetic = file_name.empty();
+    if(is_synthetic) {
+        file_name = "/tmp/bench_segment_picking_1000000.tree";
+        if(!write_random_tree_file(file_name, 1000000)) {
+            fprintf(stderr, "ERROR: could not write the synthetic tree %s\n", file_name.c_str());
+            return 1;
+        }
+    }
+
+    CDAGTree<float> a_tree;
+    if(!a_tree.load_tree_file(file_name)) {
+        fprintf(stderr, "ERROR: failed loading the tree file %s\n", file_name.c_str());
+        return 1;
+    }
+
+    CTreeSegmentBVH serial_bvh, a_bvh;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    serial_bvh.build(a_tree);
+    double serial_seconds = seconds_since(start);
+    CWorkStealingPool a_pool(num_threads);
+    start = chrono::steady_clock::now();
+    a_bvh.build_parallel(a_tree, a_pool);
+    double parallel_seconds = seconds_since(start);
+    printf("%s: %zu segments, %zu hierarchy nodes, depth %d\n", file_name.c_str(), a_bvh.get_num_segments(),
+           a_bvh.get_num_nodes(), a_bvh.get_depth());
+    printf("build: serial %.1f ms, %u threads %.1f ms\n", serial_seconds*1e3, a_pool.get_num_threads(),
+           parallel_seconds*1e3);
+
+    Eigen::Vector3f box_min, box_max;
+    if(!a_bvh.get_bounding_box(box_min, box_max)) {
+        fprintf(stderr, "ERROR: the tree has no segments\n");
+        return 1;
+    }
+    const Eigen::Vector3f center = 0.5f * (box_min + box_max);
+    const float diagonal = (box_max - box_min).norm();
+    const float pixel_scale = 600.f / (2.f * tan(float(M_PI) / 6.f));
+    const float min_radius = 2.f * diagonal / pixel_scale;
+
+    mt19937 a_random(1);
+    uniform_real_distribution<float> unit(0.f, 1.f);
+    normal_distribution<float> gaussian(0.f, 1.f);
+    vector<Eigen::Vector3f> origins(static_cast<size_t>(num_rays)), directions(static_cast<size_t>(num_rays));
+    for(int r = 0; r < num_rays; ++r) {
+        Eigen::Vector3f outward(gaussian(a_random), gaussian(a_random), gaussian(a_random));
+        origins[r] = center + diagonal * outward.normalized();
+        const Eigen::Vector3f target = box_min + (box_max - box_min).cwiseProduct(
+                    Eigen::Vector3f(unit(a_random), unit(a_random), unit(a_random)));
+        directions[r] = (target - origins[r]).normalized();
+    }
+
+    bool is_correct(true);
+    for(int r = 0; r < min(num_rays, NUM_CHECKED_RAYS); ++r) {
+        CSegmentHit a_hit;
+        const bool is_hit = a_bvh.intersect(origins[r], directions[r], min_radius, a_hit);
+        const float expected = intersect_all(a_tree, origins[r], directions[r], min_radius);
+        if(is_hit != (expected >= 0.f) || (is_hit && fabs(a_hit.m_distance - expected) > 1e-4f * diagonal)) {
+            fprintf(stderr, "ERROR: ray %d hits at %g, expected %g\n", r, is_hit ? a_hit.m_distance : -1.f, expected);
+            is_correct = false;
+        }
+    }
+
+    size_t num_hits(0);
+    start = chrono::steady_clock::now();
+    for(int r = 0; r < num_rays; ++r) {
+        CSegmentHit a_hit;
+        num_hits += a_bvh.intersect(origins[r], directions[r], min_radius, a_hit) ? 1 : 0;
+    }
+    double query_seconds = seconds_since(start);
+    printf("pick: %d rays, %zu hits, %.2f us per ray\n", num_rays, num_hits, query_seconds / num_rays * 1e6);
+
+    if(is_synthetic)
+        remove(file_name.c_str());
+    return is_correct ? 0 : 1;
+}
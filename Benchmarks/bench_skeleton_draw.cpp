@@ -0,0 +1,204 @@
+/*
+ * Compare the two skeleton layouts in memory and draw time.
+ * Usage: bench_skeleton_draw [--no-gl] [--no-synthetic] [tree files...]
+ * Without tree files the TestData trees and a synthetic tree of 10^6 nodes
+ * (unless --no-synthetic) are used. The layouts are:
+ *  strips      every branch copies its node positions into its own line strip,
+ *              drawn with glMultiDrawArrays (the former CTreeSkeleton layout)
+ *  indexed     one vertex per node and the strips as an element array separated
+ *              by the primitive restart index, drawn with one glDrawElements
+ *              (CTreeSkeletonArrays)
+ * The buffer bytes of both layouts are always reported. Unless --no-gl is given, or no
+ * display is available, a hidden freeglut window is created and the draw calls are timed,
+ * each frame finished with glFinish.
+ * Besides the tree sources it needs ctreeskeletonarrays.cpp, GLEW and freeglut.
+*/
+
+#include "bench_common.h"
+#include "../cdagtree.h"
+#include "../ctreeskeletonarrays.h"
+
+#include "GL/glew.h"
+#include "GL/freeglut.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+/*
+ * The former skeleton layout: the positions of the nodes of every branch, strip after strip.
+*/
+struct CStripLayout {
+    vector<int> m_first_indices;
+    vector<int> m_count_vertices;
+    vector<float> m_vertex_positions;
+
+    void build(const CDAGTree<float>& aTree) {
+        int vertex_count(0);
+        for(const auto& bs : aTree.get_branches()) {
+            for(const auto& b : bs.get_branch_array()) {
+                m_first_indices.push_back(vertex_count);
+                m_count_vertices.push_back(int(b->get_branch_nodes_nums()));
+                for(int n : b->get_branch_nodes()) {
+                    m_vertex_positions.push_back(aTree.get_node_x(n));
+                    m_vertex_positions.push_back(aTree.get_node_y(n));
+                    m_vertex_positions.push_back(aTree.get_node_z(n));
+                    ++vertex_count;
+                }
+            }
+        }
+    }
+    // the vertex buffer and the strip arrays passed on every draw call
+    size_t get_num_bytes() const {
+        return sizeof(float)*m_vertex_positions.size() + sizeof(int)*(m_first_indices.size() + m_count_vertices.size());
+    }
+};
+
+static size_t get_num_bytes(const CTreeSkeletonArrays& aArrays) {
+    return sizeof(float)*aArrays.get_vertex_positions().size() + sizeof(uint32_t)*aArrays.get_num_elements();
+}
+
+/*
+ * Draw repeatedly until at least aMinSeconds have elapsed and 10 frames have passed.
+ * Returns the average milliseconds per frame.
+*/
+template<typename Draw>
+static double time_draw(Draw aDraw, double aMinSeconds) {
+    // the first frame includes the driver's validation of the buffers
+    aDraw();
+    glFinish();
+    int frames(0);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    do {
+        glClear(GL_COLOR_BUFFER_BIT);
+        aDraw();
+        glFinish();
+        ++frames;
+    } while(seconds_since(start) < aMinSeconds || frames < 10);
+    return seconds_since(start) * 1e3 / frames;
+}
+
+static unsigned create_vertex_array(const vector<float>& aPositions, unsigned aBuffers[2],
+                                    const vector<uint32_t>* aElements) {
+    unsigned vao(0);
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(2, aBuffers);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, aBuffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(sizeof(float)*aPositions.size()), aPositions.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    if(aElements != nullptr) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, aBuffers[1]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(sizeof(uint32_t)*aElements->size()),
+                     aElements->data(), GL_STATIC_DRAW);
+    }
+    glBindVertexArray(0);
+    return vao;
+}
+
+static void delete_vertex_array(unsigned aVao, unsigned aBuffers[2]) {
+    glDeleteBuffers(2, aBuffers);
+    glDeleteVertexArrays(1, &aVao);
+}
+
+static bool create_gl_context(int* argc, char** argv) {
+    if(getenv("DISPLAY") == nullptr && getenv("WAYLAND_DISPLAY") == nullptr)
+        return false;
+    glutInit(argc, argv);
+    glutInitContextProfile(GLUT_CORE_PROFILE);
+    glutInitContextVersion(4, 3);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE);
+    glutInitWindowSize(64, 64);
+    glutCreateWindow("bench_skeleton_draw");
+    glutHideWindow();
+    glewExperimental = GL_TRUE;
+    return glewInit() == GLEW_OK;
+}
+
+int main(int argc, char** argv) {
+    vector<string> file_names;
+    vector<string> temp_files;
+    bool use_gl(true), use_synthetic(true);
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--no-gl") == 0)
+            use_gl = false;
+        else if(strcmp(argv[i], "--no-synthetic") == 0)
+            use_synthetic = false;
+        else
+            file_names.push_back(argv[i]);
+    }
+    if(file_names.empty()) {
+        for(int i = 1; i <= 5; ++i)
+            file_names.push_back("TestData/Tree" + to_string(i) + ".tree");
+        if(use_synthetic) {
+            const string f = "/tmp/bench_skeleton_draw_1000000.tree";
+            if(!write_random_tree_file(f, 1000000)) {
+                fprintf(stderr, "ERROR: could not write the synthetic tree %s\n", f.c_str());
+                return 1;
+            }
+            file_names.push_back(f);
+            temp_files.push_back(f);
+        }
+    }
+    if(use_gl && !create_gl_context(&argc, argv)) {
+        fprintf(stderr, "No OpenGL context, only the memory is reported\n");
+        use_gl = false;
+    }
+
+    printf("%-40s %-8s %10s %10s %10s %12s %10s\n", "file", "layout", "branches", "vertices", "indices", "bytes", "ms/frame");
+    for(const auto& f : file_names) {
+        CDAGTree<float> a_tree;
+        if(!a_tree.load_tree_file(f)) {
+            fprintf(stderr, "ERROR: failed loading the tree file %s\n", f.c_str());
+            return 1;
+        }
+        a_tree.extract_branches();
+
+        CStripLayout strips;
+        strips.build(a_tree);
+        CTreeSkeletonArrays indexed;
+        indexed.build(a_tree);
+
+        double strips_ms(-1.0), indexed_ms(-1.0);
+        if(use_gl) {
+            unsigned buffers[2];
+            unsigned vao = create_vertex_array(strips.m_vertex_positions, buffers, nullptr);
+            strips_ms = time_draw([&]{
+                glBindVertexArray(vao);
+                glMultiDrawArrays(GL_LINE_STRIP, strips.m_first_indices.data(), strips.m_count_vertices.data(),
+                                  GLsizei(strips.m_first_indices.size()));
+            }, 0.5);
+            delete_vertex_array(vao, buffers);
+
+            vao = create_vertex_array(indexed.get_vertex_positions(), buffers, &indexed.get_element_indices());
+            glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+            indexed_ms = time_draw([&]{
+                glBindVertexArray(vao);
+                glDrawElements(GL_LINE_STRIP, GLsizei(indexed.get_num_elements()), GL_UNSIGNED_INT, (void*)0);
+            }, 0.5);
+            glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+            delete_vertex_array(vao, buffers);
+        }
+
+        printf("%-40s %-8s %10zu %10zu %10zu %12zu ", f.c_str(), "strips", strips.m_first_indices.size(),
+               strips.m_vertex_positions.size() / 3, size_t(0), strips.get_num_bytes());
+        if(strips_ms >= 0.0)
+            printf("%10.3f\n", strips_ms);
+        else
+            printf("%10s\n", "-");
+        printf("%-40s %-8s %10zu %10zu %10zu %12zu ", f.c_str(), "indexed", indexed.get_num_strips(),
+               indexed.get_num_vertices(), indexed.get_num_elements(), get_num_bytes(indexed));
+        if(indexed_ms >= 0.0)
+            printf("%10.3f\n", indexed_ms);
+        else
+            printf("%10s\n", "-");
+    }
+    for(const auto& f : temp_files)
+        remove(f.c_str());
+    return 0;
+}
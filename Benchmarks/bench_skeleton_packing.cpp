@@ -0,0 +1,97 @@
+/*
+ * Measure how the parallel skeleton packing scales with the number of threads.
+ * Usage: bench_skeleton_packing [tree file] [max threads]
+ * Without a file a synthetic tree of 4 * 10^6 nodes is used; the threads default
+ * to the number of hardware threads. Every parallel result is compared with
+ * the serial packing and the program fails if they differ.
+ * No OpenGL is needed.
+*/
+
+#include "bench_common.h"
+#include "../cdagtree.h"
+#include "../ctreeskeletonarrays.h"
+#include "../cworkstealingpool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+static bool is_identical(const CTreeSkeletonArrays& aLhs, const CTreeSkeletonArrays& aRhs) {
+    if(aLhs.get_num_strips() != aRhs.get_num_strips() || aLhs.get_num_levels() != aRhs.get_num_levels())
+        return false;
+    for(int l = 1; l <= aLhs.get_num_levels(); ++l) {
+        if(aLhs.get_num_elements_to_level(l) != aRhs.get_num_elements_to_level(l))
+            return false;
+    }
+    return aLhs.get_vertex_positions() == aRhs.get_vertex_positions()
+            && aLhs.get_element_indices() == aRhs.get_element_indices();
+}
+
+/*
+ * The best seconds of a few runs of aBuild(arrays), each on fresh arrays.
+*/
+template<typename Build>
+static double time_best(Build aBuild, CTreeSkeletonArrays& aResult) {
+    double best_seconds(0.0);
+    for(int r = 0; r < 5; ++r) {
+        CTreeSkeletonArrays arrays;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        aBuild(arrays);
+        double seconds = seconds_since(start);
+        if(r == 0 || seconds < best_seconds)
+            best_seconds = seconds;
+        if(r == 0)
+            aResult.swap(arrays);
+    }
+    return best_seconds;
+}
+
+int main(int argc, char** argv) {
+    string file_name = argc > 1 ? argv[1] : "";
+    unsigned max_threads = argc > 2 ? unsigned(atoi(argv[2])) : max(1u, thread::hardware_concurrency());
+    bool is_synthetic = file_name.empty();
+    if(is_synthetic) {
+        file_name = "/tmp/bench_skeleton_packing_4000000.tree";
+        if(!write_random_tree_file(file_name, 4000000)) {
+            fprintf(stderr, "ERROR: could not write the synthetic tree %s\n", file_name.c_str());
+            return 1;
+        }
+    }
+
+    CDAGTree<float> a_tree;
+    if(!a_tree.load_tree_file(file_name)) {
+        fprintf(stderr, "ERROR: failed loading the tree file %s\n", file_name.c_str());
+        return 1;
+    }
+    a_tree.extract_branches();
+
+    // the serial reference
+    CTreeSkeletonArrays reference;
+    double serial_seconds = time_best([&a_tree](CTreeSkeletonArrays& aArrays){ aArrays.build(a_tree); }, reference);
+
+    printf("%s: %zu nodes, %zu branches, %zu elements\n", file_name.c_str(),
+           a_tree.get_total_num_of_nodes(), reference.get_num_strips(), reference.get_num_elements());
+    printf("%-8s %12s %10s %10s\n", "threads", "pack ms", "speedup", "result");
+    printf("%-8s %12.3f %9.2fx %10s\n", "serial", serial_seconds*1e3, 1.0, "reference");
+
+    int exit_code(0);
+    for(unsigned n = 1; n <= max_threads; ++n) {
+        CWorkStealingPool a_pool(n);
+        CTreeSkeletonArrays arrays;
+        double seconds = time_best([&a_tree, &a_pool](CTreeSkeletonArrays& aArrays){
+            aArrays.build_parallel(a_tree, a_pool);
+        }, arrays);
+        bool is_same = is_identical(arrays, reference);
+        printf("%-8u %12.3f %9.2fx %10s\n", n, seconds*1e3, serial_seconds/seconds,
+               is_same ? "identical" : "DIFFERENT");
+        if(!is_same)
+            exit_code = 1;
+    }
+
+    if(is_synthetic)
+        remove(file_name.c_str());
+    return exit_code;
+}
@@ -0,0 +1,203 @@
+/*
+ * The micro-benchmark suite with machine-readable output.
+ * Usage: bench_suite [--csv] [--min-seconds S] [--no-synthetic] [tree files...]
+ * Without tree files the TestData trees and synthetic trees of 10^5 and 10^6 nodes
+ * (unless --no-synthetic) are used. The cases are:
+ *  load                load_tree_file of every tree
+ *  extract_branches    extract_branches of every tree
+ *  bounding_box        compute_bounding_box of every tree
+ *  skeleton_arrays     the GL-free skeleton vertex packing of every tree
+ *  camera_orientation  Camera::update_orientation followed by get_view_mat, as on a mouse move
+ *  quaternion_matrix   Quaternion::toMatrix
+ * Every case runs until at least the minimum time (0.3 s by default) and 3 runs have passed.
+ * The results are written to stdout as JSON, or as CSV with --csv, with ns per operation,
+ * ns per node, and allocations and allocated bytes per operation.
+ * Besides the tree sources it needs GLUtilities/camera.cpp, quaternion.cpp and transformation_3d.cpp.
+*/
+
+#include "bench_common.h"
+#include "../cdagtree.h"
+#include "../ctreeskeletonarrays.h"
+#include "../GLUtilities/camera.h"
+#include "../GLUtilities/quaternion.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+struct CBenchResult {
+    string m_case;
+    string m_input;
+    size_t m_num_nodes;         // the nodes processed per operation, 0 for the math kernels
+    long m_num_ops;
+    double m_ns_per_op;
+    double m_allocs_per_op;
+    double m_bytes_per_op;
+};
+
+/*
+ * Time aRun(state) on a fresh state from aPrepare() until at least aMinSeconds have elapsed
+ * and 3 runs have passed. Only aRun is timed and counted. Every run performs aOpsPerRun operations.
+*/
+template<typename Prepare, typename Run>
+static CBenchResult measure(const string& aCase, const string& aInput, size_t aNumNodes, long aOpsPerRun,
+                            double aMinSeconds, Prepare aPrepare, Run aRun) {
+    CAllocCounters& counters = alloc_counters();
+    int runs(0);
+    double elapsed(0.0);
+    size_t num_allocs(0), num_bytes(0);
+    do {
+        auto a_state = aPrepare();
+        size_t allocs_before = counters.m_num_allocs.load();
+        size_t bytes_before = counters.m_num_bytes.load();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        aRun(*a_state);
+        elapsed += seconds_since(start);
+        num_allocs += counters.m_num_allocs.load() - allocs_before;
+        num_bytes += counters.m_num_bytes.load() - bytes_before;
+        ++runs;
+    } while(elapsed < aMinSeconds || runs < 3);
+    const double num_ops = double(runs) * double(aOpsPerRun);
+    return CBenchResult{aCase, aInput, aNumNodes, long(num_ops), elapsed * 1e9 / num_ops,
+                        double(num_allocs) / num_ops, double(num_bytes) / num_ops};
+}
+
+static string json_string(const string& aText) {
+    string a_json("\"");
+    for(char c : aText) {
+        if(c == '"' || c == '\\')
+            a_json += '\\';
+        a_json += c;
+    }
+    return a_json + "\"";
+}
+
+static void print_results(const vector<CBenchResult>& aResults, bool aIsCsv) {
+    if(aIsCsv) {
+        printf("case,input,nodes,ops,ns_per_op,ns_per_node,allocs_per_op,bytes_per_op\n");
+        for(const auto& r : aResults) {
+            printf("%s,%s,%zu,%ld,%.3f,", r.m_case.c_str(), r.m_input.c_str(), r.m_num_nodes, r.m_num_ops, r.m_ns_per_op);
+            if(r.m_num_nodes > 0)
+                printf("%.4f", r.m_ns_per_op / double(r.m_num_nodes));
+            printf(",%.3f,%.1f\n", r.m_allocs_per_op, r.m_bytes_per_op);
+        }
+        return;
+    }
+    printf("{\"results\": [");
+    for(size_t i = 0; i < aResults.size(); ++i) {
+        const CBenchResult& r = aResults[i];
+        printf("%s\n  {\"case\": %s, \"input\": %s, \"nodes\": %zu, \"ops\": %ld, \"ns_per_op\": %.3f, \"ns_per_node\": ",
+               i == 0 ? "" : ",", json_string(r.m_case).c_str(), json_string(r.m_input).c_str(),
+               r.m_num_nodes, r.m_num_ops, r.m_ns_per_op);
+        if(r.m_num_nodes > 0)
+            printf("%.4f", r.m_ns_per_op / double(r.m_num_nodes));
+        else
+            printf("null");
+        printf(", \"allocs_per_op\": %.3f, \"bytes_per_op\": %.1f}", r.m_allocs_per_op, r.m_bytes_per_op);
+    }
+    printf("\n]}\n");
+}
+
+int main(int argc, char** argv) {
+    vector<string> file_names;
+    vector<string> temp_files;
+    bool is_csv(false), use_synthetic(true);
+    double min_seconds(0.3);
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--csv") == 0)
+            is_csv = true;
+        else if(strcmp(argv[i], "--no-synthetic") == 0)
+            use_synthetic = false;
+        else if(strcmp(argv[i], "--min-seconds") == 0 && i + 1 < argc)
+            min_seconds = atof(argv[++i]);
+        else
+            file_names.push_back(argv[i]);
+    }
+    if(file_names.empty()) {
+        for(int i = 1; i <= 5; ++i)
+            file_names.push_back("TestData/Tree" + to_string(i) + ".tree");
+        if(use_synthetic) {
+            for(long n : {100000L, 1000000L}) {
+                string f = "/tmp/bench_suite_" + to_string(n) + ".tree";
+                if(!write_random_tree_file(f, n)) {
+                    fprintf(stderr, "ERROR: could not write the synthetic tree %s\n", f.c_str());
+                    return 1;
+                }
+                file_names.push_back(f);
+                temp_files.push_back(f);
+            }
+        }
+    }
+
+    vector<CBenchResult> results;
+    for(const auto& f : file_names) {
+        // the tree the read-only cases run on
+        CDAGTree<float> a_tree;
+        if(!a_tree.load_tree_file(f)) {
+            fprintf(stderr, "ERROR: failed loading the tree file %s\n", f.c_str());
+            return 1;
+        }
+        a_tree.extract_branches();
+        const size_t num_nodes = a_tree.get_total_num_of_nodes();
+
+        results.push_back(measure("load", f, num_nodes, 1, min_seconds,
+            []{ return unique_ptr<CDAGTree<float>>(new CDAGTree<float>()); },
+            [&f](CDAGTree<float>& aTree){ aTree.load_tree_file(f); }));
+        results.push_back(measure("extract_branches", f, num_nodes, 1, min_seconds,
+            [&f]{
+                unique_ptr<CDAGTree<float>> a_loaded_tree(new CDAGTree<float>());
+                a_loaded_tree->load_tree_file(f);
+                return a_loaded_tree;
+            },
+            [](CDAGTree<float>& aTree){ aTree.extract_branches(); }));
+        // the bounding box is cheap, so every run takes several
+        const long num_box_ops = long(max<size_t>(1, 1000000 / num_nodes));
+        volatile float box_sink(0.f);
+        results.push_back(measure("bounding_box", f, num_nodes, num_box_ops, min_seconds,
+            []{ return unique_ptr<CBBox<float>>(new CBBox<float>()); },
+            [&a_tree, &box_sink, num_box_ops](CBBox<float>& aBox){
+                for(long i = 0; i < num_box_ops; ++i) {
+                    a_tree.compute_bounding_box(aBox);
+                    box_sink = box_sink + aBox.m_x_max;
+                }
+            }));
+        results.push_back(measure("skeleton_arrays", f, num_nodes, 1, min_seconds,
+            []{ return unique_ptr<CTreeSkeletonArrays>(new CTreeSkeletonArrays()); },
+            [&a_tree](CTreeSkeletonArrays& aArrays){ aArrays.build(a_tree); }));
+    }
+
+    const long num_math_ops(100000);
+    volatile float math_sink(0.f);
+    results.push_back(measure("camera_orientation", "", 0, num_math_ops, min_seconds,
+        []{
+            return unique_ptr<Camera>(new Camera(Eigen::Vector3f(0.f, 0.f, 5.f), Eigen::Vector3f(0.f, 0.f, 0.f),
+                                                 Eigen::Vector3f(0.f, 1.f, 0.f)));
+        },
+        [&math_sink, num_math_ops](Camera& aCamera){
+            for(long i = 0; i < num_math_ops; ++i) {
+                // alternate the mouse moves so the camera does not drift
+                float a_delta = (i & 1) ? 3.f : -3.f;
+                aCamera.update_orientation(a_delta, -a_delta);
+                math_sink = math_sink + aCamera.get_view_mat()(0, 0);
+            }
+        }));
+    results.push_back(measure("quaternion_matrix", "", 0, num_math_ops, min_seconds,
+        []{
+            Eigen::Vector3f a_axis(1.f, 2.f, 3.f);
+            return unique_ptr<Quaternion>(new Quaternion(0.3f, a_axis));
+        },
+        [&math_sink, num_math_ops](Quaternion& aQuat){
+            for(long i = 0; i < num_math_ops; ++i)
+                math_sink = math_sink + aQuat.toMatrix()(0, 1);
+        }));
+
+    print_results(results, is_csv);
+    for(const auto& f : temp_files)
+        remove(f.c_str());
+    return 0;
+}
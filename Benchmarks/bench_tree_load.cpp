@@ -0,0 +1,77 @@
+/*
+ * Compare the stream and the memory mapped tree file loaders.
+ * Usage: bench_tree_load [tree files...]
+ * Without arguments the bundled TestData trees are used.
+ * For every file and loader the throughput is reported in bytes/s and nodes/s.
+*/
+
+#include "../cdagtree.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+using namespace std;
+
+static size_t file_size_of(const string& aFileName) {
+    struct stat file_stat;
+    if(stat(aFileName.c_str(), &file_stat) != 0)
+        return 0;
+    return size_t(file_stat.st_size);
+}
+
+/*
+ * Load the file repeatedly until at least aMinSeconds have elapsed.
+ * Returns the average seconds per load, or a negative value on failure.
+*/
+static double time_load(const string& aFileName, TreeLoadMode aMode, double aMinSeconds, size_t& aNumNodes) {
+    using clock = chrono::steady_clock;
+    int runs(0);
+    double elapsed(0.0);
+    do {
+        CDAGTree<float> a_tree;
+        clock::time_point start = clock::now();
+        bool is_loaded = a_tree.load_tree_file(aFileName, aMode);
+        elapsed += chrono::duration<double>(clock::now() - start).count();
+        if(!is_loaded)
+            return -1.0;
+        aNumNodes = a_tree.get_total_num_of_nodes();
+        ++runs;
+    } while(elapsed < aMinSeconds || runs < 3);
+    return elapsed / runs;
+}
+
+int main(int argc, char** argv) {
+    vector<string> file_names;
+    for(int i = 1; i < argc; ++i)
+        file_names.push_back(argv[i]);
+    if(file_names.empty()) {
+        for(int i = 1; i <= 5; ++i)
+            file_names.push_back("TestData/Tree" + to_string(i) + ".tree");
+    }
+
+    const TreeLoadMode modes[] = {TreeLoadMode::Stream, TreeLoadMode::Mapped};
+    const char* mode_names[] = {"stream", "mapped"};
+
+    printf("%-32s %-8s %10s %10s %12s %14s %14s %8s\n",
+           "file", "loader", "bytes", "nodes", "ms/load", "MB/s", "Mnodes/s", "speedup");
+    for(const auto& f : file_names) {
+        size_t num_bytes = file_size_of(f);
+        double stream_seconds(0.0);
+        for(int m = 0; m < 2; ++m) {
+            size_t num_nodes(0);
+            double seconds = time_load(f, modes[m], 0.5, num_nodes);
+            if(seconds < 0.0) {
+                fprintf(stderr, "ERROR: failed loading the tree file %s\n", f.c_str());
+                return 1;
+            }
+            if(m == 0)
+                stream_seconds = seconds;
+            printf("%-32s %-8s %10zu %10zu %12.3f %14.2f %14.3f %7.2fx\n",
+                   f.c_str(), mode_names[m], num_bytes, num_nodes, seconds*1e3,
+                   num_bytes/seconds/1e6, num_nodes/seconds/1e6, stream_seconds/seconds);
+        }
+    }
+    return 0;
+}
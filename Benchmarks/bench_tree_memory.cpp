@@ -0,0 +1,64 @@
+/*
+ * Compare the default heap allocation and the per-tree arena allocation.
+ * Usage: bench_tree_memory [tree files...]
+ * Without arguments the TestData trees are used.
+ * For every file and mode the tree's steady-state and peak heap bytes are
+ * reported after loading and after the branch extraction, together with the
+ * number of heap allocations and the time of both steps. The tree counts the bytes
+ * it requests; the heap live column is what the allocator handed out for them,
+ * rounded up to its block sizes, while the tree is alive after the extraction.
+*/
+
+#include "bench_common.h"
+#include "../cdagtree.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+using namespace std;
+
+int main(int argc, char** argv) {
+    vector<string> file_names;
+    for(int i = 1; i < argc; ++i)
+        file_names.push_back(argv[i]);
+    if(file_names.empty()) {
+        for(int i = 1; i <= 5; ++i)
+            file_names.push_back("TestData/Tree" + to_string(i) + ".tree");
+    }
+
+    const TreeAllocMode modes[] = {TreeAllocMode::Default, TreeAllocMode::Arena};
+    const char* mode_names[] = {"default", "arena"};
+
+    printf("%-24s %-8s %8s %12s %12s %12s %12s %12s %10s %10s %10s\n",
+           "file", "mode", "nodes", "load bytes", "load peak", "total bytes", "total peak", "heap live",
+           "allocs", "load ms", "extract ms");
+    for(const auto& f : file_names) {
+        for(int m = 0; m < 2; ++m) {
+            size_t allocs_before = alloc_counters().m_num_allocs.load();
+            size_t live_before = alloc_counters().m_live_bytes.load();
+            CDAGTree<float> a_tree(modes[m]);
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            if(!a_tree.load_tree_file(f)) {
+                fprintf(stderr, "ERROR: failed loading the tree file %s\n", f.c_str());
+                return 1;
+            }
+            double load_seconds = seconds_since(start);
+            CTreeMemoryStats load_stats = a_tree.get_memory_stats();
+
+            start = chrono::steady_clock::now();
+            a_tree.extract_branches();
+            double extract_seconds = seconds_since(start);
+            CTreeMemoryStats total_stats = a_tree.get_memory_stats();
+            size_t num_allocs = alloc_counters().m_num_allocs.load() - allocs_before;
+            size_t heap_live = alloc_counters().m_live_bytes.load() - live_before;
+
+            printf("%-24s %-8s %8zu %12zu %12zu %12zu %12zu %12zu %10zu %10.3f %10.3f\n",
+                   f.c_str(), mode_names[m], a_tree.get_total_num_of_nodes(),
+                   load_stats.m_current_bytes, load_stats.m_peak_bytes,
+                   total_stats.m_current_bytes, total_stats.m_peak_bytes, heap_live,
+                   num_allocs, load_seconds*1e3, extract_seconds*1e3);
+        }
+    }
+    return 0;
+}
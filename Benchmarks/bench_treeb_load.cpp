@@ -0,0 +1,93 @@
+/*
+ * Compare loading the text tree files with loading their binary .treeb conversions.
+ * Usage: bench_treeb_load [tree files...]
+ * Without arguments the bundled TestData trees are used. Every file is converted
+ * to .treeb in /tmp, without and with the branch table, and these are timed:
+ *  text        load the text file
+ *  treeb       load the .treeb file
+ *  text+ext    load the text file and extract the branches
+ *  treeb+br    load the .treeb file holding the branch table
+*/
+
+#include "../cdagtree.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+using namespace std;
+
+/*
+ * Load (and extract) the file repeatedly until at least aMinSeconds have elapsed.
+ * Returns the average seconds per run, or a negative value on failure.
+*/
+static double time_load(const string& aFileName, bool aExtract, double aMinSeconds,
+                        size_t& aNumNodes, size_t& aNumBranches) {
+    using clock = chrono::steady_clock;
+    int runs(0);
+    double elapsed(0.0);
+    do {
+        CDAGTree<float> a_tree;
+        clock::time_point start = clock::now();
+        bool is_loaded = a_tree.load_tree_file(aFileName);
+        if(aExtract)
+            a_tree.extract_branches();
+        elapsed += chrono::duration<double>(clock::now() - start).count();
+        if(!is_loaded)
+            return -1.0;
+        aNumNodes = a_tree.get_total_num_of_nodes();
+        aNumBranches = a_tree.get_total_num_of_branches();
+        ++runs;
+    } while(elapsed < aMinSeconds || runs < 3);
+    return elapsed / runs;
+}
+
+int main(int argc, char** argv) {
+    vector<string> file_names;
+    for(int i = 1; i < argc; ++i)
+        file_names.push_back(argv[i]);
+    if(file_names.empty()) {
+        for(int i = 1; i <= 5; ++i)
+            file_names.push_back("TestData/Tree" + to_string(i) + ".tree");
+    }
+
+    printf("%-32s %-10s %10s %10s %12s %8s\n", "file", "path", "nodes", "branches", "ms/load", "speedup");
+    for(size_t f = 0; f < file_names.size(); ++f) {
+        // convert the file once without and once with the branch table
+        const string plain_name = "/tmp/bench_treeb_" + to_string(f) + ".treeb";
+        const string branch_name = "/tmp/bench_treeb_" + to_string(f) + "_br.treeb";
+        {
+            CDAGTree<float> a_tree;
+            if(!a_tree.load_tree_file(file_names[f]) || !a_tree.save_tree_binary_file(plain_name, false)) {
+                fprintf(stderr, "ERROR: failed converting the tree file %s\n", file_names[f].c_str());
+                return 1;
+            }
+            a_tree.extract_branches();
+            if(!a_tree.save_tree_binary_file(branch_name, true)) {
+                fprintf(stderr, "ERROR: failed converting the tree file %s\n", file_names[f].c_str());
+                return 1;
+            }
+        }
+
+        const string paths[] = {file_names[f], plain_name, file_names[f], branch_name};
+        const bool extracts[] = {false, false, true, true};
+        const char* path_names[] = {"text", "treeb", "text+ext", "treeb+br"};
+        double text_seconds(0.0);
+        for(int p = 0; p < 4; ++p) {
+            size_t num_nodes(0), num_branches(0);
+            double seconds = time_load(paths[p], extracts[p], 0.5, num_nodes, num_branches);
+            if(seconds < 0.0) {
+                fprintf(stderr, "ERROR: failed loading the tree file %s\n", paths[p].c_str());
+                return 1;
+            }
+            // each binary path is compared with the text path before it
+            if(p % 2 == 0)
+                text_seconds = seconds;
+            printf("%-32s %-10s %10zu %10zu %12.3f %7.2fx\n", file_names[f].c_str(), path_names[p],
+                   num_nodes, num_branches, seconds*1e3, text_seconds/seconds);
+        }
+        remove(plain_name.c_str());
+        remove(branch_name.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Measure the throughput of the tube mesh generation in triangles per second.
+ * Usage: bench_tube_mesh [--segments N] [--threads N] [tree files...]
+ * Without tree files the TestData trees and a synthetic tree of 10^6 nodes are used.
+ * Every tree is meshed serially and on work-stealing pools of 1 .. N threads
+ * (the hardware threads by default) with N radial segments (8 by default).
+ * Every parallel mesh is compared with the serial one and the program fails if they differ.
+ * No OpenGL is needed.
+*/
+
+#include "bench_common.h"
+#include "../cdagtree.h"
+#include "../ctreetubemesh.h"
+#include "../cworkstealingpool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/*
+ * The best seconds of a few runs of aBuild(mesh), each on a fresh mesh.
+ * The mesh of the first run is kept in aResult.
+*/
+template<typename Build>
+static double time_best(Build aBuild, CTreeTubeMesh& aResult) {
+    double best_seconds(0.0);
+    for(int r = 0; r < 3; ++r) {
+        CTreeTubeMesh a_mesh;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        aBuild(a_mesh);
+        double seconds = seconds_since(start);
+        if(r == 0 || seconds < best_seconds)
+            best_seconds = seconds;
+        if(r == 0)
+            aResult.swap(a_mesh);
+    }
+    return best_seconds;
+}
+
+int main(int argc, char** argv) {
+    vector<string> file_names;
+    vector<string> temp_files;
+    int num_segments(8);
+    unsigned max_threads = max(1u, thread::hardware_concurrency());
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--segments") == 0 && i + 1 < argc)
+            num_segments = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            max_threads = unsigned(max(1, atoi(argv[++i])));
+        else
+            file_names.push_back(argv[i]);
+    }
+    if(file_names.empty()) {
+        for(int i = 1; i <= 5; ++i)
+            file_names.push_back("TestData/Tree" + to_string(i) + ".tree");
+        const string f = "/tmp/bench_tube_mesh_1000000.tree";
+        if(!write_random_tree_file(f, 1000000)) {
+            fprintf(stderr, "ERROR: could not write the synthetic tree %s\n", f.c_str());
+            return 1;
+        }
+        file_names.push_back(f);
+        temp_files.push_back(f);
+    }
+
+    int exit_code(0);
+    printf("%-40s %-8s %12s %12s %10s %14s %10s\n",
+           "file", "threads", "vertices", "triangles", "ms", "Mtriangles/s", "result");
+    for(const auto& f : file_names) {
+        CDAGTree<float> a_tree;
+        if(!a_tree.load_tree_file(f)) {
+            fprintf(stderr, "ERROR: failed loading the tree file %s\n", f.c_str());
+            return 1;
+        }
+        a_tree.extract_branches();
+
+        CTreeTubeMesh reference;
+        double seconds = time_best([&](CTreeTubeMesh& aMesh){ aMesh.build(a_tree, num_segments); }, reference);
+        printf("%-40s %-8s %12zu %12zu %10.3f %14.2f %10s\n", f.c_str(), "serial", reference.get_num_vertices(),
+               reference.get_num_triangles(), seconds*1e3, reference.get_num_triangles()/seconds*1e-6, "reference");
+
+        for(unsigned n = 1; n <= max_threads; ++n) {
+            CWorkStealingPool a_pool(n);
+            CTreeTubeMesh a_mesh;
+            seconds = time_best([&](CTreeTubeMesh& aMesh){ aMesh.build_parallel(a_tree, a_pool, num_segments); }, a_mesh);
+            bool is_identical = a_mesh.get_positions() == reference.get_positions()
+                    && a_mesh.get_normals() == reference.get_normals()
+                    && a_mesh.get_indices() == reference.get_indices();
+            printf("%-40s %-8u %12zu %12zu %10.3f %14.2f %10s\n", f.c_str(), n, a_mesh.get_num_vertices(),
+                   a_mesh.get_num_triangles(), seconds*1e3, a_mesh.get_num_triangles()/seconds*1e-6,
+                   is_identical ? "identical" : "DIFFERENT");
+            if(!is_identical)
+                exit_code = 1;
+        }
+    }
+    for(const auto& f : temp_files)
+        remove(f.c_str());
+    return exit_code;
+}
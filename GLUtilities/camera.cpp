@@ -52,3 +52,17 @@ Eigen::Matrix4f Camera::get_view_mat() {
 	view_mat = view_mat * translate(-m_cam_pos);
 	return view_mat;
 }
+
+Eigen::Vector3f Camera::get_ray_direction(const Eigen::Matrix4f& aProjMat, float aX, float aY,
+                                          int aWidth, int aHeight) const {
+    // the window position in normalized device coordinates, on the far plane
+    Eigen::Vector4f ndc_pos(2.f * (aX + 0.5f) / float(aWidth) - 1.f,
+                            1.f - 2.f * (aY + 0.5f) / float(aHeight),
+                            1.f, 1.f);
+    Eigen::Vector4f view_pos = aProjMat.inverse() * ndc_pos;
+    Eigen::Vector3f view_dir = view_pos.head<3>() / view_pos.w();
+    // the view space axes are the right, up and backward directions of the camera
+    Eigen::Vector3f world_dir = view_dir.x() * m_cam_right_dir + view_dir.y() * m_cam_up_dir
+            - view_dir.z() * m_cam_front_dir;
+    return world_dir.normalized();
+}
@@ -20,6 +20,16 @@ public:
     */
 	Eigen::Matrix4f get_view_mat();
 
+    /*
+     * Get the unit direction of the world space ray from the camera position through
+     * a window position, for picking.
+     * aProjMat: the projection matrix the scene is rendered with
+     * aX, aY: the window position in pixels, y pointing down as GLUT reports it
+     * aWidth, aHeight: the window size in pixels
+    */
+    Eigen::Vector3f get_ray_direction(const Eigen::Matrix4f& aProjMat, float aX, float aY,
+                                      int aWidth, int aHeight) const;
+
 	Eigen::Vector3f get_cam_position() const {
 		return m_cam_pos;
 	}
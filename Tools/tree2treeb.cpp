@@ -0,0 +1,52 @@
+/*
+ * Convert a text tree file to the binary .treeb format.
+ * Usage: tree2treeb input.tree [output.treeb] [--branches]
+ * The output name defaults to the input name with the .treeb extension.
+ * With --branches the branches are extracted and stored in the file as well.
+*/
+
+#include "../cdagtree.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+using namespace std;
+
+int main(int argc, char** argv) {
+    vector<string> file_names;
+    bool with_branches(false);
+    for(int i = 1; i < argc; ++i) {
+        string an_arg(argv[i]);
+        if(an_arg == "--branches")
+            with_branches = true;
+        else
+            file_names.push_back(an_arg);
+    }
+    if(file_names.empty() || file_names.size() > 2) {
+        fprintf(stderr, "Usage: %s input.tree [output.treeb] [--branches]\n", argv[0]);
+        return 1;
+    }
+    if(file_names.size() == 1) {
+        string an_output = file_names[0];
+        size_t dot = an_output.find_last_of('.');
+        size_t slash = an_output.find_last_of('/');
+        if(dot != string::npos && (slash == string::npos || dot > slash))
+            an_output.erase(dot);
+        file_names.push_back(an_output + ".treeb");
+    }
+
+    CDAGTree<float> a_tree;
+    if(!a_tree.load_tree_file(file_names[0])) {
+        fprintf(stderr, "ERROR: failed loading the tree file %s\n", file_names[0].c_str());
+        return 1;
+    }
+    if(with_branches)
+        a_tree.extract_branches();
+    if(!a_tree.save_tree_binary_file(file_names[1], with_branches)) {
+        fprintf(stderr, "ERROR: failed writing the tree file %s\n", file_names[1].c_str());
+        return 1;
+    }
+    printf("%s: %zu nodes, %zu branches -> %s\n", file_names[0].c_str(), a_tree.get_total_num_of_nodes(),
+           a_tree.get_total_num_of_branches(), file_names[1].c_str());
+    return 0;
+}
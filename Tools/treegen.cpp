@@ -0,0 +1,59 @@
+/*
+ * Generate a synthetic random-branching tree file in the 7-column .tree format.
+ * Usage: treegen [options] output.tree
+ *  --nodes N       the number of nodes, default 100000 (e.g. 1e7 is accepted)
+ *  --seed S        the random seed, default 1
+ *  --max-depth D   the highest branch order, the trunk is 1; default 0 for no limit
+ *  --fan-out F     the most side branches forking off at one node, default 1
+ *  --step L        the distance between consecutive nodes, default 0.5
+ * The same options always produce the same file. See CTreeGenerator.
+*/
+
+#include "../ctreegenerator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+using namespace std;
+
+int main(int argc, char** argv) {
+    CTreeGeneratorParams params;
+    string file_name;
+    for(int i = 1; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if(strcmp(argv[i], "--nodes") == 0 && has_value)
+            params.m_num_nodes = long(atof(argv[++i]));
+        else if(strcmp(argv[i], "--seed") == 0 && has_value)
+            params.m_seed = uint32_t(strtoul(argv[++i], nullptr, 10));
+        else if(strcmp(argv[i], "--max-depth") == 0 && has_value)
+            params.m_max_depth = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--fan-out") == 0 && has_value)
+            params.m_fan_out = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--step") == 0 && has_value)
+            params.m_step_length = float(atof(argv[++i]));
+        else if(argv[i][0] != '-' && file_name.empty())
+            file_name = argv[i];
+        else {
+            fprintf(stderr, "ERROR: unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if(file_name.empty()) {
+        fprintf(stderr, "Usage: %s [--nodes N] [--seed S] [--max-depth D] [--fan-out F] [--step L] output.tree\n", argv[0]);
+        return 1;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    CTreeGenerator generator(params);
+    if(!generator.write_tree_file(file_name)) {
+        fprintf(stderr, "ERROR: failed writing the tree file %s\n", file_name.c_str());
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("%s: %ld nodes, %ld leaves, max order %d, %.2f s\n", file_name.c_str(),
+           generator.get_num_nodes_written(), generator.get_num_leaves_written(),
+           generator.get_max_order_written(), seconds);
+    return 0;
+}
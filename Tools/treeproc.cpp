@@ -0,0 +1,283 @@
+/*
+ * Process tree files without a window or an OpenGL context and report every stage as JSON.
+ * Usage: treeproc [--threads N] [--batch N] [--arena] [--cache] tree files or directories...
+ *  --threads N     load and extract on a work-stealing pool of N threads (0: one per hardware thread)
+ *  --batch N       load whole files concurrently (see CTreeBatchLoader), at most N in flight
+ *                  (0: twice the threads), instead of one file after another
+ *  --arena         allocate each tree from its own arena
+ *  --cache         read and write the branch cache next to every tree file
+ * A directory stands for all its .tree and .treeb files.
+ * For every file the stages load, extract_branches, compute_bounding_box and the skeleton
+ * vertex array build are timed, and the counts of each stage are reported, with a summary
+ * of the tag and order columns of the nodes. In the batch mode every file is loaded and
+ * extracted by one thread, and the throughput of every file and of the whole batch is
+ * reported instead of the memory: the bytes per second of the file, and for
+ * the batch the wall time against the bound of the total bytes over the threads times the
+ * average speed of one thread.
+ * The JSON document is written to stdout, the errors to stderr. The exit code is 1 if any
+ * file failed. The tool only needs ctreeskeletonarrays.cpp, ctreebatchloader.cpp,
+ * cmappedfile.cpp and cworkstealingpool.cpp, not GLEW or freeglut.
+*/
+
+#include "../cdagtree.h"
+#include "../ctreebatchloader.h"
+#include "../ctreeskeletonarrays.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+using namespace std;
+
+static string json_string(const string& aText) {
+    string a_json("\"");
+    for(char c : aText) {
+        if(c == '"' || c == '\\') {
+            a_json += '\\';
+            a_json += c;
+        } else if(static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", unsigned(c));
+            a_json += escaped;
+        } else {
+            a_json += c;
+        }
+    }
+    return a_json + "\"";
+}
+
+static double milliseconds_since(chrono::steady_clock::time_point aStart) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - aStart).count();
+}
+
+/*
+ * Print the bounding box, or null if it is empty or not finite: a tree without a valid
+ * position leaves the box inverted, or with nan or inf, which JSON has no numbers for.
+*/
+static void print_bbox(const CBBox<float>& aBox) {
+    const float bounds[6] = {aBox.m_x_min, aBox.m_y_min, aBox.m_z_min, aBox.m_x_max, aBox.m_y_max, aBox.m_z_max};
+    for(int i = 0; i < 3; ++i) {
+        if(!isfinite(bounds[i]) || !isfinite(bounds[i+3]) || bounds[i] > bounds[i+3]) {
+            printf("     \"bbox\": null,\n");
+            return;
+        }
+    }
+    printf("     \"bbox\": {\"min\": [%g, %g, %g], \"max\": [%g, %g, %g]},\n",
+           bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]);
+}
+
+/*
+ * Print the summary of the tag and order columns of the nodes, null if the file has none:
+ * the highest order, the highest tag and the number of tagged (non-zero) leaf nodes.
+*/
+static void print_node_attributes(const CDAGTree<float>& aTree) {
+    if(!aTree.has_node_attributes()) {
+        printf("     \"attributes\": null,\n");
+        return;
+    }
+    const int num_nodes = int(aTree.get_total_num_of_nodes());
+    int max_order(0), max_tag(0);
+    size_t num_tagged_leaves(0);
+    for(int i = 0; i < num_nodes; ++i) {
+        max_order = max(max_order, aTree.get_node_order(i));
+        max_tag = max(max_tag, aTree.get_node_tag(i));
+        num_tagged_leaves += aTree.is_leaf_node(i) && aTree.get_node_tag(i) != 0 ? 1 : 0;
+    }
+    printf("     \"attributes\": {\"max_order\": %d, \"max_tag\": %d, \"tagged_leaves\": %zu},\n",
+           max_order, max_tag, num_tagged_leaves);
+}
+
+/*
+ * Run all the stages on one file and print its JSON object.
+ * Returns false if the file can not be loaded.
+*/
+static bool process_tree_file(const string& aFileName, CWorkStealingPool* aPool,
+                              TreeAllocMode aAllocMode, bool aUseCache, bool aIsFirst) {
+    using clock = chrono::steady_clock;
+    clock::time_point total_start = clock::now();
+
+    CDAGTree<float> a_tree(aAllocMode);
+    a_tree.set_branch_cache_enabled(aUseCache);
+    clock::time_point start = clock::now();
+    bool is_loaded = aPool != nullptr ? a_tree.load_tree_file_parallel(aFileName, *aPool)
+                                      : a_tree.load_tree_file(aFileName);
+    double load_ms = milliseconds_since(start);
+
+    printf("%s\n    {\"file\": %s, \"ok\": %s", aIsFirst ? "" : ",", json_string(aFileName).c_str(),
+           is_loaded ? "true" : "false");
+    if(!is_loaded) {
+        fprintf(stderr, "ERROR: failed loading the tree file %s\n", aFileName.c_str());
+        printf("}");
+        return false;
+    }
+
+    start = clock::now();
+    if(aPool != nullptr)
+        a_tree.extract_branches_parallel(*aPool);
+    else
+        a_tree.extract_branches();
+    double extract_ms = milliseconds_since(start);
+
+    CBBox<float> a_box;
+    start = clock::now();
+    a_tree.compute_bounding_box(a_box);
+    double bbox_ms = milliseconds_since(start);
+
+    CTreeSkeletonArrays skeleton_arrays;
+    start = clock::now();
+    skeleton_arrays.build(a_tree);
+    double skeleton_ms = milliseconds_since(start);
+    double total_ms = milliseconds_since(total_start);
+
+    CTreeMemoryStats memory_stats = a_tree.get_memory_stats();
+    printf(",\n     \"nodes\": %zu, \"leaves\": %zu, \"branch_levels\": %zu, \"branches\": %zu,"
+           " \"branch_cache_hit\": %s,\n",
+           a_tree.get_total_num_of_nodes(), a_tree.get_num_leaf_nodes(),
+           a_tree.get_total_num_of_branch_levels(), a_tree.get_total_num_of_branches(),
+           a_tree.is_branch_cache_hit() ? "true" : "false");
+    print_node_attributes(a_tree);
+    print_bbox(a_box);
+    printf("     \"skeleton\": {\"strips\": %zu, \"vertices\": %zu, \"elements\": %zu},\n",
+           skeleton_arrays.get_num_strips(), skeleton_arrays.get_num_vertices(),
+           skeleton_arrays.get_num_elements());
+    printf("     \"memory\": {\"current_bytes\": %zu, \"peak_bytes\": %zu},\n",
+           memory_stats.m_current_bytes, memory_stats.m_peak_bytes);
+    printf("     \"timings_ms\": {\"load\": %.3f, \"extract_branches\": %.3f, \"compute_bounding_box\": %.3f,"
+           " \"skeleton_arrays\": %.3f, \"total\": %.3f}}",
+           load_ms, extract_ms, bbox_ms, skeleton_ms, total_ms);
+    return true;
+}
+
+/*
+ * Run the remaining stages on a tree of a batch and print its JSON object.
+*/
+static void print_batch_result(const CTreeBatchResult& aResult, bool aIsFirst) {
+    using clock = chrono::steady_clock;
+    printf("%s\n    {\"file\": %s, \"ok\": %s, \"bytes\": %zu", aIsFirst ? "" : ",",
+           json_string(aResult.m_file_name).c_str(), aResult.m_tree_ptr ? "true" : "false", aResult.m_num_bytes);
+    if(!aResult.m_tree_ptr) {
+        printf("}");
+        return;
+    }
+    const CDAGTree<float>& a_tree = *aResult.m_tree_ptr;
+    CBBox<float> a_box;
+    clock::time_point start = clock::now();
+    a_tree.compute_bounding_box(a_box);
+    double bbox_ms = milliseconds_since(start);
+    CTreeSkeletonArrays skeleton_arrays;
+    start = clock::now();
+    skeleton_arrays.build(a_tree);
+    double skeleton_ms = milliseconds_since(start);
+
+    const double load_seconds = aResult.m_load_seconds + aResult.m_extract_seconds;
+    printf(",\n     \"nodes\": %zu, \"leaves\": %zu, \"branch_levels\": %zu, \"branches\": %zu,"
+           " \"branch_cache_hit\": %s,\n",
+           a_tree.get_total_num_of_nodes(), a_tree.get_num_leaf_nodes(),
+           a_tree.get_total_num_of_branch_levels(), a_tree.get_total_num_of_branches(),
+           a_tree.is_branch_cache_hit() ? "true" : "false");
+    print_node_attributes(a_tree);
+    print_bbox(a_box);
+    printf("     \"skeleton\": {\"strips\": %zu, \"vertices\": %zu, \"elements\": %zu},\n",
+           skeleton_arrays.get_num_strips(), skeleton_arrays.get_num_vertices(),
+           skeleton_arrays.get_num_elements());
+    printf("     \"mb_per_s\": %.2f,\n", load_seconds > 0.0 ? aResult.m_num_bytes / load_seconds * 1e-6 : 0.0);
+    printf("     \"timings_ms\": {\"load\": %.3f, \"extract_branches\": %.3f, \"compute_bounding_box\": %.3f,"
+           " \"skeleton_arrays\": %.3f}}",
+           aResult.m_load_seconds*1e3, aResult.m_extract_seconds*1e3, bbox_ms, skeleton_ms);
+}
+
+/*
+ * The totals of a batch, see process_batch().
+*/
+struct CBatchStats {
+    size_t m_num_bytes;
+    double m_wall_seconds;
+    double m_thread_seconds;        // the load and extract seconds summed over the files
+};
+
+/*
+ * Load all the files with the batch loader and print the JSON object of every tree.
+ * Returns false if any file failed.
+*/
+static bool process_batch(const vector<string>& aFileNames, CWorkStealingPool& aPool, size_t aMaxInFlight,
+                          TreeAllocMode aAllocMode, bool aUseCache, CBatchStats& aStats) {
+    CTreeBatchLoader a_loader(aMaxInFlight);
+    a_loader.set_alloc_mode(aAllocMode);
+    a_loader.set_branch_cache_enabled(aUseCache);
+    aStats.m_num_bytes = 0;
+    aStats.m_thread_seconds = 0.0;
+    size_t num_results(0);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bool all_loaded = a_loader.load(aFileNames, aPool, [&](CTreeBatchResult& aResult) {
+        print_batch_result(aResult, num_results++ == 0);
+        aStats.m_num_bytes += aResult.m_num_bytes;
+        aStats.m_thread_seconds += aResult.m_load_seconds + aResult.m_extract_seconds;
+    });
+    aStats.m_wall_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return all_loaded;
+}
+
+int main(int argc, char** argv) {
+    vector<string> file_names;
+    int num_threads(-1);
+    int max_in_flight(-1);
+    TreeAllocMode alloc_mode(TreeAllocMode::Default);
+    bool use_cache(false);
+    for(int i = 1; i < argc; ++i) {
+        string an_arg(argv[i]);
+        if(an_arg == "--threads" && i + 1 < argc)
+            num_threads = atoi(argv[++i]);
+        else if(an_arg == "--batch" && i + 1 < argc)
+            max_in_flight = max(atoi(argv[++i]), 0);
+        else if(an_arg == "--arena")
+            alloc_mode = TreeAllocMode::Arena;
+        else if(an_arg == "--cache")
+            use_cache = true;
+        else if(an_arg.size() > 1 && an_arg[0] == '-') {
+            fprintf(stderr, "ERROR: unknown option %s\n", an_arg.c_str());
+            return 1;
+        } else {
+            struct stat file_stat;
+            if(stat(an_arg.c_str(), &file_stat) == 0 && S_ISDIR(file_stat.st_mode)) {
+                if(!CTreeBatchLoader::list_tree_files(an_arg, file_names))
+                    return 1;
+            } else
+                file_names.push_back(an_arg);
+        }
+    }
+    if(file_names.empty()) {
+        fprintf(stderr, "Usage: %s [--threads N] [--batch N] [--arena] [--cache] tree files or directories...\n", argv[0]);
+        return 1;
+    }
+
+    const bool is_batch = max_in_flight >= 0;
+    unique_ptr<CWorkStealingPool> a_pool;
+    if(num_threads >= 0 || is_batch)
+        a_pool.reset(new CWorkStealingPool(unsigned(max(num_threads, 0))));
+
+    printf("{\"threads\": %u, \"alloc_mode\": \"%s\", \"branch_cache\": %s,\n \"trees\": [",
+           a_pool ? a_pool->get_num_threads() : 0u, alloc_mode == TreeAllocMode::Arena ? "arena" : "default",
+           use_cache ? "true" : "false");
+    bool all_loaded(true);
+    if(is_batch) {
+        CBatchStats stats;
+        all_loaded = process_batch(file_names, *a_pool, size_t(max_in_flight), alloc_mode, use_cache, stats);
+        // the wall time the threads would take at their average speed, without waiting
+        const double bound_seconds = stats.m_thread_seconds / a_pool->get_num_threads();
+        printf("\n],\n \"batch\": {\"files\": %zu, \"bytes\": %zu, \"wall_ms\": %.3f, \"mb_per_s\": %.2f,"
+               " \"files_per_s\": %.2f,\n           \"thread_mb_per_s\": %.2f, \"bound_ms\": %.3f}}\n",
+               file_names.size(), stats.m_num_bytes, stats.m_wall_seconds*1e3,
+               stats.m_num_bytes / stats.m_wall_seconds * 1e-6, file_names.size() / stats.m_wall_seconds,
+               stats.m_thread_seconds > 0.0 ? stats.m_num_bytes / stats.m_thread_seconds * 1e-6 : 0.0,
+               bound_seconds*1e3);
+    } else {
+        for(size_t i = 0; i < file_names.size(); ++i)
+            all_loaded = process_tree_file(file_names[i], a_pool.get(), alloc_mode, use_cache, i == 0) && all_loaded;
+        printf("\n]}\n");
+    }
+    return all_loaded ? 0 : 1;
+}
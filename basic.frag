@@ -1,8 +1,14 @@
 #version 330 core
 
+in vec3 view_normal;
+
 out vec4 fragment_color;
 
 void main()
 {
-	fragment_color = vec4(0.0, 0.0, 1.0, 1.0);
-}
\ No newline at end of file
+	vec3 base_color = vec3(0.0, 0.0, 1.0);
+	// shade the surfaces by a light at the eye, the lines have no normal
+	if(dot(view_normal, view_normal) > 0.0)
+		base_color *= 0.3 + 0.7*abs(normalize(view_normal).z);
+	fragment_color = vec4(base_color, 1.0);
+}
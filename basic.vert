@@ -1,11 +1,24 @@
 #version 330 core
 layout(location=0) in vec3 vPosition;
+// the normals of the tube mesh, (0, 0, 0) for the line skeleton without a normal array
+layout(location=1) in vec3 vNormal;
+// the model matrix of every tree placed in a forest, read per instance
+layout(location=2) in mat4 vInstanceModel;
 
-//out vec3 fragment_color;
+out vec3 view_normal;
 
-uniform mat4 proj,view,model;
+// the camera and model matrices, in a uniform buffer shared by all the programs
+layout(std140) uniform Matrices {
+	mat4 proj;
+	mat4 view;
+	mat4 model;
+};
+// use vInstanceModel instead of model
+uniform bool instanced;
 
 void main()
 {
-	vec4 gl_Position = proj*view*model*vec4(vPosition, 1.0);
-}
\ No newline at end of file
+	mat4 model_mat = instanced ? vInstanceModel : model;
+	view_normal = mat3(view*model_mat)*vNormal;
+	gl_Position = proj*view*model_mat*vec4(vPosition, 1.0);
+}
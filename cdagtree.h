@@ -8,9 +8,23 @@
 #include <iostream>
 #include <memory>
 #include <limits>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <type_traits>
+#include <functional>
+#include <memory_resource>
 
 #include <Eigen/Dense>
 
+#include "cmappedfile.h"
+#include "ctreefilereader.h"
+#include "ctreearena.h"
+#include "ctreebinaryformat.h"
+#include "ctreebranchcache.h"
+#include "cworkstealingpool.h"
+
 template<typename T>
 struct CBBox {
     T m_x_min;
@@ -21,33 +35,41 @@ struct CBBox {
     T m_z_max;
 };
 
-template<typename T>
-struct CDAGNode {
-    // the 3d position
-    T m_x;
-    T m_y;
-    T m_z;
-
-    // the radius
-    T m_radius;
-
-    // the branch level this node belongs to
-    int m_branch_level;
+/*
+ * A read-only view of the indices of the child nodes of a tree node.
+*/
+struct CNodeIndexRange {
+    const int* m_begin;
+    const int* m_end;
 
-    // parent and child nodes
-    int m_num_children;
-    std::shared_ptr<CDAGNode> m_parent_node_ptr;
-    std::vector<std::shared_ptr<CDAGNode>> m_child_nodes;
+    const int* begin() const {
+        return m_begin;
+    }
+    const int* end() const {
+        return m_end;
+    }
+    size_t size() const {
+        return size_t(m_end - m_begin);
+    }
+    bool empty() const {
+        return m_begin == m_end;
+    }
+    int operator[](size_t i) const {
+        return m_begin[i];
+    }
 };
 
 /*
  * The branch consists of a number of nodes.
+ * The nodes are referred to by their indices in the tree.
+ * The node list is allocated from the given memory resource, e.g. the arena of the tree.
 */
 template<typename T>
 class CBranch {
 public:
-    CBranch():m_branch_level(-1){
-        m_branch_nodes.reserve(50);
+    explicit CBranch(std::pmr::memory_resource* aResource = std::pmr::get_default_resource())
+        :m_branch_level(-1),m_branch_nodes(aResource){
+
     }
     ~CBranch(){
         m_branch_nodes.clear();
@@ -56,7 +78,7 @@ public:
 
     }
     CBranch& operator=(const CBranch& aRhs){
-        if(*this != &aRhs) {
+        if(this != &aRhs) {
             m_branch_level = aRhs.m_branch_level;
             m_branch_nodes.clear();
             m_branch_nodes = aRhs.m_branch_nodes;
@@ -67,13 +89,24 @@ public:
     void set_branch_level(int aLevel) {
         m_branch_level = aLevel;
     }
-    void add_node(const std::shared_ptr<CDAGNode<T>>& aNodePtr) {
-        m_branch_nodes.push_back(aNodePtr);
+    int get_branch_level() const {
+        return m_branch_level;
     }
-    std::vector<std::shared_ptr<CDAGNode<T>>>& get_branch_nodes() {
+    void add_node(int aNodeIndex) {
+        m_branch_nodes.push_back(aNodeIndex);
+    }
+    /*
+     * Replace the branch nodes with the given ones, allocating exactly their number.
+    */
+    void set_nodes(const int* aBegin, const int* aEnd) {
+        m_branch_nodes.clear();
+        m_branch_nodes.reserve(size_t(aEnd - aBegin));
+        m_branch_nodes.insert(m_branch_nodes.end(), aBegin, aEnd);
+    }
+    std::pmr::vector<int>& get_branch_nodes() {
         return m_branch_nodes;
     }
-    const std::vector<std::shared_ptr<CDAGNode<T>>>& get_branch_nodes() const {
+    const std::pmr::vector<int>& get_branch_nodes() const {
         return m_branch_nodes;
     }
     size_t get_branch_nodes_nums() const {
@@ -81,17 +114,19 @@ public:
     }
 private:
     int m_branch_level;                                         // the branch level, e.g. the trunk is level 1.
-    std::vector<std::shared_ptr<CDAGNode<T>>> m_branch_nodes;   // store all the nodes belongs to this branch by shared pointers.
+    std::pmr::vector<int> m_branch_nodes;                       // store the indices of all the nodes belongs to this branch.
 };
 
 /*
  * Store all the branches having the same level id.
+ * The branch array is allocated from the given memory resource, e.g. the arena of the tree.
 */
 template<typename T>
 class CBranchLevelSet {
 public:
-    CBranchLevelSet(){
-        m_branch_array.reserve(100);
+    explicit CBranchLevelSet(std::pmr::memory_resource* aResource = std::pmr::get_default_resource())
+        :m_branch_array(aResource){
+
     }
     ~CBranchLevelSet(){
         m_branch_array.clear();
@@ -99,60 +134,161 @@ public:
     CBranchLevelSet(const CBranchLevelSet& aCopy):m_branch_array(aCopy.m_branch_array){
 
     }
+    CBranchLevelSet(CBranchLevelSet&& aOther)=default;
     CBranchLevelSet& operator=(const CBranchLevelSet& aRhs) {
-        if(*this != &aRhs) {
+        if(this != &aRhs) {
             m_branch_array.clear();
             m_branch_array = aRhs.m_branch_array;
         }
         return (*this);
     }
 public:
+    void reserve(size_t aNumBranches) {
+        m_branch_array.reserve(aNumBranches);
+    }
     void add_branch(const std::shared_ptr<CBranch<T>>& aBranchPtr) {
         m_branch_array.push_back(aBranchPtr);
     }
-    std::vector<std::shared_ptr<CBranch<T>>>& get_branch_array() {
+    std::pmr::vector<std::shared_ptr<CBranch<T>>>& get_branch_array() {
         return m_branch_array;
     }
-    const std::vector<std::shared_ptr<CBranch<T>>>& get_branch_array() const {
+    const std::pmr::vector<std::shared_ptr<CBranch<T>>>& get_branch_array() const {
         return m_branch_array;
     }
     size_t get_branch_nums() const {
         return m_branch_array.size();
     }
 private:
-    std::vector<std::shared_ptr<CBranch<T>>> m_branch_array;
+    std::pmr::vector<std::shared_ptr<CBranch<T>>> m_branch_array;
+};
+
+/*
+ * The ways a tree file can be read.
+ * Stream: line by line through std::getline and a string stream per line.
+ * Mapped: the file is memory mapped and the numbers are parsed in place.
+*/
+enum class TreeLoadMode {
+    Stream,
+    Mapped
 };
 
 /*
- * The Directed-Acyclic Tree. A adjacency-list representation is adopted here.
+ * The Directed-Acyclic Tree.
+ * The nodes are stored as a structure of arrays indexed by the node id, which is the
+ * position of the node in the depth-first pre-order of the tree file (the root is 0).
+ * The parent of each node is stored as an index, and the child nodes as a compressed
+ * sparse row (CSR) table: the children of node i are
+ * m_child_indices[m_child_offsets[i]] .. m_child_indices[m_child_offsets[i+1]-1].
+ * All the arrays and branches are allocated from the memory resource of the tree,
+ * which is either the heap or a per-tree arena (see TreeAllocMode). In the default
+ * mode a branch shared_ptr copied out of the tree stays valid after the tree is
+ * destroyed (see CTreeArena); in the arena mode it must not outlive the tree.
 */
 template<typename T>
 class CDAGTree
 {
     typedef Eigen::Matrix<T, 3, 1> Vector3t;
 public:
-    CDAGTree();
+    explicit CDAGTree(TreeAllocMode aAllocMode = TreeAllocMode::Default);
     ~CDAGTree();
-    // Shallow copys?
-    CDAGTree(const CDAGTree& aCopy);
-    CDAGTree& operator=(const CDAGTree& aRhs);
+    // The tree owns its memory resource.
+    CDAGTree(const CDAGTree& aCopy)=delete;
+    CDAGTree& operator=(const CDAGTree& aRhs)=delete;
 public:
     /*
      * Load a tree file. A Directed Acylic Graph (DAG) is built.
-     * The graph takes the adjacency-list represetation.
+     * The graph takes the flat parent-index and CSR child table represetation.
+     * The file is memory mapped by default. If the file can not be mapped
+     * (e.g. it is not a regular file) it is read through a stream instead.
+     * The node arrays are sized from the file before parsing.
+     * A binary .treeb file (see ctreebinaryformat.h) is recognized by its magic and
+     * copied section by section without parsing; if it holds the branch table the
+     * branches are restored as well.
      * Returns true if the tree file is read successfully, otherwise false.
     */
-    bool load_tree_file(const std::string& aFileName);
+    bool load_tree_file(const std::string& aFileName, TreeLoadMode aMode = TreeLoadMode::Mapped);
+    /*
+     * Load a tree file as load_tree_file() does with the mapped mode, parsing the numbers
+     * on the given work-stealing pool. The file is split into chunks at line boundaries,
+     * the lines of every chunk are parsed concurrently straight into the node arrays, and
+     * one linear pass then links the nodes from their child counts in pre-order.
+     * The resulting graph is identical to the one of the sequential load.
+    */
+    bool load_tree_file_parallel(const std::string& aFileName, CWorkStealingPool& aPool);
+    /*
+     * Save the tree to a binary .treeb file (see ctreebinaryformat.h).
+     * The positions and radii are stored as 32-bit floats. If aWithBranches is true
+     * and the branches have been extracted, the branch table is stored as well.
+     * Returns true if the file is written successfully, otherwise false.
+    */
+    bool save_tree_binary_file(const std::string& aFileName, bool aWithBranches) const;
     /*
      * Extract branches from the tree graph.
      * The branches are extracted by level. E.g. the trunk branch is at level 1,
      * and all the branches directly connected to the trunk branch is at level 2, so on so forth...
      * This is only a dirver function of a recursive extraction funtion.
+     * Nothing is done if the branches are already there, e.g. loaded from a .treeb file.
     */
     void extract_branches();
+    /*
+     * Extract branches as extract_branches() does, with the branch subtrees
+     * processed as independent tasks on the given work-stealing pool.
+     * Once a branch is fixed, the branches hanging off each of its nodes only touch
+     * that node's subtree, so they can be extracted concurrently. The branch sets
+     * are assembled afterwards in the serial order, so the result is identical.
+    */
+    void extract_branches_parallel(CWorkStealingPool& aPool);
+
+    /*
+     * Cache the extracted branches in a file next to the tree file (see ctreebranchcache.h).
+     * If enabled before load_tree_file, the name and the size of the tree file are recorded
+     * while loading, and the branch extraction hashes its content and reads the cache file
+     * instead when it matches the tree file and the extraction parameters. Otherwise the
+     * branches are extracted and the cache file is (re)written. The hash is left to the
+     * extraction so that loading, and a progressive display of it, does not wait for a pass
+     * over the whole file. Disabled by default.
+    */
+    void set_branch_cache_enabled(bool aEnabled) {
+        m_is_branch_cache_enabled = aEnabled;
+    }
+    bool is_branch_cache_enabled() const {
+        return m_is_branch_cache_enabled;
+    }
+    // true if the last branch extraction was served from the cache file
+    bool is_branch_cache_hit() const {
+        return m_is_branch_cache_hit;
+    }
+    // the cache file of the loaded tree file, empty if the tree file was not recorded
+    std::string get_branch_cache_file_name() const {
+        return m_source_file_name.empty() ? std::string() : m_source_file_name + TREEBC_FILE_SUFFIX;
+    }
+    /*
+     * The up direction followed by the trunk branch, (0, 1, 0) by default.
+     * It is one of the extraction parameters the cached branches are keyed by.
+    */
+    void set_trunk_up_direction(const Vector3t& aUpDir) {
+        m_trunk_up_dir = aUpDir;
+    }
+    const Vector3t& get_trunk_up_direction() const {
+        return m_trunk_up_dir;
+    }
+
+    /*
+     * Report the nodes while a tree file is loaded, e.g. to show a tree before it is complete.
+     * The callback is called on the loading thread with the range [aBegin, aEnd) of the new nodes,
+     * whose positions and parent indices can be read through the node accessors inside the call.
+     * A text file loaded sequentially is reported every aBatchSize nodes and once at the end,
+     * other loads once at the end. The child table may not be built yet inside the call.
+     * If the callback returns false, the load is cancelled and fails.
+    */
+    typedef std::function<bool(int aBegin, int aEnd)> LoadProgressCallback;
+    void set_load_progress_callback(LoadProgressCallback aCallback, int aBatchSize = 16384) {
+        m_load_progress_callback = std::move(aCallback);
+        m_load_progress_batch_size = std::max(aBatchSize, 1);
+    }
 
     size_t get_total_num_of_nodes() const {
-        return m_node_array.size();
+        return m_xs.size();
     }
 
     size_t get_total_num_of_branch_levels() const {
@@ -165,25 +301,192 @@ public:
         return branch_nums;
     }
 
-    const std::shared_ptr<CDAGNode<T>>& get_root_node_ptr() const {
-        return m_node_array[0];
+    int get_root_node_index() const {
+        return 0;
+    }
+
+    /*
+     * Node accessors. aNodeIndex is the node id in [0, get_total_num_of_nodes()).
+    */
+    T get_node_x(int aNodeIndex) const {
+        return m_xs[aNodeIndex];
+    }
+    T get_node_y(int aNodeIndex) const {
+        return m_ys[aNodeIndex];
+    }
+    T get_node_z(int aNodeIndex) const {
+        return m_zs[aNodeIndex];
+    }
+    Vector3t get_node_position(int aNodeIndex) const {
+        return Vector3t(m_xs[aNodeIndex], m_ys[aNodeIndex], m_zs[aNodeIndex]);
+    }
+    T get_node_radius(int aNodeIndex) const {
+        return m_radii[aNodeIndex];
+    }
+    // the 6th and 7th columns of the tree file (see CTreeRecord), 0 if the file has no such columns
+    int get_node_tag(int aNodeIndex) const {
+        return m_tags[aNodeIndex];
+    }
+    int get_node_order(int aNodeIndex) const {
+        return m_orders[aNodeIndex];
+    }
+    bool is_leaf_node(int aNodeIndex) const {
+        return m_child_offsets[aNodeIndex] == m_child_offsets[aNodeIndex+1];
+    }
+    // the branch level the node belongs to, 0 if not assigned to a branch
+    int get_node_branch_level(int aNodeIndex) const {
+        return m_branch_levels[aNodeIndex];
+    }
+    // the index of the parent node, -1 for the root node
+    int get_parent_index(int aNodeIndex) const {
+        return m_parent_indices[aNodeIndex];
+    }
+    int get_num_children(int aNodeIndex) const {
+        return m_child_offsets[aNodeIndex+1] - m_child_offsets[aNodeIndex];
+    }
+    CNodeIndexRange get_child_indices(int aNodeIndex) const {
+        return CNodeIndexRange{m_child_indices.data() + m_child_offsets[aNodeIndex],
+                               m_child_indices.data() + m_child_offsets[aNodeIndex+1]};
+    }
+
+    /*
+     * The whole node arrays, e.g. for bulk processing.
+    */
+    const std::pmr::vector<T>& get_node_xs() const {
+        return m_xs;
+    }
+    const std::pmr::vector<T>& get_node_ys() const {
+        return m_ys;
+    }
+    const std::pmr::vector<T>& get_node_zs() const {
+        return m_zs;
+    }
+    const std::pmr::vector<T>& get_node_radii() const {
+        return m_radii;
+    }
+    const std::pmr::vector<int>& get_parent_indices() const {
+        return m_parent_indices;
+    }
+    const std::pmr::vector<int>& get_node_tags() const {
+        return m_tags;
+    }
+    const std::pmr::vector<int>& get_node_orders() const {
+        return m_orders;
+    }
+    // true if the tree file carries the tag and order columns
+    bool has_node_attributes() const {
+        return m_has_node_attributes;
+    }
+    // the number of leaf nodes, counted when the child table is built
+    size_t get_num_leaf_nodes() const {
+        return m_num_leaf_nodes;
     }
 
-    const std::vector<CBranchLevelSet<T>>& get_branches() const {
+    const std::pmr::vector<CBranchLevelSet<T>>& get_branches() const {
         return m_branches_array;
     }
 
-    void compute_bounding_box(CBBox<T>& aBox);
+    TreeAllocMode get_alloc_mode() const {
+        return m_arena.get_mode();
+    }
+    /*
+     * The heap memory currently held by the tree and its peak since construction.
+    */
+    CTreeMemoryStats get_memory_stats() const {
+        return m_arena.get_memory_stats();
+    }
+
+    void compute_bounding_box(CBBox<T>& aBox) const;
 protected:
     /*
-     * Build the tree graph from a parent node in a depth-first recursive way.
-     * Params:
-     * inputs: the input file stream containing the nodes information
-     * aParentNodePtr: the pointer to the node where the tree nodes are to be handled
-     * aChildNum: the number of child nodes of the current node.
-     * The member array m_node_array is modified after calling this function.
+     * Load the tree from the mapped content of a .treeb file.
+     * Returns false if the header or the section sizes are not valid.
+    */
+    bool load_tree_binary(const char* aData, size_t aSize);
+
+    /*
+     * The branch sets flattened into CSR arrays, as they are stored in the binary files.
     */
-    void build_tree_graph_recursive(std::ifstream& inputs, std::shared_ptr<CDAGNode<T>>& aParentNodePtr, int aChildrenNum);
+    struct CBranchTable {
+        std::vector<int32_t> m_set_offsets;     // the branches of set s are m_set_offsets[s] .. m_set_offsets[s+1]-1
+        std::vector<int32_t> m_branch_levels;   // the level of every branch
+        std::vector<int32_t> m_node_offsets;    // the nodes of branch b are m_node_offsets[b] .. m_node_offsets[b+1]-1
+        std::vector<int32_t> m_branch_nodes;
+    };
+    void flatten_branch_table(CBranchTable& aTable) const;
+    /*
+     * Restore the node branch levels and the branch sets from the flattened arrays of a binary file.
+     * Returns false, leaving the branches unchanged, if the arrays are not valid.
+    */
+    bool restore_branch_table(const int32_t* aNodeBranchLevels,
+                              const int32_t* aSetOffsets,
+                              const int32_t* aBranchLevels,
+                              const int32_t* aNodeOffsets,
+                              const int32_t* aBranchNodes,
+                              int aNumSets, int aNumBranches, int aNumBranchNodes);
+
+    /*
+     * Record the name and the size of the loaded tree file for the branch cache.
+    */
+    void set_source_file(const std::string& aFileName, size_t aSize);
+    /*
+     * Hash the content of the recorded tree file, once. Returns false, and forgets the file,
+     * if it can not be mapped or its size changed since it was loaded.
+    */
+    bool hash_source_file();
+    uint64_t compute_extract_params_hash() const;
+    /*
+     * Restore the branches from the cache file if it matches the tree file and the parameters.
+     * Returns true if the branches are restored.
+    */
+    bool load_branch_cache();
+    void save_branch_cache() const;
+
+    /*
+     * Build the tree graph from the records provided by the reader.
+     * The records are in depth-first pre-order, each carrying its number of child nodes.
+     * The first record is taken as the root node. The graph is built iteratively
+     * with an explicit stack of open nodes, so the depth of the tree is not limited
+     * by the native stack size.
+     * The node arrays are filled after calling this function.
+     * Returns false if the first line is empty.
+    */
+    template<typename Reader>
+    bool build_tree_graph(Reader& aReader);
+    /*
+     * Build the tree graph from the lines of a memory block as build_tree_graph() does,
+     * parsing the chunks of the block on the pool.
+    */
+    bool build_tree_graph_parallel(const char* aBegin, const char* aEnd, CWorkStealingPool& aPool);
+
+    /*
+     * Report the loaded nodes [aBegin, aEnd) to the load progress callback, if any.
+     * Returns false if the callback cancels the load.
+    */
+    bool report_load_progress(int aBegin, int aEnd);
+
+    /*
+     * Append a node read from the tree file.
+     * Returns the index of the new node.
+    */
+    int add_node(const CTreeRecord<T>& aRecord, int aParentIndex);
+
+    /*
+     * Reserve the node arrays for the expected number of nodes, and in the arena mode
+     * the arena room for them and the child table.
+    */
+    void reserve_nodes(size_t aNumNodes);
+    /*
+     * In the arena mode, reserve the arena room for the branches of the loaded nodes.
+     * Every branch ends at a distinct leaf node, so the leaf count bounds the branches.
+    */
+    void reserve_branch_memory(size_t aNumSets, size_t aNumBranches, size_t aNumBranchNodes);
+
+    /*
+     * Build the CSR child table from the parent indices.
+     * The child nodes of every node keep the order in which they appear in the file.
+    */
+    void build_child_table();
 
     /*
      * Extract all the branches from a parent node recursively.
@@ -192,166 +495,837 @@ protected:
      * aParentNodePtr: the parent node to start.
     */
     void extract_branches_recursive(int aLevel,
-                                    std::vector<std::shared_ptr<CDAGNode<T>>>& aPreviousLevelBranch);
+                                    const std::pmr::vector<int>& aPreviousLevelBranch);
+
+    /*
+     * Create a branch at the given level holding exactly the given nodes.
+     * The branch is allocated from the given memory resource of the tree.
+    */
+    std::shared_ptr<CBranch<T>> create_branch(int aLevel, const int* aNodesBegin, const int* aNodesEnd,
+                                              std::pmr::memory_resource* aResource);
+
+    /*
+     * Reserve the branch sets and extract the trunk branch into the first branch set.
+     * Returns the trunk branch.
+    */
+    std::shared_ptr<CBranch<T>> extract_trunk_branch();
+
+    /*
+     * A branch extracted by the parallel extraction. Its task extracts the branches
+     * at the next level from the nodes of this branch, each becoming a child record,
+     * and collects them into the branch set of this branch.
+    */
+    struct CExtractRecord {
+        CBranch<T>* m_branch;                   // this branch, owned by the branch set of the parent record
+        CExtractRecord* m_first_child;          // the records of the branches at the next level,
+        CExtractRecord* m_next_sibling;         // linked in the serial order
+        CBranchLevelSet<T> m_branch_set;        // the branches of the child records
+    };
+
+    /*
+     * The state shared by all the tasks of a parallel extraction.
+    */
+    struct CExtractContext {
+        CWorkStealingPool* m_pool;
+        std::pmr::memory_resource* m_record_resource;   // the memory of the records, released at the end
+        std::vector<int> m_subtree_sizes;               // the number of nodes in the subtree of every node
+        int m_min_task_nodes;                           // the smallest subtree worth a task of its own
+    };
+
+    /*
+     * Run the extraction task of a record. Child records whose root node has a subtree
+     * of at least m_min_task_nodes nodes are submitted to the pool, smaller ones are
+     * processed by the calling thread.
+    */
+    void run_extract_task(CExtractRecord* aRecord, const CExtractContext& aContext);
 
     /*
      * A utility function to extract the branche at a specified level.
      * For the trunk (level 1), all the nodes with their direction to the parent node
      * closest to the 'up direction' is treated as a candidate trunk node. The 'up direction'
-     * of the trunk is set as the (0, 1, 0) direction in this implementation.
+     * of the trunk is (0, 1, 0) unless set by set_trunk_up_direction().
      * For other branches, the 'up direction' is defined as the direction from the first child node
      * to its parent node at the parent branch of the previous tree level.
      * Params:
      * aLevel: the branch level
-     * aBranchRootNodePtr: a pointer to the branch root node
+     * aBranchRootNodeIndex: the index of the branch root node
      * aUpDir: the up direction for the branch
-     * aBranch: the branch containing all the extracted nodes.
+     * aBranchNodes: the extracted node indices are appended to this array.
     */
     void extract_branch_at_level(int aLevel,
-                                 const std::shared_ptr<CDAGNode<T>>& aBranchRootNodePtr,
+                                 int aBranchRootNodeIndex,
                                  const Vector3t& aUpDir,
-                                 CBranch<T>& aBranch);
+                                 std::vector<int>& aBranchNodes);
 private:
-    std::vector<std::shared_ptr<CDAGNode<T>>> m_node_array; // store all the tree nodes using shared pointers.
-    std::vector<CBranchLevelSet<T>> m_branches_array;       // store all the branches at different levels
+    CTreeArena m_arena;                                     // the memory resource, destroyed after all the arrays
+    std::pmr::vector<T> m_xs;                               // the 3d positions of the nodes
+    std::pmr::vector<T> m_ys;
+    std::pmr::vector<T> m_zs;
+    std::pmr::vector<T> m_radii;                            // the radii of the nodes
+    std::pmr::vector<int> m_tags;                           // the tag and order attributes of the nodes
+    std::pmr::vector<int> m_orders;
+    std::pmr::vector<int> m_branch_levels;                  // the branch level each node belongs to
+    std::pmr::vector<int> m_parent_indices;                 // the parent node index of each node, -1 for the root
+    std::pmr::vector<int> m_child_offsets;                  // the CSR offsets into m_child_indices, one more than nodes
+    std::pmr::vector<int> m_child_indices;                  // the child node indices grouped by parent
+    std::pmr::vector<CBranchLevelSet<T>> m_branches_array;  // store all the branches at different levels
+    std::vector<int> m_branch_scratch;                      // the nodes of the branch being extracted
+    std::vector<std::shared_ptr<CBranch<T>>> m_branch_stack;// the branches of the level sets being extracted
+    Vector3t m_trunk_up_dir;                                // the up direction of the trunk branch
+    bool m_is_branch_cache_enabled;
+    bool m_is_branch_cache_hit;
+    std::string m_source_file_name;                         // the loaded tree file, empty if not recorded
+    bool m_is_source_hashed;
+    uint64_t m_source_hash;                                 // the content hash of the tree file
+    uint64_t m_source_size;
+    bool m_has_node_attributes;                             // the tree file has the tag and order columns
+    size_t m_num_leaf_nodes;
+    LoadProgressCallback m_load_progress_callback;          // see set_load_progress_callback()
+    int m_load_progress_batch_size;
 };
 
 template<typename T>
-CDAGTree<T>::CDAGTree() {
-    m_node_array.reserve(6000);
-    m_branches_array.reserve(2000);
+CDAGTree<T>::CDAGTree(TreeAllocMode aAllocMode) :
+    m_arena(aAllocMode),
+    m_xs(m_arena.resource()),
+    m_ys(m_arena.resource()),
+    m_zs(m_arena.resource()),
+    m_radii(m_arena.resource()),
+    m_tags(m_arena.resource()),
+    m_orders(m_arena.resource()),
+    m_branch_levels(m_arena.resource()),
+    m_parent_indices(m_arena.resource()),
+    m_child_offsets(m_arena.resource()),
+    m_child_indices(m_arena.resource()),
+    m_branches_array(m_arena.resource()),
+    m_trunk_up_dir(0, 1, 0),
+    m_is_branch_cache_enabled(false),
+    m_is_branch_cache_hit(false),
+    m_is_source_hashed(false),
+    m_source_hash(0),
+    m_source_size(0),
+    m_has_node_attributes(false),
+    m_num_leaf_nodes(0),
+    m_load_progress_batch_size(16384) {
+
 }
 
 template<typename T>
 CDAGTree<T>::~CDAGTree() {
-    m_node_array.clear();
+    // the branches hold memory of the arena, release them before it
     m_branches_array.clear();
 }
 
 template<typename T>
-CDAGTree<T>::CDAGTree(const CDAGTree<T>& aCopy) : m_node_array(aCopy.m_node_array){
+bool CDAGTree<T>::load_tree_file(const std::string& aFileName, TreeLoadMode aMode) {
+    if(aMode == TreeLoadMode::Mapped) {
+        CMappedFile mapped_file;
+        if(mapped_file.open(aFileName)) {
+            // an empty file is mapped without data, there is nothing to scan
+            if(mapped_file.size() == 0) {
+                std::cerr << "Error in reading the tree file: " << aFileName << " is empty!\n";
+                return false;
+            }
+            if(m_is_branch_cache_enabled)
+                set_source_file(aFileName, mapped_file.size());
+            if(is_treeb_data(mapped_file.data(), mapped_file.size()))
+                return load_tree_binary(mapped_file.data(), mapped_file.size())
+                        && report_load_progress(0, int(m_xs.size()));
+            const char* end = mapped_file.data() + mapped_file.size();
+            if(m_arena.get_mode() == TreeAllocMode::Arena) {
+                // the arena keeps every outgrown array, so the nodes are counted exactly first
+                size_t num_lines(0);
+                const char* p = mapped_file.data();
+                while((p = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)))) != nullptr) {
+                    ++num_lines;
+                    ++p;
+                }
+                reserve_nodes(num_lines + 1);
+            } else {
+                // estimate the node count from the file size, the first nodes are not kept waiting for a scan
+                reserve_nodes(mapped_file.size() / 40 + 1);
+            }
+            CTreeMappedReader<T> reader(mapped_file.data(), end);
+            return build_tree_graph(reader);
+        }
+    }
 
+    std::ifstream inputs(aFileName, std::ios::ate);
+    if(inputs.is_open()){
+        if(m_is_branch_cache_enabled)
+            set_source_file(aFileName, size_t(inputs.tellg()));
+        if(m_arena.get_mode() == TreeAllocMode::Arena) {
+            // the arena keeps every outgrown array, so the nodes are counted exactly first
+            inputs.seekg(0);
+            reserve_nodes(count_stream_lines(inputs) + 1);
+            inputs.clear();
+        } else {
+            // estimate the node count from the file size and a typical 7-column line
+            reserve_nodes(size_t(inputs.tellg()) / 40 + 1);
+        }
+        inputs.seekg(0);
+        CTreeStreamReader<T> reader(inputs);
+        return build_tree_graph(reader);
+    }
+    return false;
 }
 
 template<typename T>
-CDAGTree<T>& CDAGTree<T>::operator=(const CDAGTree<T>& aRhs) {
-    if(*this != &aRhs) {
-        m_node_array.clear();
-        m_node_array = aRhs.m_node_array;
+bool CDAGTree<T>::load_tree_file_parallel(const std::string& aFileName, CWorkStealingPool& aPool) {
+    CMappedFile mapped_file;
+    if(!mapped_file.open(aFileName))
+        return load_tree_file(aFileName, TreeLoadMode::Stream);
+    if(mapped_file.size() == 0) {
+        std::cerr << "Error in reading the tree file: " << aFileName << " is empty!\n";
+        return false;
     }
-    return (*this);
+    if(m_is_branch_cache_enabled)
+        set_source_file(aFileName, mapped_file.size());
+    if(is_treeb_data(mapped_file.data(), mapped_file.size()))
+        return load_tree_binary(mapped_file.data(), mapped_file.size())
+                && report_load_progress(0, int(m_xs.size()));
+    return build_tree_graph_parallel(mapped_file.data(), mapped_file.data() + mapped_file.size(), aPool)
+            && report_load_progress(0, int(m_xs.size()));
 }
 
 template<typename T>
-bool CDAGTree<T>::load_tree_file(const std::string& aFileName) {
-    std::ifstream inputs(aFileName);
-    if(inputs.is_open()){
-        // create the root node
-        std::shared_ptr<CDAGNode<T>> root_node_ptr(new CDAGNode<T>());
-        root_node_ptr->m_parent_node_ptr = nullptr;
-        std::string str_line;
-        std::getline(inputs, str_line, '\n');
-
-        // the first line of the the input file should not be an empty line
-        if(!str_line.empty()) {
-            std::stringstream ss(str_line);
-            ss >> root_node_ptr->m_x >> root_node_ptr->m_y >> root_node_ptr->m_z
-               >> root_node_ptr->m_radius >> root_node_ptr->m_num_children;
-            m_node_array.push_back(root_node_ptr);
+bool CDAGTree<T>::save_tree_binary_file(const std::string& aFileName, bool aWithBranches) const {
+    const bool with_branches = aWithBranches && !m_branches_array.empty();
+    CBranchTable a_table;
+    if(with_branches)
+        flatten_branch_table(a_table);
+
+    CTreeBinaryHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.m_magic, TREEB_MAGIC, sizeof(TREEB_MAGIC));
+    header.m_version = TREEB_VERSION;
+    header.m_flags = (with_branches ? TREEB_HAS_BRANCHES : 0u) | (m_has_node_attributes ? TREEB_HAS_ATTRIBUTES : 0u);
+    header.m_num_nodes = get_total_num_of_nodes();
+    header.m_num_child_indices = m_child_indices.size();
+    header.m_num_branch_sets = with_branches ? m_branches_array.size() : 0;
+    header.m_num_branches = a_table.m_branch_levels.size();
+    header.m_num_branch_nodes = a_table.m_branch_nodes.size();
+    CBBox<T> a_box;
+    compute_bounding_box(a_box);
+    const T box_values[6] = {a_box.m_x_min, a_box.m_x_max, a_box.m_y_min, a_box.m_y_max, a_box.m_z_min, a_box.m_z_max};
+    for(int i = 0; i < 6; ++i)
+        header.m_bbox[i] = float(box_values[i]);
+    const CTreeBinaryLayout layout = compute_treeb_layout(header);
+
+    std::ofstream outputs(aFileName, std::ios::binary | std::ios::trunc);
+    if(!outputs.is_open()) {
+        std::cerr << "Error in writing the tree file: can not open " << aFileName << "\n";
+        return false;
+    }
+    outputs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    auto write_section = [&outputs, &layout](int aSection, const void* aData) {
+        write_treeb_section(outputs, layout.m_offsets[aSection], aData, layout.m_sizes[aSection]);
+    };
+    // the positions and radii are stored as floats
+    auto write_float_section = [&write_section](int aSection, const std::pmr::vector<T>& aValues) {
+        if(std::is_same<T, float>::value) {
+            write_section(aSection, aValues.data());
         } else {
-            std::cerr << "Error in reading the tree file: the first line should be a non-empty line!\n";
-            return false;
+            std::vector<float> values(aValues.begin(), aValues.end());
+            write_section(aSection, values.data());
         }
+    };
+    write_float_section(CTreeBinaryLayout::X, m_xs);
+    write_float_section(CTreeBinaryLayout::Y, m_ys);
+    write_float_section(CTreeBinaryLayout::Z, m_zs);
+    write_float_section(CTreeBinaryLayout::RADIUS, m_radii);
+    write_section(CTreeBinaryLayout::PARENT, m_parent_indices.data());
+    write_section(CTreeBinaryLayout::CHILD_OFFSETS, m_child_offsets.data());
+    write_section(CTreeBinaryLayout::CHILD_INDICES, m_child_indices.data());
+    if(with_branches) {
+        write_section(CTreeBinaryLayout::NODE_BRANCH_LEVELS, m_branch_levels.data());
+        write_section(CTreeBinaryLayout::BRANCH_SET_OFFSETS, a_table.m_set_offsets.data());
+        write_section(CTreeBinaryLayout::BRANCH_LEVELS, a_table.m_branch_levels.data());
+        write_section(CTreeBinaryLayout::BRANCH_NODE_OFFSETS, a_table.m_node_offsets.data());
+        write_section(CTreeBinaryLayout::BRANCH_NODES, a_table.m_branch_nodes.data());
+    }
+    if(m_has_node_attributes) {
+        write_section(CTreeBinaryLayout::NODE_TAGS, m_tags.data());
+        write_section(CTreeBinaryLayout::NODE_ORDERS, m_orders.data());
+    }
+    return bool(outputs);
+}
 
-        build_tree_graph_recursive(inputs, root_node_ptr, root_node_ptr->m_num_children);
+template<typename T>
+bool CDAGTree<T>::load_tree_binary(const char* aData, size_t aSize) {
+    CTreeBinaryHeader header;
+    std::memcpy(&header, aData, sizeof(header));
+    if(header.m_version != TREEB_VERSION || !is_little_endian_host()) {
+        std::cerr << "Error in reading the tree file: unsupported .treeb version " << header.m_version << "\n";
+        return false;
+    }
+    const uint64_t max_count = uint64_t(std::numeric_limits<int>::max());
+    if(header.m_num_nodes == 0 || header.m_num_nodes >= max_count || header.m_num_child_indices >= max_count ||
+       header.m_num_branch_sets >= max_count || header.m_num_branches >= max_count ||
+       header.m_num_branch_nodes >= max_count) {
+        std::cerr << "Error in reading the tree file: invalid .treeb header!\n";
+        return false;
+    }
+    const CTreeBinaryLayout layout = compute_treeb_layout(header);
+    if(layout.m_file_size > aSize) {
+        std::cerr << "Error in reading the tree file: the .treeb file is truncated!\n";
+        return false;
+    }
+    // the sections are aligned within the page aligned mapping
+    auto section = [aData, &layout](int aSection) {
+        return reinterpret_cast<const int32_t*>(aData + layout.m_offsets[aSection]);
+    };
+    const int num_nodes = int(header.m_num_nodes);
+    const int num_child_indices = int(header.m_num_child_indices);
+
+    // the offsets must stay within their tables, the indices within the nodes
+    const int32_t* parents = section(CTreeBinaryLayout::PARENT);
+    if(parents[0] != -1 || !is_valid_treeb_indices(parents + 1, size_t(num_nodes - 1), num_nodes) ||
+       !is_valid_treeb_offsets(section(CTreeBinaryLayout::CHILD_OFFSETS), num_nodes, num_child_indices) ||
+       !is_valid_treeb_indices(section(CTreeBinaryLayout::CHILD_INDICES), size_t(num_child_indices), num_nodes)) {
+        std::cerr << "Error in reading the tree file: invalid .treeb tables!\n";
+        return false;
+    }
 
+    reserve_nodes(size_t(num_nodes));
+    // copy every section into its node array in one go
+    auto copy_float_section = [&layout, aData, num_nodes](int aSection, std::pmr::vector<T>& aValues) {
+        aValues.resize(size_t(num_nodes));
+        const char* a_section = aData + layout.m_offsets[aSection];
+        if(std::is_same<T, float>::value) {
+            std::memcpy(aValues.data(), a_section, layout.m_sizes[aSection]);
+        } else {
+            for(int i = 0; i < num_nodes; ++i) {
+                float a_value;
+                std::memcpy(&a_value, a_section + 4*size_t(i), 4);
+                aValues[i] = T(a_value);
+            }
+        }
+    };
+    auto copy_int_section = [&layout, aData](int aSection, std::pmr::vector<int>& aValues) {
+        aValues.resize(size_t(layout.m_sizes[aSection] / 4));
+        std::memcpy(aValues.data(), aData + layout.m_offsets[aSection], layout.m_sizes[aSection]);
+    };
+    copy_float_section(CTreeBinaryLayout::X, m_xs);
+    copy_float_section(CTreeBinaryLayout::Y, m_ys);
+    copy_float_section(CTreeBinaryLayout::Z, m_zs);
+    copy_float_section(CTreeBinaryLayout::RADIUS, m_radii);
+    copy_int_section(CTreeBinaryLayout::PARENT, m_parent_indices);
+    copy_int_section(CTreeBinaryLayout::CHILD_OFFSETS, m_child_offsets);
+    copy_int_section(CTreeBinaryLayout::CHILD_INDICES, m_child_indices);
+    m_has_node_attributes = (header.m_flags & TREEB_HAS_ATTRIBUTES) != 0;
+    if(m_has_node_attributes) {
+        copy_int_section(CTreeBinaryLayout::NODE_TAGS, m_tags);
+        copy_int_section(CTreeBinaryLayout::NODE_ORDERS, m_orders);
+    } else {
+        m_tags.assign(size_t(num_nodes), 0);
+        m_orders.assign(size_t(num_nodes), 0);
+    }
+    m_num_leaf_nodes = 0;
+    for(int i = 0; i < num_nodes; ++i)
+        m_num_leaf_nodes += m_child_offsets[i] == m_child_offsets[i+1] ? 1 : 0;
+    m_branch_levels.assign(size_t(num_nodes), 0);
+    if((header.m_flags & TREEB_HAS_BRANCHES) == 0)
         return true;
+
+    if(!restore_branch_table(section(CTreeBinaryLayout::NODE_BRANCH_LEVELS),
+                             section(CTreeBinaryLayout::BRANCH_SET_OFFSETS),
+                             section(CTreeBinaryLayout::BRANCH_LEVELS),
+                             section(CTreeBinaryLayout::BRANCH_NODE_OFFSETS),
+                             section(CTreeBinaryLayout::BRANCH_NODES),
+                             int(header.m_num_branch_sets), int(header.m_num_branches),
+                             int(header.m_num_branch_nodes))) {
+        std::cerr << "Error in reading the tree file: invalid .treeb branch table!\n";
+        return false;
     }
-    return false;
+    return true;
 }
 
 template<typename T>
-void CDAGTree<T>::build_tree_graph_recursive(std::ifstream& inputs, std::shared_ptr<CDAGNode<T>>& aParentNodePtr, int aChildrenNum) {
-    if(inputs.eof())
-        return ;
-    // create the child nodes for the current parent node
-    for(int i = 0; i < aChildrenNum; ++i) {
-        std::string str_line;
-        std::getline(inputs, str_line, '\n');
-        std::stringstream ss(str_line);
-        std::shared_ptr<CDAGNode<T>> child_node_ptr(new CDAGNode<T>());
-        ss >> child_node_ptr->m_x >> child_node_ptr->m_y >> child_node_ptr->m_z
-           >> child_node_ptr->m_radius >> child_node_ptr->m_num_children;
-        aParentNodePtr->m_child_nodes.push_back(child_node_ptr);
-        child_node_ptr->m_parent_node_ptr = aParentNodePtr;
-        m_node_array.push_back(child_node_ptr);
-        // recursively create the child nodes for this node
-        build_tree_graph_recursive(inputs, child_node_ptr, child_node_ptr->m_num_children);
+void CDAGTree<T>::flatten_branch_table(CBranchTable& aTable) const {
+    aTable.m_set_offsets.assign(1, 0);
+    aTable.m_set_offsets.reserve(m_branches_array.size() + 1);
+    aTable.m_branch_levels.clear();
+    aTable.m_node_offsets.assign(1, 0);
+    aTable.m_branch_nodes.clear();
+    for(const auto& bs : m_branches_array) {
+        for(const auto& b : bs.get_branch_array()) {
+            aTable.m_branch_levels.push_back(b->get_branch_level());
+            aTable.m_branch_nodes.insert(aTable.m_branch_nodes.end(),
+                                         b->get_branch_nodes().begin(), b->get_branch_nodes().end());
+            aTable.m_node_offsets.push_back(int32_t(aTable.m_branch_nodes.size()));
+        }
+        aTable.m_set_offsets.push_back(int32_t(aTable.m_branch_levels.size()));
     }
+}
+
+template<typename T>
+bool CDAGTree<T>::restore_branch_table(const int32_t* aNodeBranchLevels,
+                                       const int32_t* aSetOffsets,
+                                       const int32_t* aBranchLevels,
+                                       const int32_t* aNodeOffsets,
+                                       const int32_t* aBranchNodes,
+                                       int aNumSets, int aNumBranches, int aNumBranchNodes) {
+    const int num_nodes = int(get_total_num_of_nodes());
+    if(!is_valid_treeb_offsets(aSetOffsets, aNumSets, aNumBranches) ||
+       !is_valid_treeb_offsets(aNodeOffsets, aNumBranches, aNumBranchNodes) ||
+       !is_valid_treeb_indices(aBranchNodes, size_t(aNumBranchNodes), num_nodes))
+        return false;
 
+    std::memcpy(m_branch_levels.data(), aNodeBranchLevels, sizeof(int32_t)*size_t(num_nodes));
+    reserve_branch_memory(size_t(aNumSets), size_t(aNumBranches), size_t(aNumBranchNodes));
+    // the branch nodes are copied straight from the table
+    m_branches_array.reserve(size_t(aNumSets));
+    for(int s = 0; s < aNumSets; ++s) {
+        CBranchLevelSet<T> a_branch_set(m_arena.resource());
+        a_branch_set.reserve(size_t(aSetOffsets[s+1] - aSetOffsets[s]));
+        for(int b = aSetOffsets[s]; b < aSetOffsets[s+1]; ++b) {
+            a_branch_set.add_branch(create_branch(aBranchLevels[b], aBranchNodes + aNodeOffsets[b],
+                                                  aBranchNodes + aNodeOffsets[b+1], m_arena.resource()));
+        }
+        m_branches_array.push_back(std::move(a_branch_set));
+    }
+    return true;
 }
 
 template<typename T>
-void CDAGTree<T>::extract_branch_at_level(int aLevel,
-                                          const std::shared_ptr<CDAGNode<T>>& aBranchRootNodePtr,
-                                          const Vector3t& aUpDir,
-                                          CBranch<T>& aBranch) {
-        if(aBranchRootNodePtr->m_child_nodes.empty())   // reach a leaf node
+void CDAGTree<T>::set_source_file(const std::string& aFileName, size_t aSize) {
+    m_source_file_name = aFileName;
+    m_is_source_hashed = false;
+    m_source_hash = 0;
+    m_source_size = aSize;
+}
+
+template<typename T>
+bool CDAGTree<T>::hash_source_file() {
+    if(m_is_source_hashed)
+        return true;
+    if(m_source_file_name.empty())
+        return false;
+    // only the regular files can be mapped and hashed for the branch cache
+    CMappedFile mapped_file;
+    if(!mapped_file.open(m_source_file_name) || mapped_file.size() != m_source_size) {
+        m_source_file_name.clear();
+        return false;
+    }
+    m_source_hash = hash_tree_bytes(mapped_file.data(), mapped_file.size());
+    m_is_source_hashed = true;
+    return true;
+}
+
+template<typename T>
+uint64_t CDAGTree<T>::compute_extract_params_hash() const {
+    const int32_t a_version[2] = {TREE_BRANCH_EXTRACT_VERSION, int32_t(sizeof(T))};
+    const double a_up_dir[3] = {double(m_trunk_up_dir[0]), double(m_trunk_up_dir[1]), double(m_trunk_up_dir[2])};
+    return hash_tree_bytes(a_up_dir, sizeof(a_up_dir), hash_tree_bytes(a_version, sizeof(a_version)));
+}
+
+template<typename T>
+bool CDAGTree<T>::load_branch_cache() {
+    m_is_branch_cache_hit = false;
+    if(!m_is_branch_cache_enabled || !is_little_endian_host() || !hash_source_file())
+        return false;
+    CMappedFile cache_file;
+    if(!cache_file.open(get_branch_cache_file_name()) || cache_file.size() < sizeof(CTreeBranchCacheHeader))
+        return false;
+
+    // the cache must belong to this tree file and these extraction parameters
+    CTreeBranchCacheHeader header;
+    std::memcpy(&header, cache_file.data(), sizeof(header));
+    const uint64_t max_count = uint64_t(std::numeric_limits<int>::max());
+    if(std::memcmp(header.m_magic, TREEBC_MAGIC, sizeof(TREEBC_MAGIC)) != 0 ||
+       header.m_version != TREEBC_VERSION ||
+       header.m_source_hash != m_source_hash ||
+       header.m_source_size != m_source_size ||
+       header.m_params_hash != compute_extract_params_hash() ||
+       header.m_num_nodes != get_total_num_of_nodes() ||
+       header.m_num_branch_sets >= max_count || header.m_num_branches >= max_count ||
+       header.m_num_branch_nodes >= max_count)
+        return false;
+    const CTreeBranchCacheLayout layout = compute_branch_cache_layout(header);
+    if(layout.m_file_size > cache_file.size())
+        return false;
+
+    auto section = [&cache_file, &layout](int aSection) {
+        return reinterpret_cast<const int32_t*>(cache_file.data() + layout.m_offsets[aSection]);
+    };
+    m_is_branch_cache_hit = restore_branch_table(section(CTreeBranchCacheLayout::NODE_BRANCH_LEVELS),
+                                                 section(CTreeBranchCacheLayout::BRANCH_SET_OFFSETS),
+                                                 section(CTreeBranchCacheLayout::BRANCH_LEVELS),
+                                                 section(CTreeBranchCacheLayout::BRANCH_NODE_OFFSETS),
+                                                 section(CTreeBranchCacheLayout::BRANCH_NODES),
+                                                 int(header.m_num_branch_sets), int(header.m_num_branches),
+                                                 int(header.m_num_branch_nodes));
+    return m_is_branch_cache_hit;
+}
+
+template<typename T>
+void CDAGTree<T>::save_branch_cache() const {
+    if(!m_is_branch_cache_enabled || !m_is_source_hashed || !is_little_endian_host())
+        return;
+    CBranchTable a_table;
+    flatten_branch_table(a_table);
+
+    CTreeBranchCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.m_magic, TREEBC_MAGIC, sizeof(TREEBC_MAGIC));
+    header.m_version = TREEBC_VERSION;
+    header.m_source_hash = m_source_hash;
+    header.m_source_size = m_source_size;
+    header.m_params_hash = compute_extract_params_hash();
+    header.m_num_nodes = get_total_num_of_nodes();
+    header.m_num_branch_sets = m_branches_array.size();
+    header.m_num_branches = a_table.m_branch_levels.size();
+    header.m_num_branch_nodes = a_table.m_branch_nodes.size();
+    const CTreeBranchCacheLayout layout = compute_branch_cache_layout(header);
+
+    // write a temporary file and rename it, so that a reader never sees a partial cache
+    const std::string cache_file_name = get_branch_cache_file_name();
+    const std::string temp_file_name = cache_file_name + ".tmp";
+    {
+        std::ofstream outputs(temp_file_name, std::ios::binary | std::ios::trunc);
+        if(!outputs.is_open())
             return;
+        outputs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        const void* sections[CTreeBranchCacheLayout::NUM_SECTIONS] = {
+            m_branch_levels.data(), a_table.m_set_offsets.data(), a_table.m_branch_levels.data(),
+            a_table.m_node_offsets.data(), a_table.m_branch_nodes.data()
+        };
+        for(int i = 0; i < CTreeBranchCacheLayout::NUM_SECTIONS; ++i)
+            write_treeb_section(outputs, layout.m_offsets[i], sections[i], layout.m_sizes[i]);
+        if(!outputs) {
+            outputs.close();
+            std::remove(temp_file_name.c_str());
+            return;
+        }
+    }
+    if(std::rename(temp_file_name.c_str(), cache_file_name.c_str()) != 0)
+        std::remove(temp_file_name.c_str());
+}
+
+template<typename T>
+template<typename Reader>
+bool CDAGTree<T>::build_tree_graph(Reader& aReader) {
+    CTreeRecord<T> a_record;
+
+    // the first line of the the input file should not be an empty line
+    if(!aReader.read_record(a_record)) {
+        std::cerr << "Error in reading the tree file: the first line should be a non-empty line!\n";
+        return false;
+    }
+    m_has_node_attributes = aReader.get_num_columns_read() == CTreeFileSchema<T>::num_columns;
+    // create the root node
+    int root_index = add_node(a_record, -1);
+
+    // the open nodes on the path from the root to the current node,
+    // each with the number of its child nodes still to be read
+    struct COpenNode {
+        int m_node_index;
+        int m_remaining_children;
+    };
+    std::vector<COpenNode> open_nodes;
+    open_nodes.push_back({root_index, aReader.eof() ? 0 : a_record.m_num_children});
+    // the nodes before this one have been reported to the load progress callback
+    int num_reported(0);
+
+    while(!open_nodes.empty()) {
+        COpenNode& a_parent = open_nodes.back();
+        if(a_parent.m_remaining_children <= 0) {
+            open_nodes.pop_back();
+            continue;
+        }
+        --a_parent.m_remaining_children;
+
+        // create the next child node of the current parent node
+        aReader.read_record(a_record);
+        int child_index = add_node(a_record, a_parent.m_node_index);
 
+        // the child nodes of this node are read before its next sibling
+        open_nodes.push_back({child_index, aReader.eof() ? 0 : a_record.m_num_children});
+
+        if(m_load_progress_callback && child_index + 1 - num_reported >= m_load_progress_batch_size) {
+            if(!report_load_progress(num_reported, child_index + 1))
+                return false;
+            num_reported = child_index + 1;
+        }
+    }
+
+    if(!report_load_progress(num_reported, int(m_xs.size())))
+        return false;
+    build_child_table();
+    return true;
+}
+
+template<typename T>
+bool CDAGTree<T>::report_load_progress(int aBegin, int aEnd) {
+    if(!m_load_progress_callback || aBegin >= aEnd)
+        return true;
+    return m_load_progress_callback(aBegin, aEnd);
+}
+
+template<typename T>
+bool CDAGTree<T>::build_tree_graph_parallel(const char* aBegin, const char* aEnd, CWorkStealingPool& aPool) {
+    CTreeRecord<T> a_record;
+    CTreeMappedReader<T> first_reader(aBegin, aEnd);
+    // the first line of the the input file should not be an empty line
+    if(!first_reader.read_record(a_record)) {
+        std::cerr << "Error in reading the tree file: the first line should be a non-empty line!\n";
+        return false;
+    }
+    m_has_node_attributes = first_reader.get_num_columns_read() == CTreeFileSchema<T>::num_columns;
+
+    // split the block at line boundaries into a few chunks per thread of at least 1 MB each
+    const size_t a_size = size_t(aEnd - aBegin);
+    const size_t min_chunk_size = size_t(1) << 20;
+    const size_t num_chunks = std::max<size_t>(1, std::min<size_t>(size_t(aPool.get_num_threads()) * 4,
+                                                                   a_size / min_chunk_size));
+    std::vector<const char*> chunk_bounds(num_chunks + 1, aEnd);
+    chunk_bounds[0] = aBegin;
+    for(size_t i = 1; i < num_chunks; ++i) {
+        const char* p = std::max(aBegin + a_size / num_chunks * i, chunk_bounds[i-1]);
+        const char* line_end = static_cast<const char*>(std::memchr(p, '\n', size_t(aEnd - p)));
+        chunk_bounds[i] = (line_end == nullptr) ? aEnd : line_end + 1;
+    }
+
+    // count the lines of every chunk, then place the lines of each chunk after the previous ones
+    std::vector<size_t> line_offsets(num_chunks + 1, 0);
+    for(size_t i = 0; i < num_chunks; ++i) {
+        aPool.submit([&chunk_bounds, &line_offsets, i]{
+            const char* p = chunk_bounds[i];
+            const char* chunk_end = chunk_bounds[i+1];
+            size_t num_lines(0);
+            while((p = static_cast<const char*>(std::memchr(p, '\n', size_t(chunk_end - p)))) != nullptr) {
+                ++num_lines;
+                ++p;
+            }
+            // a last line without the line end
+            if(chunk_bounds[i] < chunk_end && chunk_end[-1] != '\n')
+                ++num_lines;
+            line_offsets[i+1] = num_lines;
+        });
+    }
+    aPool.wait();
+    for(size_t i = 0; i < num_chunks; ++i)
+        line_offsets[i+1] += line_offsets[i];
+    const size_t num_lines = line_offsets[num_chunks];
+
+    // every line becomes the record at its line number, an empty or malformed one is zeroed
+    reserve_nodes(num_lines);
+    m_xs.resize(num_lines);
+    m_ys.resize(num_lines);
+    m_zs.resize(num_lines);
+    m_radii.resize(num_lines);
+    m_tags.resize(num_lines);
+    m_orders.resize(num_lines);
+    std::vector<int> num_children(num_lines);
+    for(size_t i = 0; i < num_chunks; ++i) {
+        aPool.submit([this, &chunk_bounds, &line_offsets, &num_children, i]{
+            CTreeMappedReader<T> reader(chunk_bounds[i], chunk_bounds[i+1]);
+            CTreeRecord<T> a_chunk_record;
+            for(size_t n = line_offsets[i]; !reader.at_end(); ++n) {
+                reader.read_record(a_chunk_record);
+                m_xs[n] = a_chunk_record.m_x;
+                m_ys[n] = a_chunk_record.m_y;
+                m_zs[n] = a_chunk_record.m_z;
+                m_radii[n] = a_chunk_record.m_radius;
+                m_tags[n] = a_chunk_record.m_tag;
+                m_orders[n] = a_chunk_record.m_order;
+                num_children[n] = a_chunk_record.m_num_children;
+            }
+        });
+    }
+    aPool.wait();
+
+    // the sequential readers reach the end of the file with a last line without a line end,
+    // and then do not read its child nodes; after a line end they read them as zeroed nodes
+    if(aEnd[-1] != '\n')
+        num_children[num_lines - 1] = 0;
+    m_branch_levels.assign(num_lines, 0);
+    m_parent_indices.resize(num_lines);
+    m_parent_indices[0] = -1;
+
+    // link the nodes in pre-order, as build_tree_graph() does
+    struct COpenNode {
+        int m_node_index;
+        int m_remaining_children;
+    };
+    std::vector<COpenNode> open_nodes;
+    open_nodes.push_back({0, num_children[0]});
+    int num_nodes(1);
+    while(!open_nodes.empty()) {
+        COpenNode& a_parent = open_nodes.back();
+        if(a_parent.m_remaining_children <= 0) {
+            open_nodes.pop_back();
+            continue;
+        }
+        --a_parent.m_remaining_children;
+        const int parent_index = a_parent.m_node_index;
+
+        int child_index = num_nodes++;
+        if(size_t(child_index) < num_lines) {
+            m_parent_indices[child_index] = parent_index;
+            open_nodes.push_back({child_index, num_children[child_index]});
+        } else {
+            // the file ends before the tree, the missing nodes are zeroed
+            add_node(CTreeRecord<T>(), parent_index);
+            open_nodes.push_back({child_index, 0});
+        }
+    }
+    // the lines after the last node are not part of the tree
+    if(size_t(num_nodes) < num_lines) {
+        m_xs.resize(size_t(num_nodes));
+        m_ys.resize(size_t(num_nodes));
+        m_zs.resize(size_t(num_nodes));
+        m_radii.resize(size_t(num_nodes));
+        m_tags.resize(size_t(num_nodes));
+        m_orders.resize(size_t(num_nodes));
+        m_branch_levels.resize(size_t(num_nodes));
+        m_parent_indices.resize(size_t(num_nodes));
+    }
+
+    build_child_table();
+    return true;
+}
+
+template<typename T>
+int CDAGTree<T>::add_node(const CTreeRecord<T>& aRecord, int aParentIndex) {
+    m_xs.push_back(aRecord.m_x);
+    m_ys.push_back(aRecord.m_y);
+    m_zs.push_back(aRecord.m_z);
+    m_radii.push_back(aRecord.m_radius);
+    m_tags.push_back(aRecord.m_tag);
+    m_orders.push_back(aRecord.m_order);
+    m_branch_levels.push_back(0);
+    m_parent_indices.push_back(aParentIndex);
+    return int(m_xs.size()) - 1;
+}
+
+template<typename T>
+void CDAGTree<T>::reserve_nodes(size_t aNumNodes) {
+    // the eight node arrays, then the child offsets and indices, and the alignment of every array
+    m_arena.reserve(aNumNodes * (4*sizeof(T) + 4*sizeof(int)) + (2*aNumNodes + 1) * sizeof(int) +
+                    10 * alignof(std::max_align_t));
+    m_xs.reserve(aNumNodes);
+    m_ys.reserve(aNumNodes);
+    m_zs.reserve(aNumNodes);
+    m_radii.reserve(aNumNodes);
+    m_tags.reserve(aNumNodes);
+    m_orders.reserve(aNumNodes);
+    m_branch_levels.reserve(aNumNodes);
+    m_parent_indices.reserve(aNumNodes);
+}
+
+template<typename T>
+void CDAGTree<T>::reserve_branch_memory(size_t aNumSets, size_t aNumBranches, size_t aNumBranchNodes) {
+    if(m_arena.get_mode() != TreeAllocMode::Arena)
+        return;
+    // a branch is one block of its object and reference counts (see create_branch()),
+    // its node array, padded to the pointers after it, and its pointer in a set
+    const size_t branch_block = sizeof(CBranch<T>) + 3 * sizeof(void*);
+    m_arena.reserve(aNumSets * sizeof(CBranchLevelSet<T>) +
+                    aNumBranches * (branch_block + sizeof(std::shared_ptr<CBranch<T>>) + sizeof(int)) +
+                    aNumBranchNodes * sizeof(int) + alignof(std::max_align_t));
+}
+
+template<typename T>
+void CDAGTree<T>::build_child_table() {
+    const int num_nodes = int(m_parent_indices.size());
+    // count the child nodes of every node, then turn the counts into offsets
+    m_child_offsets.assign(num_nodes + 1, 0);
+    for(int i = 0; i < num_nodes; ++i) {
+        if(m_parent_indices[i] >= 0)
+            ++m_child_offsets[m_parent_indices[i] + 1];
+    }
+    m_num_leaf_nodes = 0;
+    for(int i = 0; i < num_nodes; ++i) {
+        m_num_leaf_nodes += m_child_offsets[i+1] == 0 ? 1 : 0;
+        m_child_offsets[i+1] += m_child_offsets[i];
+    }
+
+    // place the child nodes in increasing index order, i.e. in file order
+    m_child_indices.resize(m_child_offsets[num_nodes]);
+    std::vector<int> next_slots(m_child_offsets.begin(), m_child_offsets.end() - 1);
+    for(int i = 0; i < num_nodes; ++i) {
+        if(m_parent_indices[i] >= 0)
+            m_child_indices[next_slots[m_parent_indices[i]]++] = i;
+    }
+}
+
+template<typename T>
+void CDAGTree<T>::extract_branch_at_level(int aLevel,
+                                          int aBranchRootNodeIndex,
+                                          const Vector3t& aUpDir,
+                                          std::vector<int>& aBranchNodes) {
+    int a_current_node = aBranchRootNodeIndex;
+    // follow the branch from node to node until a leaf node is reached
+    while(get_num_children(a_current_node) > 0) {
         // find the internode from the current root node to the child nodes
         // that is in a direction closest to the up dir;
-        std::shared_ptr<CDAGNode<T>> a_branch_node_ptr{};
+        int a_branch_node(-1);
         T min_abs_dot_value = std::numeric_limits<T>::max();
         // set the root node's position
-        Vector3t a_root_pos(aBranchRootNodePtr->m_x, aBranchRootNodePtr->m_y, aBranchRootNodePtr->m_z);
+        Vector3t a_root_pos = get_node_position(a_current_node);
 
         // iterate through all the child nodes of the current node to find the branch node
-        for(const auto& n : aBranchRootNodePtr->m_child_nodes) {
-            if(n->m_branch_level > 0) // the node is already handled (default should be 0)
+        for(int n : get_child_indices(a_current_node)) {
+            if(m_branch_levels[n] > 0) // the node is already handled (default should be 0)
                 continue;
-            Vector3t a_dir = Vector3t(n->m_x, n->m_y, n->m_z) - a_root_pos;
+            Vector3t a_dir = get_node_position(n) - a_root_pos;
             a_dir.normalize();
             T a_dot_value = abs(aUpDir.dot(a_dir));
             // record the node with the closet direction
             if(a_dot_value < min_abs_dot_value){
                 min_abs_dot_value = a_dot_value;
-                a_branch_node_ptr = n;
+                a_branch_node = n;
             }
         }
 
         // add the found branch node
-        a_branch_node_ptr->m_branch_level = aLevel;
-        aBranch.add_node(a_branch_node_ptr);
+        m_branch_levels[a_branch_node] = aLevel;
+        aBranchNodes.push_back(a_branch_node);
+
+        // continue extracting the next branch node from this node
+        a_current_node = a_branch_node;
+    }
+}
 
-        // Recursively extrat next branch node from this node
-        extract_branch_at_level(aLevel, a_branch_node_ptr, aUpDir, aBranch);
+template<typename T>
+std::shared_ptr<CBranch<T>> CDAGTree<T>::create_branch(int aLevel, const int* aNodesBegin, const int* aNodesEnd,
+                                                       std::pmr::memory_resource* aResource) {
+    // the branch object and its reference count share one block of the tree's memory
+    std::shared_ptr<CBranch<T>> a_branch_ptr = std::allocate_shared<CBranch<T>>(
+                std::pmr::polymorphic_allocator<CBranch<T>>(aResource), aResource);
+    a_branch_ptr->set_branch_level(aLevel);
+    a_branch_ptr->set_nodes(aNodesBegin, aNodesEnd);
+    return a_branch_ptr;
 }
 
 template<typename T>
 void CDAGTree<T>::extract_branches_recursive(int aLevel,
-                                             std::vector<std::shared_ptr<CDAGNode<T>>>& aPreviousLevelBranch
+                                             const std::pmr::vector<int>& aPreviousLevelBranch
                                               ) {
-    CBranchLevelSet<T> a_branch_set;
+    // the branches of this level set are collected on top of the shared branch stack,
+    // the nested calls remove theirs before returning
+    const size_t a_stack_mark = m_branch_stack.size();
     // for each node of the current branch
-    for(auto& p : aPreviousLevelBranch) {
+    for(int p : aPreviousLevelBranch) {
         // for each child node of p, extract the branches rooted at p
-        for(auto& n : p->m_child_nodes){
+        for(int n : get_child_indices(p)){
             // the node is alread assigned to an existing branch
-            if(n->m_branch_level > 0) continue;
+            if(m_branch_levels[n] > 0) continue;
 
             // compute the up direction
-            Vector3t a_up_dir;
-            Vector3t parent_node_pos(p->m_x, p->m_y,p->m_z);
-            Vector3t current_node_pos(n->m_x, n->m_y, n->m_z);
-            a_up_dir = current_node_pos - parent_node_pos;
+            Vector3t a_up_dir = get_node_position(n) - get_node_position(p);
             a_up_dir.normalize();
 
             // extract a branch rooted at the node p
-            std::shared_ptr<CBranch<T>> a_branch_ptr(new CBranch<T>());
-            a_branch_ptr->add_node(p);
-            extract_branch_at_level(aLevel, p, a_up_dir, (*a_branch_ptr));
-            a_branch_set.add_branch(a_branch_ptr);
+            m_branch_scratch.clear();
+            m_branch_scratch.push_back(p);
+            extract_branch_at_level(aLevel, p, a_up_dir, m_branch_scratch);
+            std::shared_ptr<CBranch<T>> a_branch_ptr = create_branch(aLevel, m_branch_scratch.data(),
+                                                                 m_branch_scratch.data() + m_branch_scratch.size(),
+                                                                 m_arena.resource());
+            m_branch_stack.push_back(a_branch_ptr);
 
             // recursively extract branches at the next level started from this node
             extract_branches_recursive(aLevel+1, a_branch_ptr->get_branch_nodes());
@@ -359,48 +1333,174 @@ void CDAGTree<T>::extract_branches_recursive(int aLevel,
 
     }
 
-    m_branches_array.push_back(a_branch_set);
+    CBranchLevelSet<T> a_branch_set(m_arena.resource());
+    a_branch_set.reserve(m_branch_stack.size() - a_stack_mark);
+    for(size_t i = a_stack_mark; i < m_branch_stack.size(); ++i)
+        a_branch_set.add_branch(m_branch_stack[i]);
+    m_branch_stack.resize(a_stack_mark);
+    m_branches_array.push_back(std::move(a_branch_set));
 }
 
 template<typename T>
-void CDAGTree<T>::extract_branches() {
+std::shared_ptr<CBranch<T>> CDAGTree<T>::extract_trunk_branch() {
+    // every branch ends at a distinct leaf node and adds one branch set,
+    // so the leaf count bounds the number of branch sets
+    // a branch holds its nodes and the node it starts from, the trunk only its nodes
+    reserve_branch_memory(m_num_leaf_nodes + 1, m_num_leaf_nodes, get_total_num_of_nodes() + m_num_leaf_nodes);
+    m_branches_array.reserve(m_branches_array.size() + m_num_leaf_nodes + 1);
+
     // extract the trunk branch
     int a_level(1);
-    // create a new branch
-    std::shared_ptr<CBranch<T>> trunk_branch_ptr(new CBranch<T>());
-    trunk_branch_ptr->add_node(m_node_array[0]);
-    Vector3t a_up_dir(0, 1, 0);
-    extract_branch_at_level(a_level, m_node_array[0], a_up_dir, (*trunk_branch_ptr));
-    // add the trunk branch to the branch set
-    CBranchLevelSet<T> trunk_branch_set;
+    int root_index = get_root_node_index();
+    m_branch_scratch.clear();
+    m_branch_scratch.push_back(root_index);
+    extract_branch_at_level(a_level, root_index, m_trunk_up_dir, m_branch_scratch);
+    // create the trunk branch and add it to the branch set
+    std::shared_ptr<CBranch<T>> trunk_branch_ptr = create_branch(a_level, m_branch_scratch.data(),
+                                                                    m_branch_scratch.data() + m_branch_scratch.size(),
+                                                                    m_arena.resource());
+    CBranchLevelSet<T> trunk_branch_set(m_arena.resource());
     trunk_branch_set.add_branch(trunk_branch_ptr);
-    m_branches_array.push_back(trunk_branch_set);
+    m_branches_array.push_back(std::move(trunk_branch_set));
+    return trunk_branch_ptr;
+}
+
+template<typename T>
+void CDAGTree<T>::extract_branches() {
+    if(!m_branches_array.empty() || load_branch_cache())
+        return;
+    std::shared_ptr<CBranch<T>> trunk_branch_ptr = extract_trunk_branch();
 
     // extract other branchs started from the trunk
-    extract_branches_recursive(a_level+1, trunk_branch_ptr->get_branch_nodes());
+    extract_branches_recursive(trunk_branch_ptr->get_branch_level()+1, trunk_branch_ptr->get_branch_nodes());
+    m_branch_scratch = std::vector<int>();
+    m_branch_stack = std::vector<std::shared_ptr<CBranch<T>>>();
+    save_branch_cache();
+}
+
+template<typename T>
+void CDAGTree<T>::run_extract_task(CExtractRecord* aRecord, const CExtractContext& aContext) {
+    // the tasks allocate concurrently
+    std::pmr::memory_resource* a_resource = m_arena.concurrent_resource();
+    std::pmr::polymorphic_allocator<CExtractRecord> record_allocator(aContext.m_record_resource);
+    std::vector<CExtractRecord*> local_records(1, aRecord);
+    std::vector<int> a_scratch;
+    std::vector<std::shared_ptr<CBranch<T>>> a_branches;
+    while(!local_records.empty()) {
+        CExtractRecord* a_record = local_records.back();
+        local_records.pop_back();
+        const int a_level = a_record->m_branch->get_branch_level() + 1;
+        CExtractRecord** a_link = &a_record->m_first_child;
+        a_branches.clear();
+        // for each node of the current branch
+        for(int p : a_record->m_branch->get_branch_nodes()) {
+            // the first child node of p not yet assigned to a branch; the task of the
+            // branch extracted here handles all the other child nodes of p
+            int n(-1);
+            for(int c : get_child_indices(p)) {
+                if(m_branch_levels[c] == 0) {
+                    n = c;
+                    break;
+                }
+            }
+            if(n < 0)
+                continue;
+
+            // compute the up direction
+            Vector3t a_up_dir = get_node_position(n) - get_node_position(p);
+            a_up_dir.normalize();
+
+            // extract a branch rooted at the node p
+            a_scratch.clear();
+            a_scratch.push_back(p);
+            extract_branch_at_level(a_level, p, a_up_dir, a_scratch);
+            a_branches.push_back(create_branch(a_level, a_scratch.data(), a_scratch.data() + a_scratch.size(),
+                                                a_resource));
+            CExtractRecord* a_child = record_allocator.allocate(1);
+            new (a_child) CExtractRecord{a_branches.back().get(), nullptr, nullptr, CBranchLevelSet<T>(a_resource)};
+            *a_link = a_child;
+            a_link = &a_child->m_next_sibling;
+
+            // extract the branches at the next level started from this branch
+            if(aContext.m_subtree_sizes[p] >= aContext.m_min_task_nodes) {
+                aContext.m_pool->submit([this, a_child, &aContext]{
+                    run_extract_task(a_child, aContext);
+                });
+            } else {
+                local_records.push_back(a_child);
+            }
+        }
+
+        // the branch set of this branch is complete
+        a_record->m_branch_set.reserve(a_branches.size());
+        for(const auto& b : a_branches)
+            a_record->m_branch_set.add_branch(b);
+    }
 }
 
 template<typename T>
-void CDAGTree<T>::compute_bounding_box(CBBox<T>& aBox) {
+void CDAGTree<T>::extract_branches_parallel(CWorkStealingPool& aPool) {
+    if(!m_branches_array.empty() || load_branch_cache())
+        return;
+    std::shared_ptr<CBranch<T>> trunk_branch_ptr = extract_trunk_branch();
+    m_branch_scratch = std::vector<int>();
+
+    std::pmr::synchronized_pool_resource record_resource;
+    CExtractContext a_context{&aPool, &record_resource, {}, 2048};
+    // a subtree follows its root in pre-order
+    const int num_nodes = int(get_total_num_of_nodes());
+    a_context.m_subtree_sizes.assign(num_nodes, 1);
+    for(int i = num_nodes - 1; i > 0; --i)
+        a_context.m_subtree_sizes[m_parent_indices[i]] += a_context.m_subtree_sizes[i];
+
+    CExtractRecord trunk_record{trunk_branch_ptr.get(), nullptr, nullptr,
+                                CBranchLevelSet<T>(m_arena.concurrent_resource())};
+    aPool.submit([this, &trunk_record, &a_context]{
+        run_extract_task(&trunk_record, a_context);
+    });
+    aPool.wait();
+
+    // move the branch sets in the serial order: the sets of the child branches
+    // depth first, then the set of the branch itself
+    std::vector<CExtractRecord*> emit_stack(1, &trunk_record);
+    while(!emit_stack.empty()) {
+        CExtractRecord* a_record = emit_stack.back();
+        if(a_record->m_first_child != nullptr) {
+            // descend into the next child, detaching it so that it is visited once
+            CExtractRecord* a_child = a_record->m_first_child;
+            a_record->m_first_child = a_child->m_next_sibling;
+            emit_stack.push_back(a_child);
+            continue;
+        }
+        m_branches_array.push_back(std::move(a_record->m_branch_set));
+        emit_stack.pop_back();
+        if(a_record != &trunk_record)
+            a_record->~CExtractRecord();
+    }
+    // the record memory is released with record_resource
+    save_branch_cache();
+}
+
+template<typename T>
+void CDAGTree<T>::compute_bounding_box(CBBox<T>& aBox) const {
     aBox.m_x_min = std::numeric_limits<T>::max();
-    aBox.m_x_max = std::numeric_limits<T>::min();
+    aBox.m_x_max = std::numeric_limits<T>::lowest();
     aBox.m_y_min = std::numeric_limits<T>::max();
-    aBox.m_y_max = std::numeric_limits<T>::min();
+    aBox.m_y_max = std::numeric_limits<T>::lowest();
     aBox.m_z_min = std::numeric_limits<T>::max();
-    aBox.m_z_max = std::numeric_limits<T>::min();
-    for(const auto& p : m_node_array) {
-        if(p->m_x < aBox.m_x_min)
-            aBox.m_x_min = p->m_x;
-        if(p->m_x > aBox.m_x_max)
-            aBox.m_x_max = p->m_x;
-        if(p->m_y < aBox.m_y_min)
-            aBox.m_y_min = p->m_y;
-        if(p->m_y > aBox.m_y_max)
-            aBox.m_y_max = p->m_y;
-        if(p->m_z < aBox.m_z_min)
-            aBox.m_z_min = p->m_z;
-        if(p->m_z > aBox.m_z_max)
-            aBox.m_z_max = p->m_z;
+    aBox.m_z_max = std::numeric_limits<T>::lowest();
+    // one pass over each coordinate array
+    for(T x : m_xs) {
+        aBox.m_x_min = std::min(aBox.m_x_min, x);
+        aBox.m_x_max = std::max(aBox.m_x_max, x);
+    }
+    for(T y : m_ys) {
+        aBox.m_y_min = std::min(aBox.m_y_min, y);
+        aBox.m_y_max = std::max(aBox.m_y_max, y);
+    }
+    for(T z : m_zs) {
+        aBox.m_z_min = std::min(aBox.m_z_min, z);
+        aBox.m_z_max = std::max(aBox.m_z_max, z);
     }
 }
 
@@ -0,0 +1,237 @@
+#include "cframeprofiler.h"
+
+#include "GL/glew.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+using namespace std;
+
+static_assert(is_trivially_copyable<CFrameTimes>::value, "the frame times are copied as words");
+
+CFrameTimes::CFrameTimes() :
+    m_frame_index(0),
+    m_frame_ms(0.f),
+    m_cpu_ms(0.f),
+    m_draw_ms(0.f),
+    m_gpu_ms(-1.f),
+    m_update_ms(-1.f)
+{
+
+}
+
+// the percentiles of the known (not negative) times among aTimes
+static CFrameStatistics::CPercentiles get_percentiles(const vector<CFrameTimes>& aTimes, float CFrameTimes::* aTime) {
+    vector<float> values;
+    values.reserve(aTimes.size());
+    for(const CFrameTimes& t : aTimes) {
+        if(t.*aTime >= 0.f)
+            values.push_back(t.*aTime);
+    }
+    CFrameStatistics::CPercentiles percentiles;
+    percentiles.m_num_frames = values.size();
+    percentiles.m_p50 = percentiles.m_p95 = percentiles.m_p99 = -1.f;
+    if(values.empty())
+        return percentiles;
+    auto get_percentile = [&values](double aFraction) {
+        vector<float>::iterator nth = values.begin() + min(size_t(aFraction * values.size()), values.size() - 1);
+        nth_element(values.begin(), nth, values.end());
+        return *nth;
+    };
+    percentiles.m_p50 = get_percentile(0.5);
+    percentiles.m_p95 = get_percentile(0.95);
+    percentiles.m_p99 = get_percentile(0.99);
+    return percentiles;
+}
+
+void CFrameStatistics::compute(const vector<CFrameTimes>& aTimes) {
+    m_num_frames = aTimes.size();
+    m_first_frame = m_last_frame = 0;
+    for(size_t i = 0; i < aTimes.size(); ++i) {
+        m_first_frame = i == 0 ? aTimes[i].m_frame_index : min(m_first_frame, aTimes[i].m_frame_index);
+        m_last_frame = max(m_last_frame, aTimes[i].m_frame_index);
+    }
+    m_frame = get_percentiles(aTimes, &CFrameTimes::m_frame_ms);
+    m_cpu = get_percentiles(aTimes, &CFrameTimes::m_cpu_ms);
+    m_draw = get_percentiles(aTimes, &CFrameTimes::m_draw_ms);
+    m_gpu = get_percentiles(aTimes, &CFrameTimes::m_gpu_ms);
+    m_update = get_percentiles(aTimes, &CFrameTimes::m_update_ms);
+}
+
+string CFrameStatistics::to_log_line() const {
+    string line = "Frame ms of the last " + to_string(m_num_frames) + " frames:";
+    const char* names[] = {"frame", "cpu", "draw", "gpu", "scene update"};
+    const CPercentiles* percentiles[] = {&m_frame, &m_cpu, &m_draw, &m_gpu, &m_update};
+    for(int i = 0; i < 5; ++i) {
+        if(percentiles[i]->m_num_frames == 0)
+            continue;
+        char text[128];
+        snprintf(text, sizeof(text), "%s %s p50 %.3f, p95 %.3f, p99 %.3f", i == 0 ? "" : ";", names[i],
+                 percentiles[i]->m_p50, percentiles[i]->m_p95, percentiles[i]->m_p99);
+        line += text;
+    }
+    return line;
+}
+
+string CFrameStatistics::to_json() const {
+    char text[160];
+    snprintf(text, sizeof(text), "{\"frames\": %zu, \"first_frame\": %llu, \"last_frame\": %llu", m_num_frames,
+             (unsigned long long)m_first_frame, (unsigned long long)m_last_frame);
+    string json = text;
+    const char* names[] = {"frame_ms", "cpu_ms", "draw_ms", "gpu_ms", "update_ms"};
+    const CPercentiles* percentiles[] = {&m_frame, &m_cpu, &m_draw, &m_gpu, &m_update};
+    for(int i = 0; i < 5; ++i) {
+        if(percentiles[i]->m_num_frames == 0) {
+            snprintf(text, sizeof(text), ", \"%s\": null", names[i]);
+        } else {
+            snprintf(text, sizeof(text), ", \"%s\": {\"n\": %zu, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f}", names[i],
+                     percentiles[i]->m_num_frames, percentiles[i]->m_p50, percentiles[i]->m_p95, percentiles[i]->m_p99);
+        }
+        json += text;
+    }
+    return json + "}";
+}
+
+CFrameTimeRing::CFrameTimeRing(size_t aCapacity) :
+    m_capacity(max(aCapacity, size_t(1))),
+    m_slots(new CSlot[m_capacity]),
+    m_num_pushed(0)
+{
+    for(size_t i = 0; i < m_capacity; ++i) {
+        m_slots[i].m_sequence.store(0, memory_order_relaxed);
+        for(size_t w = 0; w < NUM_WORDS; ++w)
+            m_slots[i].m_words[w].store(0, memory_order_relaxed);
+    }
+}
+
+void CFrameTimeRing::push(const CFrameTimes& aTimes) {
+    uint32_t words[NUM_WORDS] = {};
+    memcpy(words, &aTimes, sizeof(CFrameTimes));
+    const uint64_t n = m_num_pushed.load(memory_order_relaxed);
+    CSlot& a_slot = m_slots[n % m_capacity];
+    // odd while written, the words are not stored before the readers can see it
+    const uint64_t sequence = a_slot.m_sequence.load(memory_order_relaxed);
+    a_slot.m_sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for(size_t w = 0; w < NUM_WORDS; ++w)
+        a_slot.m_words[w].store(words[w], memory_order_relaxed);
+    a_slot.m_sequence.store(sequence + 2, memory_order_release);
+    m_num_pushed.store(n + 1, memory_order_release);
+}
+
+size_t CFrameTimeRing::copy_last(size_t aMaxFrames, vector<CFrameTimes>& aTimes) const {
+    aTimes.clear();
+    const uint64_t num_pushed = m_num_pushed.load(memory_order_acquire);
+    const uint64_t count = min(uint64_t(min(aMaxFrames, m_capacity)), num_pushed);
+    aTimes.reserve(size_t(count));
+    for(uint64_t i = num_pushed - count; i < num_pushed; ++i) {
+        const CSlot& a_slot = m_slots[i % m_capacity];
+        const uint64_t sequence = a_slot.m_sequence.load(memory_order_acquire);
+        if(sequence & 1)
+            continue;
+        uint32_t words[NUM_WORDS];
+        for(size_t w = 0; w < NUM_WORDS; ++w)
+            words[w] = a_slot.m_words[w].load(memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        // skip the slot if it was written meanwhile
+        if(a_slot.m_sequence.load(memory_order_relaxed) != sequence)
+            continue;
+        CFrameTimes a_times;
+        memcpy(&a_times, words, sizeof(CFrameTimes));
+        aTimes.push_back(a_times);
+    }
+    return aTimes.size();
+}
+
+CFrameProfiler::CFrameProfiler(size_t aRingCapacity) :
+    m_ring(aRingCapacity),
+    m_num_frames(0),
+    m_is_gpu_timer_running(false),
+    m_num_missed_gpu_times(0)
+{
+    for(int b = 0; b < NUM_QUERY_BUFFERS; ++b) {
+        m_queries[b] = 0;
+        m_is_query_pending[b] = false;
+    }
+}
+
+CFrameProfiler::~CFrameProfiler() {
+    // the query objects go with the OpenGL context, delete_queries() releases them earlier
+}
+
+void CFrameProfiler::create_queries() {
+    if(m_queries[0] == 0)
+        glGenQueries(NUM_QUERY_BUFFERS, m_queries);
+}
+
+void CFrameProfiler::delete_queries() {
+    if(m_queries[0] == 0)
+        return;
+    glDeleteQueries(NUM_QUERY_BUFFERS, m_queries);
+    for(int b = 0; b < NUM_QUERY_BUFFERS; ++b) {
+        m_queries[b] = 0;
+        m_is_query_pending[b] = false;
+    }
+}
+
+void CFrameProfiler::begin_frame() {
+    const int buffer = int(m_num_frames % NUM_QUERY_BUFFERS);
+    // the query of the last but one frame is reused by this one
+    resolve_query(buffer, true);
+    m_current = CFrameTimes();
+    m_current.m_frame_index = m_num_frames;
+    m_frame_start = chrono::steady_clock::now();
+}
+
+void CFrameProfiler::begin_gpu_timer() {
+    const int buffer = int(m_num_frames % NUM_QUERY_BUFFERS);
+    // one query per frame, time elapsed queries may not be nested
+    if(m_queries[buffer] == 0 || m_is_gpu_timer_running || m_is_query_pending[buffer])
+        return;
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[buffer]);
+    m_is_gpu_timer_running = true;
+}
+
+void CFrameProfiler::end_gpu_timer() {
+    if(!m_is_gpu_timer_running)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    m_is_gpu_timer_running = false;
+    m_is_query_pending[m_num_frames % NUM_QUERY_BUFFERS] = true;
+}
+
+void CFrameProfiler::end_frame() {
+    end_gpu_timer();
+    m_current.m_frame_ms = chrono::duration<float, milli>(chrono::steady_clock::now() - m_frame_start).count();
+    const int buffer = int(m_num_frames % NUM_QUERY_BUFFERS);
+    // the previous frame first, its query has had a frame to finish
+    resolve_query((buffer + 1) % NUM_QUERY_BUFFERS, false);
+    if(m_is_query_pending[buffer]) {
+        m_pending[buffer] = m_current;
+        resolve_query(buffer, false);
+    } else {
+        m_ring.push(m_current);
+    }
+    ++m_num_frames;
+}
+
+void CFrameProfiler::resolve_query(int aBuffer, bool aIsReused) {
+    if(!m_is_query_pending[aBuffer])
+        return;
+    GLint is_available(0);
+    glGetQueryObjectiv(m_queries[aBuffer], GL_QUERY_RESULT_AVAILABLE, &is_available);
+    if(is_available) {
+        GLuint64 nanoseconds(0);
+        glGetQueryObjectui64v(m_queries[aBuffer], GL_QUERY_RESULT, &nanoseconds);
+        m_pending[aBuffer].m_gpu_ms = float(double(nanoseconds) * 1e-6);
+    } else if(aIsReused) {
+        // given up on rather than waited for
+        ++m_num_missed_gpu_times;
+    } else {
+        return;
+    }
+    m_ring.push(m_pending[aBuffer]);
+    m_is_query_pending[aBuffer] = false;
+}
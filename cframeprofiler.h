@@ -0,0 +1,176 @@
+#ifndef CFRAMEPROFILER_H
+#define CFRAMEPROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * The times of one frame in milliseconds. A negative time is unknown, e.g. the GPU time
+ * of a frame whose timer query was not ready when its query object was reused.
+*/
+struct CFrameTimes {
+    CFrameTimes();
+
+    uint64_t m_frame_index;
+    float m_frame_ms;       // the whole frame on the CPU, the buffer swap included
+    float m_cpu_ms;         // the work of the frame on the CPU before the swap
+    float m_draw_ms;        // the draw calls on the CPU
+    float m_gpu_ms;         // the draw calls on the GPU, from a GL_TIME_ELAPSED query
+    float m_update_ms;      // the scene update taken by the frame, negative if none
+};
+
+/*
+ * The 50th, 95th and 99th percentiles of the times of a number of frames.
+*/
+struct CFrameStatistics {
+    struct CPercentiles {
+        size_t m_num_frames;        // the frames with a known time
+        float m_p50, m_p95, m_p99;
+    };
+
+    size_t m_num_frames;
+    uint64_t m_first_frame, m_last_frame;
+    CPercentiles m_frame, m_cpu, m_draw, m_gpu, m_update;
+
+    /*
+     * Compute the percentiles of the given frames, skipping the unknown times.
+    */
+    void compute(const std::vector<CFrameTimes>& aTimes);
+    // one line for the log
+    std::string to_log_line() const;
+    // one JSON object on one line
+    std::string to_json() const;
+};
+
+/*
+ * A lock-free ring of the times of the last frames, written by one thread (the rendering
+ * thread) and read by any number of threads without blocking the writer.
+ * Every slot carries a sequence number, odd while the slot is written; a reader copies a
+ * slot and keeps the copy only if the sequence number was even and unchanged around it,
+ * so a frame being written is skipped rather than read torn. The times are kept as relaxed
+ * atomic words, so the copy is no data race.
+*/
+class CFrameTimeRing
+{
+public:
+    explicit CFrameTimeRing(size_t aCapacity);
+    CFrameTimeRing(const CFrameTimeRing&)=delete;
+    CFrameTimeRing& operator=(const CFrameTimeRing&)=delete;
+public:
+    // from the writing thread only
+    void push(const CFrameTimes& aTimes);
+    /*
+     * Copy the last aMaxFrames frames, oldest first, into aTimes, replacing its content.
+     * Returns the number of frames copied.
+    */
+    size_t copy_last(size_t aMaxFrames, std::vector<CFrameTimes>& aTimes) const;
+    size_t get_capacity() const {
+        return m_capacity;
+    }
+    // the frames pushed so far
+    uint64_t get_num_pushed() const {
+        return m_num_pushed.load(std::memory_order_acquire);
+    }
+private:
+    static const size_t NUM_WORDS = (sizeof(CFrameTimes) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+    struct CSlot {
+        std::atomic<uint64_t> m_sequence;
+        std::atomic<uint32_t> m_words[NUM_WORDS];
+    };
+    size_t m_capacity;
+    std::unique_ptr<CSlot[]> m_slots;
+    std::atomic<uint64_t> m_num_pushed;
+};
+
+/*
+ * Add the time from its construction to its destruction, in milliseconds, to a time.
+*/
+class CScopedCpuTimer
+{
+public:
+    explicit CScopedCpuTimer(float& aMilliseconds) :
+        m_milliseconds(aMilliseconds),
+        m_start(std::chrono::steady_clock::now())
+    {
+
+    }
+    ~CScopedCpuTimer() {
+        m_milliseconds += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+    }
+    CScopedCpuTimer(const CScopedCpuTimer&)=delete;
+    CScopedCpuTimer& operator=(const CScopedCpuTimer&)=delete;
+private:
+    float& m_milliseconds;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+/*
+ * Time every frame on the CPU and the GPU and keep the times of the last frames in a
+ * CFrameTimeRing. A frame is enclosed by begin_frame() and end_frame(); inside it the
+ * CPU times of the current frame are added to with CScopedCpuTimer, and its draw calls
+ * are enclosed by begin_gpu_timer() and end_gpu_timer(), a GL_TIME_ELAPSED query.
+ * The queries are double buffered: a frame uses the query object its last but one frame
+ * used, and the result of a query is only taken once it is available, at the end of the
+ * next frame or before its object is reused, so the pipeline is never waited for. A
+ * frame goes into the ring once its GPU time is known, or is given up on, one or two
+ * frames after it ended. Timer queries are core since OpenGL 3.3 and are served by
+ * software rasterizers such as llvmpipe as well; llvmpipe runs the vertex work inside the
+ * draw calls, so there it shows in the CPU draw time rather than in the GPU time.
+*/
+class CFrameProfiler
+{
+public:
+    explicit CFrameProfiler(size_t aRingCapacity = 1024);
+    ~CFrameProfiler();
+    CFrameProfiler(const CFrameProfiler&)=delete;
+    CFrameProfiler& operator=(const CFrameProfiler&)=delete;
+public:
+    /*
+     * Create the query objects, with the OpenGL context current. Without them no GPU
+     * time is measured.
+    */
+    void create_queries();
+    // delete the query objects, with the OpenGL context current
+    void delete_queries();
+    void begin_frame();
+    void begin_gpu_timer();
+    void end_gpu_timer();
+    /*
+     * Finish the current frame and push the frames whose GPU time is resolved.
+    */
+    void end_frame();
+    // the times of the current frame, to add the CPU times to
+    CFrameTimes& get_current_times() {
+        return m_current;
+    }
+    const CFrameTimeRing& get_ring() const {
+        return m_ring;
+    }
+    // the frames whose GPU timer query was reused before its result was available
+    uint64_t get_num_missed_gpu_times() const {
+        return m_num_missed_gpu_times;
+    }
+private:
+    static const int NUM_QUERY_BUFFERS = 2;
+    /*
+     * Take the GPU time of the frame pending in a query buffer into the ring, if the query
+     * result is available or aIsReused (then the time stays unknown).
+    */
+    void resolve_query(int aBuffer, bool aIsReused);
+private:
+    CFrameTimeRing m_ring;
+    CFrameTimes m_current;
+    std::chrono::steady_clock::time_point m_frame_start;
+    uint64_t m_num_frames;
+    unsigned m_queries[NUM_QUERY_BUFFERS];
+    bool m_is_query_pending[NUM_QUERY_BUFFERS];     // the query of the buffer waits for its result
+    CFrameTimes m_pending[NUM_QUERY_BUFFERS];       // the frames waiting for their query results
+    bool m_is_gpu_timer_running;
+    uint64_t m_num_missed_gpu_times;
+};
+
+#endif // CFRAMEPROFILER_H
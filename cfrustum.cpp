@@ -0,0 +1,47 @@
+#include "cfrustum.h"
+
+#include <algorithm>
+using namespace std;
+
+CFrustum::CFrustum()
+{
+    // without matrices nothing is clipped
+    for(int i = 0; i < 6; ++i)
+        m_planes[i] = Eigen::Vector4f(0.f, 0.f, 0.f, 1.f);
+}
+
+CFrustum::CFrustum(const Eigen::Matrix4f& aProjMat, const Eigen::Matrix4f& aViewMat)
+{
+    set_matrices(aProjMat, aViewMat);
+}
+
+void CFrustum::set_matrices(const Eigen::Matrix4f& aProjMat, const Eigen::Matrix4f& aViewMat) {
+    const Eigen::Matrix4f view_proj = aProjMat * aViewMat;
+    // a point is inside if -w <= x, y, z <= w in clip coordinates
+    for(int i = 0; i < 3; ++i) {
+        m_planes[2*i] = (view_proj.row(3) + view_proj.row(i)).transpose();
+        m_planes[2*i+1] = (view_proj.row(3) - view_proj.row(i)).transpose();
+    }
+    for(int i = 0; i < 6; ++i) {
+        float length = m_planes[i].head<3>().norm();
+        if(length > 0.f)
+            m_planes[i] /= length;
+    }
+}
+
+CFrustum::Containment CFrustum::classify_box(const Eigen::Vector3f& aMin, const Eigen::Vector3f& aMax) const {
+    const Eigen::Vector3f center = 0.5f * (aMin + aMax);
+    const Eigen::Vector3f extent = 0.5f * (aMax - aMin);
+    Containment containment(Inside);
+    for(int i = 0; i < 6; ++i) {
+        const Eigen::Vector3f normal = m_planes[i].head<3>();
+        // the signed distance of the box centre and the half width of the box along the normal
+        const float distance = normal.dot(center) + m_planes[i].w();
+        const float radius = extent.dot(normal.cwiseAbs());
+        if(distance < -radius)
+            return Outside;
+        if(distance < radius)
+            containment = Intersecting;
+    }
+    return containment;
+}
@@ -0,0 +1,41 @@
+#ifndef CFRUSTUM_H
+#define CFRUSTUM_H
+
+#include <Eigen/Dense>
+
+/*
+ * The six clipping planes of a view frustum, in world coordinates.
+ * The planes are extracted from the rows of projection * view (Gribb and Hartmann),
+ * so they follow whatever matrices the shaders are given. Every plane is stored as
+ * (a, b, c, d) with a unit normal (a, b, c) pointing into the frustum.
+*/
+class CFrustum
+{
+public:
+    enum Containment {
+        Outside,        // entirely outside one of the planes
+        Intersecting,   // possibly crossing the boundary
+        Inside          // entirely inside all the planes
+    };
+public:
+    CFrustum();
+    CFrustum(const Eigen::Matrix4f& aProjMat, const Eigen::Matrix4f& aViewMat);
+public:
+    /*
+     * Extract the planes of the frustum seen through aProjMat * aViewMat.
+    */
+    void set_matrices(const Eigen::Matrix4f& aProjMat, const Eigen::Matrix4f& aViewMat);
+    /*
+     * Classify the axis aligned box between aMin and aMax against the planes.
+     * A box near a corner of the frustum may be reported Intersecting although it is
+     * outside, never the other way round.
+    */
+    Containment classify_box(const Eigen::Vector3f& aMin, const Eigen::Vector3f& aMax) const;
+    const Eigen::Vector4f& get_plane(int aIndex) const {
+        return m_planes[aIndex];
+    }
+private:
+    Eigen::Vector4f m_planes[6];    // left, right, bottom, top, near, far
+};
+
+#endif // CFRUSTUM_H
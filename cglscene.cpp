@@ -7,26 +7,96 @@
 #include "GLUtilities/gl_logger.h"
 #include "GLUtilities/transformation_3d.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <vector>
 
 // Initialize the static members
 int CGLScene::m_framebuffer_width(800);
 int CGLScene::m_framebuffer_height(600);
 int CGLScene::m_mouse_pos_x(0.f);
 int CGLScene::m_mouse_pos_y(0.f);
-int CGLScene::m_model_loc(-1);
-int CGLScene::m_view_loc(-1);
-int CGLScene::m_proj_loc(-1);
+unsigned CGLScene::m_matrices_buffer(0);
+bool CGLScene::m_are_matrices_changed(true);
+int CGLScene::m_instanced_loc(-1);
+int CGLScene::m_move_keys(0);
+std::shared_ptr<CSceneUpdater> CGLScene::m_scene_updater_ptr = nullptr;
+bool CGLScene::m_is_scene_polled(false);
+CSceneFrame CGLScene::m_scene_frame;
+CFrameProfiler CGLScene::m_frame_profiler;
+uint64_t CGLScene::m_num_exported_frames(0);
+std::string CGLScene::m_frame_stats_file;
 int CGLScene::m_shader_program(-1);
 Camera CGLScene::m_fps_camera(Eigen::Vector3f(0.f, 0.f, 0.f), Eigen::Vector3f(0.f, 0.f, 0.f), Eigen::Vector3f(0.f, 1.f, 0.f));
 Eigen::Matrix4f CGLScene::m_model_mat = Eigen::Matrix4f::Identity();
 Eigen::Matrix4f CGLScene::m_view_mat = Eigen::Matrix4f::Identity();
 Eigen::Matrix4f CGLScene::m_proj_mat = Eigen::Matrix4f::Identity();
+std::shared_ptr<CDAGTree<float>> CGLScene::m_tree_ptr = nullptr;
 std::shared_ptr<CTreeSkeleton> CGLScene::m_tree_skeleton_ptr = nullptr;
+std::shared_ptr<CTreeTube> CGLScene::m_tree_tube_ptr = nullptr;
+std::shared_ptr<CTreeSegmentBVH> CGLScene::m_segment_bvh_ptr = nullptr;
+std::shared_ptr<CTreeGeometryBuilder> CGLScene::m_geometry_builder_ptr = nullptr;
+bool CGLScene::m_is_tube_requested(false);
+bool CGLScene::m_is_bvh_requested(false);
+bool CGLScene::m_is_geometry_polled(false);
+bool CGLScene::m_has_pending_pick(false);
+Eigen::Vector3f CGLScene::m_pending_pick_eye = Eigen::Vector3f::Zero();
+Eigen::Vector3f CGLScene::m_pending_pick_direction = Eigen::Vector3f::Zero();
+bool CGLScene::m_is_mouse_dragged(false);
+bool CGLScene::m_is_tube_visible(false);
+int CGLScene::m_draw_level(0);
+bool CGLScene::m_is_lod_enabled(true);
+float CGLScene::m_max_pixel_error(1.f);
+bool CGLScene::m_is_culling_enabled(true);
+size_t CGLScene::m_num_culled_branches(0);
+bool CGLScene::m_is_streaming_load(true);
+bool CGLScene::m_is_branch_cache_enabled(false);
+bool CGLScene::m_is_camera_placed(false);
+std::shared_ptr<CTreeStreamLoader> CGLScene::m_stream_loader_ptr = nullptr;
+std::shared_ptr<CTreeSegmentBuffer> CGLScene::m_segment_buffer_ptr = nullptr;
+std::string CGLScene::m_forest_file;
+std::shared_ptr<CTreeForest> CGLScene::m_forest_ptr = nullptr;
 
 static std::string VERTEX_SHADER_SOURCE = "/home/yinhui/Projects/Qt/Tree3DViewer/basc.vert";
 static std::string FRAGMENT_SHADER_SOURCE = "/home/yinhui/Projects/Qt/Tree3DViewer/basc.frag";
 static std::string TREE_FILE_PATH = "/home/yinhui/Projects/Qt/Tree3DViewer/TestData/Tree1.tree";
+// the vertical field of view in degrees
+static const float FIELD_OF_VIEW_Y = 60.f;
+// the vertices of every ring of the tube mesh
+static const int TUBE_RADIAL_SEGMENTS = 8;
+// the interval at which the streamed segments are uploaded, about once a frame
+static const int STREAMING_UPDATE_MS = 16;
+// the pixels around the cursor within which a thin branch is picked
+static const float PICK_PIXEL_RADIUS = 2.f;
+// the binding point of the Matrices uniform block of the shader programs
+static const unsigned MATRICES_BINDING = 0;
+// the interval at which a frame published by the scene updater is looked for
+static const int SCENE_POLL_MS = 4;
+// the interval at which a tube mesh or a segment hierarchy published by the geometry builder is looked for
+static const int GEOMETRY_POLL_MS = 16;
+// the frames whose time percentiles are exported together
+static const size_t FRAME_STATS_WINDOW = 240;
+
+static int get_move_key(unsigned char aKey) {
+    switch(aKey) {
+    case 'w':
+    case 'W':
+        return CSceneUpdater::MoveForward;
+    case 's':
+    case 'S':
+        return CSceneUpdater::MoveBackward;
+    case 'a':
+    case 'A':
+        return CSceneUpdater::MoveLeft;
+    case 'd':
+    case 'D':
+        return CSceneUpdater::MoveRight;
+    default:
+        return 0;
+    }
+}
 
 void CGLScene::set_framebuffer_size(int width, int height) {
     m_framebuffer_width = width;
@@ -55,81 +125,214 @@ void CGLScene::init() {
     }
     // Initialize the model, view and projection matrices
     m_view_mat = m_fps_camera.get_view_mat();
-    m_proj_mat = perspective(60.f, float(m_framebuffer_width)/float(m_framebuffer_width), 1.f, 1000.f);
+    m_proj_mat = perspective(FIELD_OF_VIEW_Y, float(m_framebuffer_width)/float(m_framebuffer_width), 1.f, 1000.f);
 
-    // Setup the model, view and projection matrices in the OpenGL shader
-    glUseProgram(m_shader_program);
-    m_model_loc = glGetUniformLocation(m_shader_program, "model");
-    if(m_model_loc == -1) {
-        std::cerr << "ERROR:failed get the model location from the shader!\n";
+    // Setup the model, view and projection matrices in a uniform buffer bound to the shader
+    GLuint matrices_index = glGetUniformBlockIndex(m_shader_program, "Matrices");
+    if(matrices_index == GL_INVALID_INDEX) {
+        std::cerr << "ERROR:failed get the matrices block from the shader!\n";
         exit(1);
     }
-    glUniformMatrix4fv(m_model_loc, 1, GL_FALSE, m_model_mat.data());
+    glUniformBlockBinding(m_shader_program, matrices_index, MATRICES_BINDING);
+    glGenBuffers(1, &m_matrices_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_matrices_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, 3*sizeof(Eigen::Matrix4f), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, MATRICES_BINDING, m_matrices_buffer);
+    m_are_matrices_changed = true;
+    update_matrices_buffer();
 
-    m_view_loc = glGetUniformLocation(m_shader_program, "view");
-    if(m_view_loc == -1) {
-        std::cerr << "ERROR:failed get the view location from the shader!\n";
+    glUseProgram(m_shader_program);
+    m_instanced_loc = glGetUniformLocation(m_shader_program, "instanced");
+    if(m_instanced_loc == -1) {
+        std::cerr << "ERROR:failed get the instanced location from the shader!\n";
         exit(1);
     }
-    glUniformMatrix4fv(m_view_loc, 1, GL_FALSE, m_view_mat.data());
+    glUniform1i(m_instanced_loc, GL_FALSE);
+    m_frame_profiler.create_queries();
 
-    m_proj_loc = glGetUniformLocation(m_shader_program, "proj");
-    if(m_proj_loc == -1) {
-        std::cerr << "ERROR:failed get the projection location from the shader!\n";
-        exit(1);
-    }
-    glUniformMatrix4fv(m_proj_loc, 1, GL_FALSE, m_proj_mat.data());
+    // the camera and the levels of detail of the next frames are updated on another thread
+    m_scene_updater_ptr.reset(new CSceneUpdater(m_fps_camera));
+    update_scene_settings();
+    // the tube mesh and the picking hierarchy are built on another thread, on one pool for both
+    m_geometry_builder_ptr.reset(new CTreeGeometryBuilder());
+}
 
+void CGLScene::update_matrices_buffer() {
+    if(!m_are_matrices_changed)
+        return;
+    // the order of the Matrices block, std140 lays the matrices out one after another
+    glBindBuffer(GL_UNIFORM_BUFFER, m_matrices_buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Eigen::Matrix4f), m_proj_mat.data());
+    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(Eigen::Matrix4f), sizeof(Eigen::Matrix4f), m_view_mat.data());
+    glBufferSubData(GL_UNIFORM_BUFFER, 2*sizeof(Eigen::Matrix4f), sizeof(Eigen::Matrix4f), m_model_mat.data());
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    m_are_matrices_changed = false;
 }
 
 void CGLScene::display() {
+    m_frame_profiler.begin_frame();
+    CFrameTimes& frame_times = m_frame_profiler.get_current_times();
+    {
+        CScopedCpuTimer cpu_timer(frame_times.m_cpu_ms);
+        // the camera and the strips come ready from the scene updater, only the latest frame is drawn
+        if(m_scene_updater_ptr->take_frame(m_scene_frame)) {
+            m_fps_camera = m_scene_frame.m_camera;
+            m_view_mat = m_scene_frame.m_view_mat;
+            m_are_matrices_changed = true;
+            frame_times.m_update_ms = float(m_scene_frame.m_update_seconds * 1e3);
+            // keep moving while a move key is held, the next frame is produced while this one is drawn
+            if(m_scene_frame.m_is_moving)
+                request_scene_frame();
+        }
+        CScopedCpuTimer draw_timer(frame_times.m_draw_ms);
+        m_frame_profiler.begin_gpu_timer();
+        draw_scene();
+        m_frame_profiler.end_gpu_timer();
+    }
+    glutSwapBuffers();
+    m_frame_profiler.end_frame();
+    export_frame_statistics();
+}
+
+void CGLScene::draw_scene() {
+    update_matrices_buffer();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glUseProgram(m_shader_program);
-    m_tree_skeleton_ptr->draw();
-    glutSwapBuffers();
+    if(m_forest_ptr) {
+        // the model matrices come from the instances
+        glUniform1i(m_instanced_loc, GL_TRUE);
+        m_forest_ptr->draw();
+        glUniform1i(m_instanced_loc, GL_FALSE);
+    } else if(m_is_tube_visible && m_tree_tube_ptr) {
+        m_tree_tube_ptr->draw();
+    } else if(m_tree_skeleton_ptr) {
+        // the full skeleton until the strips of its levels of detail are chosen
+        if((m_is_lod_enabled || m_is_culling_enabled) && m_scene_frame.m_lod == &m_tree_skeleton_ptr->get_branch_lod()) {
+            m_tree_skeleton_ptr->draw_lod_strips(m_scene_frame.m_lod_firsts, m_scene_frame.m_lod_counts);
+            if(m_is_culling_enabled && m_scene_frame.m_num_culled_branches != m_num_culled_branches) {
+                m_num_culled_branches = m_scene_frame.m_num_culled_branches;
+                std::cout << "Branches culled: " << m_num_culled_branches << " of "
+                          << m_tree_skeleton_ptr->get_num_branches() << std::endl;
+            }
+        } else if(m_draw_level > 0) {
+            m_tree_skeleton_ptr->draw_to_level(m_draw_level);
+        } else {
+            m_tree_skeleton_ptr->draw();
+        }
+    } else if(m_segment_buffer_ptr)
+        m_segment_buffer_ptr->draw();
+}
+
+void CGLScene::update_scene_settings() {
+    // the pixels covered by a unit size at unit distance
+    float pixel_scale = float(m_framebuffer_height) / (2.f * std::tan(FIELD_OF_VIEW_Y * float(M_PI) / 360.f));
+    m_scene_updater_ptr->set_view(m_proj_mat, m_model_mat, pixel_scale);
+    m_scene_updater_ptr->set_lod_settings(m_is_lod_enabled ? m_max_pixel_error : 0.f, m_is_culling_enabled,
+                                          m_draw_level);
+    request_scene_frame();
+}
+
+void CGLScene::request_scene_frame() {
+    m_scene_updater_ptr->request_frame();
+    if(m_is_scene_polled)
+        return;
+    m_is_scene_polled = true;
+    glutTimerFunc(SCENE_POLL_MS, poll_scene_updater, 0);
+}
+
+void CGLScene::poll_scene_updater(int aValue) {
+    if(m_scene_updater_ptr->has_new_frame())
+        glutPostRedisplay();
+    // an idle window is not woken up, the next request starts the timer again
+    m_is_scene_polled = m_scene_updater_ptr->is_busy() || m_scene_frame.m_is_moving;
+    if(m_is_scene_polled)
+        glutTimerFunc(SCENE_POLL_MS, poll_scene_updater, aValue);
+}
+
+void CGLScene::export_frame_statistics() {
+    const CFrameTimeRing& a_ring = m_frame_profiler.get_ring();
+    if(a_ring.get_num_pushed() - m_num_exported_frames < FRAME_STATS_WINDOW)
+        return;
+    m_num_exported_frames = a_ring.get_num_pushed();
+    std::vector<CFrameTimes> times;
+    a_ring.copy_last(FRAME_STATS_WINDOW, times);
+    CFrameStatistics statistics;
+    statistics.compute(times);
+    std::cout << statistics.to_log_line();
+    if(m_frame_profiler.get_num_missed_gpu_times() > 0)
+        std::cout << " (" << m_frame_profiler.get_num_missed_gpu_times() << " GPU times not ready in time)";
+    std::cout << std::endl;
+    if(!m_frame_stats_file.empty())
+        gl_log(m_frame_stats_file.c_str(), "%s\n", statistics.to_json().c_str());
 }
 
 void CGLScene::reshape(int w, int h) {
     glViewport(0, 0, w, h);
     m_framebuffer_width = w;
     m_framebuffer_height = h;
-    glUseProgram(m_shader_program);
-    m_proj_mat = perspective(60.f, float(w)/float(h), 1.f, 1000.f);
-    glUniformMatrix4fv(m_proj_loc, 1, GL_FALSE, m_proj_mat.data());
+    m_proj_mat = perspective(FIELD_OF_VIEW_Y, float(w)/float(h), 1.f, 1000.f);
+    m_are_matrices_changed = true;
+    update_scene_settings();
 }
 
 void CGLScene::keyboard(unsigned char key, int x, int y) {
+    int move_key = get_move_key(key);
+    if(move_key != 0) {
+        // the camera moves at every frame while the key is held
+        m_move_keys |= move_key;
+        m_scene_updater_ptr->set_move_keys(m_move_keys);
+        request_scene_frame();
+        return;
+    }
     switch(key) {
-    case 'w':
-        m_fps_camera.move_foward();
-        m_fps_camera.update_camera_system();
-        m_view_mat = m_fps_camera.get_view_mat();
-        glUseProgram(m_shader_program);
-        glUniformMatrix4fv(m_view_loc, 1, GL_FALSE, m_view_mat.data());
-        glutPostRedisplay();
+    case '-':
+        // draw one branch level less, starting from all the levels
+        if(m_tree_skeleton_ptr) {
+            int num_levels = m_tree_skeleton_ptr->get_num_levels();
+            m_draw_level = (m_draw_level == 0) ? num_levels - 1 : m_draw_level - 1;
+            m_draw_level = std::max(m_draw_level, 1);
+            std::cout << "Drawing the branch levels 1 to " << m_draw_level << std::endl;
+            update_scene_settings();
+            glutPostRedisplay();
+        }
         break;
-    case 's':
-        m_fps_camera.move_backward();
-        m_fps_camera.update_camera_system();
-        m_view_mat = m_fps_camera.get_view_mat();
-        glUseProgram(m_shader_program);
-        glUniformMatrix4fv(m_view_loc, 1, GL_FALSE, m_view_mat.data());
+    case '=':
+    case '+':
+        // draw one branch level more, back to all the levels after the last one
+        if(m_tree_skeleton_ptr && m_draw_level > 0) {
+            ++m_draw_level;
+            if(m_draw_level >= m_tree_skeleton_ptr->get_num_levels())
+                m_draw_level = 0;
+            std::cout << "Drawing the branch levels 1 to "
+                      << (m_draw_level > 0 ? m_draw_level : m_tree_skeleton_ptr->get_num_levels()) << std::endl;
+            update_scene_settings();
+            glutPostRedisplay();
+        }
+        break;
+    case 't':
+        toggle_tube_mesh();
+        break;
+    case 'l':
+        m_is_lod_enabled = !m_is_lod_enabled;
+        std::cout << "Level of detail " << (m_is_lod_enabled ? "on" : "off") << std::endl;
+        update_scene_settings();
         glutPostRedisplay();
         break;
-    case 'a':
-        m_fps_camera.move_left();
-        m_fps_camera.update_camera_system();
-        m_view_mat = m_fps_camera.get_view_mat();
-        glUseProgram(m_shader_program);
-        glUniformMatrix4fv(m_view_loc, 1, GL_FALSE, m_view_mat.data());
+    case 'c':
+        m_is_culling_enabled = !m_is_culling_enabled;
+        m_num_culled_branches = 0;
+        std::cout << "Frustum culling " << (m_is_culling_enabled ? "on" : "off") << std::endl;
+        update_scene_settings();
         glutPostRedisplay();
         break;
-    case 'd':
-        m_fps_camera.move_right();
-        m_fps_camera.update_camera_system();
-        m_view_mat = m_fps_camera.get_view_mat();
-        glUseProgram(m_shader_program);
-        glUniformMatrix4fv(m_view_loc, 1, GL_FALSE, m_view_mat.data());
+    case ',':
+    case '.':
+        // halve or double the screen space error of the level of detail
+        m_max_pixel_error = (key == ',') ? std::max(m_max_pixel_error * 0.5f, 0.125f)
+                                         : std::min(m_max_pixel_error * 2.f, 64.f);
+        std::cout << "Maximum pixel error of the level of detail: " << m_max_pixel_error << std::endl;
+        update_scene_settings();
         glutPostRedisplay();
         break;
     default:
@@ -137,41 +340,242 @@ void CGLScene::keyboard(unsigned char key, int x, int y) {
     }
 }
 
+void CGLScene::keyboard_up(unsigned char key, int x, int y) {
+    int move_key = get_move_key(key);
+    if(move_key != 0) {
+        m_move_keys &= ~move_key;
+        m_scene_updater_ptr->set_move_keys(m_move_keys);
+        // the frame where the camera stops
+        request_scene_frame();
+    }
+}
+
 void CGLScene::mouse_input(int button, int state, int x, int y) {
     if(button == GLUT_LEFT_BUTTON && state == GLUT_DOWN) {
         m_mouse_pos_x = x;
         m_mouse_pos_y = y;
+        m_is_mouse_dragged = false;
+    } else if(button == GLUT_LEFT_BUTTON && state == GLUT_UP && !m_is_mouse_dragged) {
+        // a click without turning the camera picks a branch
+        pick_branch(x, y);
     }
 }
 
 void CGLScene::mouse_motion(int x, int y) {
     int dx = x - m_mouse_pos_x;
     int dy = y - m_mouse_pos_y;
+    if(dx == 0 && dy == 0)
+        return;
+    m_is_mouse_dragged = true;
     m_mouse_pos_x = x;
     m_mouse_pos_y = y;
-    m_fps_camera.update_orientation(float(dy), float(dx));
-    m_view_mat = m_fps_camera.get_view_mat();
-    glUseProgram(m_shader_program);
-    glUniformMatrix4fv(m_view_loc, 1, GL_FALSE, m_view_mat.data());
-    glutPostRedisplay();
+    // turned once at the next frame, however many motion events come before it
+    m_scene_updater_ptr->add_turn(dy, dx);
+    request_scene_frame();
 }
 
 void CGLScene::create_tree_skeleton() {
     std::shared_ptr<CDAGTree<float>> a_tree_ptr(new CDAGTree<float>());
+    a_tree_ptr->set_branch_cache_enabled(m_is_branch_cache_enabled);
     if(a_tree_ptr->load_tree_file(TREE_FILE_PATH)) {
         std::cout << "The tree file is read successfully!\n";
         std::cout << "Total number of tree nodes: " << a_tree_ptr->get_total_num_of_nodes() << std::endl;
         a_tree_ptr->extract_branches();
+        if(a_tree_ptr->is_branch_cache_hit())
+            std::cout << "The tree branches are read from " << a_tree_ptr->get_branch_cache_file_name() << std::endl;
         std::cout << "Total number of tree branch levels: " << a_tree_ptr->get_total_num_of_branch_levels() << std::endl;
         CBBox<float> tree_box;
         a_tree_ptr->compute_bounding_box(tree_box);
         // create a tree skeleton
-        m_tree_skeleton_ptr.reset(new CTreeSkeleton(a_tree_ptr));
-        float z_scale = tree_box.m_z_max - tree_box.m_z_min;
-        m_fps_camera.set_camera_position(m_fps_camera.get_cam_pos() + Eigen::Vector3f(0.f, 0.f, 2.f*z_scale));
+        set_tree_skeleton(std::shared_ptr<CTreeSkeleton>(new CTreeSkeleton(a_tree_ptr)));
+        m_tree_ptr = a_tree_ptr;
+        place_camera(tree_box.m_z_max - tree_box.m_z_min);
+
+    } else {
+        std::cout << "Failed read the tree file\n";
+    }
+}
 
+void CGLScene::create_forest() {
+    std::shared_ptr<CTreeForest> a_forest_ptr(new CTreeForest());
+    a_forest_ptr->set_branch_cache_enabled(m_is_branch_cache_enabled);
+    CBBox<float> forest_box;
+    if(a_forest_ptr->read_forest_file(m_forest_file) && a_forest_ptr->get_bounding_box(forest_box)) {
+        a_forest_ptr->create_buffers();
+        std::cout << "The forest file is read successfully!\n";
+        std::cout << "Total number of distinct trees: " << a_forest_ptr->get_num_trees()
+                  << ", placed trees: " << a_forest_ptr->get_num_instances() << std::endl;
+        m_forest_ptr = a_forest_ptr;
+        place_camera(forest_box.m_z_max - forest_box.m_z_min);
     } else {
+        std::cout << "Failed read the forest file\n";
+    }
+}
+
+void CGLScene::start_streaming_load() {
+    m_stream_loader_ptr.reset(new CTreeStreamLoader());
+    m_stream_loader_ptr->set_branch_cache_enabled(m_is_branch_cache_enabled);
+    m_segment_buffer_ptr.reset(new CTreeSegmentBuffer());
+    m_stream_loader_ptr->start(TREE_FILE_PATH);
+    glutTimerFunc(STREAMING_UPDATE_MS, update_streaming_load, 0);
+}
+
+void CGLScene::update_streaming_load(int aValue) {
+    if(!m_stream_loader_ptr)
+        return;
+    // the state is read first, so that all the segments are taken once it is finished
+    CTreeStreamLoader::State state = m_stream_loader_ptr->get_state();
+
+    std::vector<float> vertices;
+    if(m_stream_loader_ptr->take_segments(vertices) > 0) {
+        if(!m_is_camera_placed) {
+            // place the camera by the depth of the first segments, the tree base
+            float z_min(vertices[2]), z_max(vertices[2]);
+            for(size_t i = 2; i < vertices.size(); i += 3) {
+                z_min = std::min(z_min, vertices[i]);
+                z_max = std::max(z_max, vertices[i]);
+            }
+            place_camera(z_max - z_min);
+        }
+        m_segment_buffer_ptr->append(vertices);
+        glutPostRedisplay();
+    }
+
+    if(state == CTreeStreamLoader::Finished) {
+        const std::shared_ptr<CDAGTree<float>>& a_tree_ptr = m_stream_loader_ptr->get_tree();
+        std::cout << "The tree file is read successfully!\n";
+        std::cout << "Total number of tree nodes: " << a_tree_ptr->get_total_num_of_nodes() << std::endl;
+        if(a_tree_ptr->is_branch_cache_hit())
+            std::cout << "The tree branches are read from " << a_tree_ptr->get_branch_cache_file_name() << std::endl;
+        std::cout << "Total number of tree branch levels: " << a_tree_ptr->get_total_num_of_branch_levels() << std::endl;
+        if(!m_is_camera_placed) {
+            CBBox<float> tree_box;
+            a_tree_ptr->compute_bounding_box(tree_box);
+            place_camera(tree_box.m_z_max - tree_box.m_z_min);
+        }
+        // switch from the segments to the branch strips
+        set_tree_skeleton(std::shared_ptr<CTreeSkeleton>(new CTreeSkeleton(m_stream_loader_ptr->get_skeleton_arrays(),
+                                                                           m_stream_loader_ptr->get_branch_lod())));
+        m_tree_ptr = a_tree_ptr;
+        m_segment_buffer_ptr.reset();
+        m_stream_loader_ptr.reset();
+        glutPostRedisplay();
+    } else if(state == CTreeStreamLoader::Failed) {
         std::cout << "Failed read the tree file\n";
+        m_segment_buffer_ptr.reset();
+        m_stream_loader_ptr.reset();
+        glutPostRedisplay();
+    } else {
+        glutTimerFunc(STREAMING_UPDATE_MS, update_streaming_load, aValue);
+    }
+}
+
+void CGLScene::set_tree_skeleton(const std::shared_ptr<CTreeSkeleton>& aSkeletonPtr) {
+    // the scene updater stops choosing from the former levels of detail before they are released
+    m_scene_updater_ptr->set_branch_lod(&aSkeletonPtr->get_branch_lod());
+    m_tree_skeleton_ptr = aSkeletonPtr;
+    request_scene_frame();
+}
+
+void CGLScene::toggle_tube_mesh() {
+    if(!m_tree_ptr)
+        return;
+    m_is_tube_visible = !m_is_tube_visible;
+    if(m_is_tube_visible && !m_tree_tube_ptr && !m_is_tube_requested) {
+        std::cout << "Building the tube mesh..." << std::endl;
+        m_geometry_builder_ptr->request_tube_mesh(m_tree_ptr, TUBE_RADIAL_SEGMENTS);
+        m_is_tube_requested = true;
+        start_tree_geometry_polling();
+    }
+    glutPostRedisplay();
+}
+
+void CGLScene::update_tree_geometry(int aValue) {
+    CTreeTubeMesh a_mesh;
+    double seconds(0.0);
+    if(m_geometry_builder_ptr->take_tube_mesh(a_mesh, seconds)) {
+        std::cout << "Total number of tube mesh triangles: " << a_mesh.get_num_triangles()
+                  << " (built in " << seconds * 1e3 << " ms)" << std::endl;
+        // only the upload is left to the rendering thread
+        m_tree_tube_ptr.reset(new CTreeTube(a_mesh));
+        if(m_is_tube_visible)
+            glutPostRedisplay();
+    }
+    std::shared_ptr<CTreeSegmentBVH> a_bvh_ptr = m_geometry_builder_ptr->take_segment_bvh(seconds);
+    if(a_bvh_ptr) {
+        std::cout << "Built the picking hierarchy of " << a_bvh_ptr->get_num_segments() << " segments in "
+                  << seconds * 1e3 << " ms" << std::endl;
+        m_segment_bvh_ptr = a_bvh_ptr;
+        if(m_has_pending_pick) {
+            m_has_pending_pick = false;
+            pick_along_ray(m_pending_pick_eye, m_pending_pick_direction);
+        }
+    }
+    m_is_geometry_polled = m_geometry_builder_ptr->is_busy();
+    if(m_is_geometry_polled)
+        glutTimerFunc(GEOMETRY_POLL_MS, update_tree_geometry, aValue);
+}
+
+void CGLScene::start_tree_geometry_polling() {
+    if(m_is_geometry_polled)
+        return;
+    m_is_geometry_polled = true;
+    glutTimerFunc(GEOMETRY_POLL_MS, update_tree_geometry, 0);
+}
+
+void CGLScene::pick_branch(int aX, int aY) {
+    if(!m_tree_ptr)
+        return;
+    const Eigen::Vector3f& eye = m_fps_camera.get_cam_pos();
+    Eigen::Vector3f direction = m_fps_camera.get_ray_direction(m_proj_mat, float(aX), float(aY),
+                                                               m_framebuffer_width, m_framebuffer_height);
+    if(!m_segment_bvh_ptr) {
+        // the ray of the latest click is cast once the hierarchy is built
+        m_has_pending_pick = true;
+        m_pending_pick_eye = eye;
+        m_pending_pick_direction = direction;
+        if(!m_is_bvh_requested) {
+            std::cout << "Building the picking hierarchy..." << std::endl;
+            m_geometry_builder_ptr->request_segment_bvh(m_tree_ptr);
+            m_is_bvh_requested = true;
+            start_tree_geometry_polling();
+        }
+        return;
+    }
+    pick_along_ray(eye, direction);
+}
+
+void CGLScene::pick_along_ray(const Eigen::Vector3f& aEye, const Eigen::Vector3f& aDirection) {
+    Eigen::Vector3f box_min, box_max;
+    if(!m_segment_bvh_ptr->get_bounding_box(box_min, box_max))
+        return;
+    // the size of the pick pixels at the distance of the tree
+    float pixel_scale = float(m_framebuffer_height) / (2.f * std::tan(FIELD_OF_VIEW_Y * float(M_PI) / 360.f));
+    float min_radius = PICK_PIXEL_RADIUS * (0.5f * (box_min + box_max) - aEye).norm() / pixel_scale;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CSegmentHit a_hit;
+    bool is_hit = m_segment_bvh_ptr->intersect(aEye, aDirection, min_radius, a_hit);
+    double micro_seconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    if(is_hit) {
+        std::cout << "Picked node " << a_hit.m_node_index
+                  << ": branch level " << m_tree_ptr->get_node_branch_level(a_hit.m_node_index)
+                  << ", radius " << m_tree_ptr->get_node_radius(a_hit.m_node_index)
+                  << ", distance " << a_hit.m_distance
+                  << " (" << micro_seconds << " us)" << std::endl;
+    } else {
+        std::cout << "No branch picked (" << micro_seconds << " us)" << std::endl;
+    }
+}
+
+void CGLScene::place_camera(float aZScale) {
+    m_fps_camera.set_camera_position(m_fps_camera.get_cam_pos() + Eigen::Vector3f(0.f, 0.f, 2.f*aZScale));
+    m_is_camera_placed = true;
+    m_view_mat = m_fps_camera.get_view_mat();
+    m_are_matrices_changed = true;
+    if(m_scene_updater_ptr) {
+        m_scene_updater_ptr->set_camera(m_fps_camera);
+        request_scene_frame();
     }
 }
 
@@ -188,18 +592,26 @@ void CGLScene::setup(int* argc, char** argv) {
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
+    glutKeyboardUpFunc(keyboard_up);
+    // a held key moves the camera every frame, not at every repeat
+    glutIgnoreKeyRepeat(1);
     glutMouseFunc(mouse_input);
     glutMotionFunc(mouse_motion);
 
     glewExperimental = GL_TRUE;
     glewInit();
 
-    // Setup the tree skeleton to be rendered
-    create_tree_skeleton();
-
     // Initialize some global opengl states
     init();
 
+    // Setup the tree skeleton or the forest to be rendered
+    if(!m_forest_file.empty())
+        create_forest();
+    else if(m_is_streaming_load)
+        start_streaming_load();
+    else
+        create_tree_skeleton();
+
     // Query and print some opengl informations
     restart_gl_log("gl_params.txt");
     log_gl_params("gl_params.txt");
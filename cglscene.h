@@ -4,7 +4,16 @@
 #include "GLUtilities/camera.h"
 #include "Eigen/Dense"
 #include "ctreeskeleton.h"
+#include "ctreetube.h"
+#include "ctreesegmentbuffer.h"
+#include "ctreestreamloader.h"
+#include "ctreesegmentbvh.h"
+#include "ctreegeometrybuilder.h"
+#include "ctreeforest.h"
+#include "csceneupdater.h"
+#include "cframeprofiler.h"
 #include <memory>
+#include <string>
 
 /*
  * The CGLScene represents a typical 3D Scene which is to be
@@ -25,14 +34,111 @@ public:
     CGLScene& operator=(const CGLScene&)=delete;
 public:
     static void set_framebuffer_size(int width, int height);
+    /*
+     * Stream the tree in on a background thread (the default), showing its parent-child
+     * segments as they are read and the branch skeleton once it is extracted.
+     * Otherwise the tree is loaded and extracted before the window shows anything.
+     * Set before setup().
+    */
+    static void set_streaming_load(bool aStreaming) {
+        m_is_streaming_load = aStreaming;
+    }
+    /*
+     * Show the placed trees of a forest file (see CTreeForest::read_forest_file())
+     * instead of the single tree. Set before setup().
+    */
+    static void set_forest_file(const std::string& aFileName) {
+        m_forest_file = aFileName;
+    }
+    /*
+     * Append the frame time percentiles, printed every few hundred frames, to a file
+     * as well, one JSON object per line. Set before setup().
+    */
+    static void set_frame_stats_file(const std::string& aFileName) {
+        m_frame_stats_file = aFileName;
+    }
+    /*
+     * Reuse the branches extracted at a previous launch, reading and writing a .treebc
+     * file next to every tree file (see CDAGTree::set_branch_cache_enabled()).
+     * Off by default, so nothing is written next to the tree files. Set before setup().
+    */
+    static void set_branch_cache_enabled(bool aEnabled) {
+        m_is_branch_cache_enabled = aEnabled;
+    }
     void setup(int* argc, char** argv);
     void render();
 protected:
     void create_tree_skeleton();
+    void create_forest();
+    void start_streaming_load();
+    /*
+     * Upload the segments streamed in since the last call, and switch to the branch
+     * skeleton once the loader has finished. Called from a GLUT timer while loading.
+    */
+    static void update_streaming_load(int aValue);
+    /*
+     * Move the camera back from the tree by twice its depth.
+    */
+    static void place_camera(float aZScale);
+    /*
+     * Show a new skeleton, with the scene updater choosing from its levels of detail.
+    */
+    static void set_tree_skeleton(const std::shared_ptr<CTreeSkeleton>& aSkeletonPtr);
+    /*
+     * Pass the view and the level of detail settings to the scene updater and ask it for a frame.
+    */
+    static void update_scene_settings();
+    /*
+     * Ask the scene updater for a frame and start the timer of poll_scene_updater() unless it runs.
+    */
+    static void request_scene_frame();
+    /*
+     * Redraw once the scene updater has published a frame. Called from a GLUT timer
+     * while a frame is requested, produced or not yet taken, or the camera moves.
+    */
+    static void poll_scene_updater(int aValue);
+    /*
+     * Draw the scene of the frame taken from the scene updater.
+    */
+    static void draw_scene();
+    /*
+     * Print the percentiles of the frame times once enough frames are recorded since the
+     * last time, and append them to the frame statistics file if one is set.
+    */
+    static void export_frame_statistics();
+    /*
+     * Upload the projection, view and model matrices into the uniform buffer if one of
+     * them has changed since the last frame.
+    */
+    static void update_matrices_buffer();
+    /*
+     * Show the tube mesh instead of the line skeleton or back. The mesh is built from
+     * the loaded tree by the geometry builder when it is first shown, and the skeleton
+     * stays on screen until it is ready.
+    */
+    static void toggle_tube_mesh();
+    /*
+     * Print the node, branch level and radius of the branch under a window position.
+     * The segment hierarchy is built from the loaded tree by the geometry builder at the
+     * first pick, which is answered once it is ready.
+    */
+    static void pick_branch(int aX, int aY);
+    /*
+     * Print the branch the ray from aEye along aDirection hits, with the segment hierarchy built.
+    */
+    static void pick_along_ray(const Eigen::Vector3f& aEye, const Eigen::Vector3f& aDirection);
+    /*
+     * Upload the tube mesh and take the segment hierarchy published by the geometry
+     * builder. Called from a GLUT timer while the builder is busy.
+    */
+    static void update_tree_geometry(int aValue);
+    // start the timer of update_tree_geometry() unless it runs
+    static void start_tree_geometry_polling();
     static void init();
     static void reshape(int w, int h);
     static void display();
     static void keyboard(unsigned char key, int x, int y);
+    static void keyboard_up(unsigned char key, int x, int y);
     static void mouse_input(int button, int state, int x, int y);
     static void mouse_motion(int x, int y);
 private:
@@ -40,10 +146,42 @@ private:
     static int m_framebuffer_height;
     static int m_mouse_pos_x, m_mouse_pos_y;
     static Eigen::Matrix4f m_model_mat, m_view_mat, m_proj_mat;
-    static int m_model_loc, m_view_loc, m_proj_loc;
+    static unsigned m_matrices_buffer;      // the uniform buffer of the three matrices
+    static bool m_are_matrices_changed;     // the matrices are to be uploaded at the next frame
+    static int m_instanced_loc;
+    static int m_move_keys;                 // the move keys held down, see CSceneUpdater::MoveKey
+    static std::shared_ptr<CSceneUpdater> m_scene_updater_ptr;
+    static bool m_is_scene_polled;          // the timer of poll_scene_updater() runs
+    static CSceneFrame m_scene_frame;       // the frame drawn, taken from the scene updater
+    static CFrameProfiler m_frame_profiler;
+    static uint64_t m_num_exported_frames;  // the frames of the profiler up to the last export
+    static std::string m_frame_stats_file;
     static int m_shader_program;
     static Camera m_fps_camera;
+    static std::shared_ptr<CDAGTree<float>> m_tree_ptr;         // the loaded tree, null while loading
     static std::shared_ptr<CTreeSkeleton> m_tree_skeleton_ptr;
+    static std::shared_ptr<CTreeTube> m_tree_tube_ptr;
+    static std::shared_ptr<CTreeSegmentBVH> m_segment_bvh_ptr;     // the segments for picking, built at the first pick
+    static std::shared_ptr<CTreeGeometryBuilder> m_geometry_builder_ptr;   // builds the tube mesh and the hierarchy
+    static bool m_is_tube_requested;
+    static bool m_is_bvh_requested;
+    static bool m_is_geometry_polled;       // the timer of update_tree_geometry() runs
+    static bool m_has_pending_pick;         // a pick waits for the segment hierarchy
+    static Eigen::Vector3f m_pending_pick_eye, m_pending_pick_direction;   // its ray, from the camera of the click
+    static bool m_is_mouse_dragged;         // the camera was turned since the button went down
+    static bool m_is_tube_visible;
+    static int m_draw_level;                // the highest branch level drawn, 0 for all the levels
+    static bool m_is_lod_enabled;           // draw the branches simplified by their screen size
+    static float m_max_pixel_error;         // the screen space error of the level of detail
+    static bool m_is_culling_enabled;       // leave out the branches outside the view frustum
+    static size_t m_num_culled_branches;    // the branches culled at the last frame
+    static bool m_is_streaming_load;
+    static bool m_is_branch_cache_enabled;
+    static bool m_is_camera_placed;
+    static std::shared_ptr<CTreeStreamLoader> m_stream_loader_ptr;
+    static std::shared_ptr<CTreeSegmentBuffer> m_segment_buffer_ptr;   // the segments shown while streaming
+    static std::string m_forest_file;
+    static std::shared_ptr<CTreeForest> m_forest_ptr;          // the forest shown instead of the tree
 };
 
 #endif // CGLSCENE_H
@@ -0,0 +1,53 @@
+#include "cmappedfile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+CMappedFile::CMappedFile() : m_data(nullptr), m_size(0), m_is_open(false)
+{
+
+}
+
+CMappedFile::~CMappedFile() {
+    close();
+}
+
+bool CMappedFile::open(const std::string& aFileName) {
+    close();
+    int fd = ::open(aFileName.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+
+    m_size = size_t(file_stat.st_size);
+    if(m_size > 0) {
+        void* p = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p == MAP_FAILED) {
+            ::close(fd);
+            m_size = 0;
+            return false;
+        }
+        // the file is read front to back exactly once
+        madvise(p, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const char*>(p);
+    }
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+    m_is_open = true;
+    return true;
+}
+
+void CMappedFile::close() {
+    if(m_data != nullptr)
+        munmap(const_cast<char*>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_is_open = false;
+}
@@ -0,0 +1,46 @@
+#ifndef CMAPPEDFILE_H
+#define CMAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+/*
+ * A read-only memory mapping of a whole file.
+ * The file contents are exposed as a contiguous byte range which stays valid
+ * for the lifetime of the object. The mapping is released in the destructor.
+*/
+class CMappedFile
+{
+public:
+    CMappedFile();
+    ~CMappedFile();
+    CMappedFile(const CMappedFile&)=delete;
+    CMappedFile& operator=(const CMappedFile&)=delete;
+public:
+    /*
+     * Map the given file into memory.
+     * Returns true if the file is mapped successfully, otherwise false.
+     * An empty file is opened successfully with a null data pointer.
+    */
+    bool open(const std::string& aFileName);
+    /*
+     * Unmap the file. It is safe to call this on a closed mapping.
+    */
+    void close();
+
+    bool is_open() const {
+        return m_is_open;
+    }
+    const char* data() const {
+        return m_data;
+    }
+    size_t size() const {
+        return m_size;
+    }
+private:
+    const char* m_data;     // the first byte of the mapped file
+    size_t m_size;          // the file size in bytes
+    bool m_is_open;
+};
+
+#endif // CMAPPEDFILE_H
@@ -0,0 +1,199 @@
+#include "csceneupdater.h"
+#include "cfrustum.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// the camera speed in units per second, about the former step of a key repeat at 30 repeats per second
+static const float CAMERA_MOVE_SPEED = 6.f;
+// the longest time a frame moves the camera for, so that a stalled frame does not jump
+static const float MAX_FRAME_SECONDS = 0.1f;
+
+CSceneFrame::CSceneFrame() :
+    m_camera(Eigen::Vector3f(0.f, 0.f, 0.f), Eigen::Vector3f(0.f, 0.f, 0.f), Eigen::Vector3f(0.f, 1.f, 0.f)),
+    m_view_mat(Eigen::Matrix4f::Identity()),
+    m_lod(nullptr),
+    m_num_culled_branches(0),
+    m_is_moving(false),
+    m_update_seconds(0.0),
+    m_frame_index(0)
+{
+
+}
+
+CSceneUpdater::CSceneUpdater(const Camera& aCamera) :
+    m_camera(aCamera),
+    m_move_keys(0),
+    m_pending_pitch(0),
+    m_pending_yaw(0),
+    m_proj_mat(Eigen::Matrix4f::Identity()),
+    m_model_mat(Eigen::Matrix4f::Identity()),
+    m_pixel_scale(1.f),
+    m_lod(nullptr),
+    m_max_pixel_error(0.f),
+    m_is_culling_enabled(false),
+    m_max_branch_level(0),
+    m_is_requested(false),
+    m_is_updating(false),
+    m_is_stopping(false),
+    m_is_latest_new(false),
+    m_num_frames(0)
+{
+    m_thread = thread(&CSceneUpdater::run, this);
+}
+
+CSceneUpdater::~CSceneUpdater() {
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_is_stopping = true;
+    }
+    m_work_available.notify_one();
+    m_thread.join();
+}
+
+void CSceneUpdater::set_move_keys(int aMoveKeys) {
+    lock_guard<mutex> lock(m_mutex);
+    // the camera moves from this moment on
+    if(m_move_keys == 0 && aMoveKeys != 0)
+        m_last_update_time = chrono::steady_clock::now();
+    m_move_keys = aMoveKeys;
+}
+
+void CSceneUpdater::add_turn(int aPitchUnits, int aYawUnits) {
+    lock_guard<mutex> lock(m_mutex);
+    m_pending_pitch += aPitchUnits;
+    m_pending_yaw += aYawUnits;
+}
+
+void CSceneUpdater::set_camera(const Camera& aCamera) {
+    lock_guard<mutex> lock(m_mutex);
+    m_camera = aCamera;
+    m_pending_pitch = m_pending_yaw = 0;
+}
+
+void CSceneUpdater::set_view(const Eigen::Matrix4f& aProjMat, const Eigen::Matrix4f& aModelMat, float aPixelScale) {
+    lock_guard<mutex> lock(m_mutex);
+    m_proj_mat = aProjMat;
+    m_model_mat = aModelMat;
+    m_pixel_scale = aPixelScale;
+}
+
+void CSceneUpdater::set_branch_lod(const CTreeBranchLOD* aLod) {
+    // the former levels may be in use until the frame being produced is done
+    lock_guard<mutex> update_lock(m_update_mutex);
+    lock_guard<mutex> lock(m_mutex);
+    m_lod = aLod;
+}
+
+void CSceneUpdater::set_lod_settings(float aMaxPixelError, bool aIsCullingEnabled, int aMaxBranchLevel) {
+    lock_guard<mutex> lock(m_mutex);
+    m_max_pixel_error = aMaxPixelError;
+    m_is_culling_enabled = aIsCullingEnabled;
+    m_max_branch_level = aMaxBranchLevel;
+}
+
+void CSceneUpdater::request_frame() {
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_is_requested = true;
+    }
+    m_work_available.notify_one();
+}
+
+bool CSceneUpdater::take_frame(CSceneFrame& aFrame) {
+    lock_guard<mutex> lock(m_mutex);
+    if(!m_is_latest_new)
+        return false;
+    swap(aFrame, m_latest_frame);
+    m_is_latest_new = false;
+    return true;
+}
+
+bool CSceneUpdater::has_new_frame() {
+    lock_guard<mutex> lock(m_mutex);
+    return m_is_latest_new;
+}
+
+bool CSceneUpdater::is_busy() {
+    lock_guard<mutex> lock(m_mutex);
+    return m_is_requested || m_is_updating || m_is_latest_new;
+}
+
+void CSceneUpdater::run() {
+    while(true) {
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_work_available.wait(lock, [this]() {
+                return m_is_requested || m_is_stopping;
+            });
+            if(m_is_stopping)
+                return;
+            m_is_requested = false;
+            m_is_updating = true;
+        }
+        lock_guard<mutex> update_lock(m_update_mutex);
+        update_frame();
+        // publish the frame, taking the former latest one to fill next
+        lock_guard<mutex> lock(m_mutex);
+        swap(m_back_frame, m_latest_frame);
+        m_is_latest_new = true;
+        m_is_updating = false;
+    }
+}
+
+void CSceneUpdater::update_frame() {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    // take the input, then work on the copies without holding the lock
+    Eigen::Matrix4f proj_mat, model_mat;
+    float pixel_scale, max_pixel_error;
+    bool is_culling_enabled;
+    int max_branch_level;
+    const CTreeBranchLOD* a_lod;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        float seconds = min(chrono::duration<float>(start - m_last_update_time).count(), MAX_FRAME_SECONDS);
+        m_last_update_time = start;
+        if(m_pending_pitch != 0 || m_pending_yaw != 0) {
+            m_camera.update_orientation(float(m_pending_pitch), float(m_pending_yaw));
+            m_pending_pitch = m_pending_yaw = 0;
+        }
+        if(m_move_keys != 0) {
+            Eigen::Vector3f direction(Eigen::Vector3f::Zero());
+            if(m_move_keys & MoveForward)
+                direction += m_camera.get_cam_front_dir();
+            if(m_move_keys & MoveBackward)
+                direction -= m_camera.get_cam_front_dir();
+            if(m_move_keys & MoveLeft)
+                direction -= m_camera.get_cam_right_dir();
+            if(m_move_keys & MoveRight)
+                direction += m_camera.get_cam_right_dir();
+            m_camera.set_camera_position(m_camera.get_cam_pos() + CAMERA_MOVE_SPEED * seconds * direction);
+        }
+        m_back_frame.m_camera = m_camera;
+        m_back_frame.m_is_moving = m_move_keys != 0;
+        proj_mat = m_proj_mat;
+        model_mat = m_model_mat;
+        pixel_scale = m_pixel_scale;
+        max_pixel_error = m_max_pixel_error;
+        is_culling_enabled = m_is_culling_enabled;
+        max_branch_level = m_max_branch_level;
+        a_lod = m_lod;
+    }
+
+    CSceneFrame& a_frame = m_back_frame;
+    a_frame.m_view_mat = a_frame.m_camera.get_view_mat();
+    a_frame.m_lod_firsts.clear();
+    a_frame.m_lod_counts.clear();
+    a_frame.m_num_culled_branches = 0;
+    a_frame.m_lod = nullptr;
+    if(a_lod && (max_pixel_error > 0.f || is_culling_enabled)) {
+        CFrustum a_frustum(proj_mat, a_frame.m_view_mat * model_mat);
+        a_lod->select(a_frame.m_camera.get_cam_pos(), pixel_scale, max_pixel_error, max_branch_level,
+                      is_culling_enabled ? &a_frustum : nullptr, a_frame.m_lod_firsts, a_frame.m_lod_counts,
+                      &a_frame.m_num_culled_branches);
+        a_frame.m_lod = a_lod;
+    }
+    a_frame.m_frame_index = ++m_num_frames;
+    a_frame.m_update_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,119 @@
+#ifndef CSCENEUPDATER_H
+#define CSCENEUPDATER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "GLUtilities/camera.h"
+#include "ctreebranchlod.h"
+
+/*
+ * The scene state of one frame, produced by CSceneUpdater and drawn by the rendering thread.
+*/
+struct CSceneFrame {
+    CSceneFrame();
+
+    Camera m_camera;                        // the camera after the input up to this frame
+    Eigen::Matrix4f m_view_mat;
+    const CTreeBranchLOD* m_lod;            // the levels of detail the strips are chosen from, null if none
+    std::vector<uint32_t> m_lod_firsts;     // the chosen strips, see CTreeBranchLOD::select()
+    std::vector<int> m_lod_counts;
+    size_t m_num_culled_branches;
+    bool m_is_moving;                       // a move key is held, so the next frame moves on
+    double m_update_seconds;                // the time the frame took to produce
+    uint64_t m_frame_index;
+};
+
+/*
+ * Produce the state of the next frame on a worker thread, away from the rendering thread.
+ * The rendering thread passes the input (the held move keys, the mouse turns, the view and
+ * the level of detail settings) and requests a frame. The worker applies the input to its
+ * camera, moving by the time elapsed since the previous frame, and chooses the strips of
+ * the levels of detail inside the view frustum. The frames are double buffered: the worker
+ * fills its own frame and publishes it by swapping it with the latest one, and the
+ * rendering thread swaps the latest one with the frame it draws, so neither waits for the
+ * other and no array is copied. While the worker is busy the rendering thread keeps
+ * drawing the last frame it took. No OpenGL call is made here.
+*/
+class CSceneUpdater
+{
+public:
+    // the bits of the move keys
+    enum MoveKey {
+        MoveForward = 1,
+        MoveBackward = 2,
+        MoveLeft = 4,
+        MoveRight = 8
+    };
+public:
+    // starts the worker thread with the given camera
+    explicit CSceneUpdater(const Camera& aCamera);
+    // stops the worker thread
+    ~CSceneUpdater();
+    CSceneUpdater(const CSceneUpdater&)=delete;
+    CSceneUpdater& operator=(const CSceneUpdater&)=delete;
+public:
+    /*
+     * The input of the next frames, called from the rendering thread.
+    */
+    void set_move_keys(int aMoveKeys);
+    // turn the camera by mouse units around the right and the up direction
+    void add_turn(int aPitchUnits, int aYawUnits);
+    // replace the camera, e.g. when it is placed in front of a new tree
+    void set_camera(const Camera& aCamera);
+    void set_view(const Eigen::Matrix4f& aProjMat, const Eigen::Matrix4f& aModelMat, float aPixelScale);
+    /*
+     * The levels of detail settings, see CTreeBranchLOD::select(). Without aLod, or with
+     * a pixel error of 0 and no culling, no strips are chosen.
+     * The levels of detail must stay unchanged and alive until they are replaced here;
+     * this waits for a frame being produced from the former ones.
+    */
+    void set_branch_lod(const CTreeBranchLOD* aLod);
+    void set_lod_settings(float aMaxPixelError, bool aIsCullingEnabled, int aMaxBranchLevel);
+    /*
+     * Ask the worker for a frame from the input so far.
+    */
+    void request_frame();
+    /*
+     * Swap the latest published frame into aFrame.
+     * Returns false, leaving aFrame unchanged, if no frame was published since the last call.
+    */
+    bool take_frame(CSceneFrame& aFrame);
+    bool has_new_frame();
+    // a frame is requested or being produced, or published and not taken yet
+    bool is_busy();
+protected:
+    void run();
+    // produce m_back_frame from the input, with m_update_mutex held
+    void update_frame();
+private:
+    // the input, guarded by m_mutex
+    Camera m_camera;
+    int m_move_keys;
+    int m_pending_pitch, m_pending_yaw;
+    Eigen::Matrix4f m_proj_mat, m_model_mat;
+    float m_pixel_scale;
+    const CTreeBranchLOD* m_lod;
+    float m_max_pixel_error;
+    bool m_is_culling_enabled;
+    int m_max_branch_level;
+    std::chrono::steady_clock::time_point m_last_update_time;
+    bool m_is_requested;
+    bool m_is_updating;
+    bool m_is_stopping;
+    // the frames
+    CSceneFrame m_back_frame;                   // being produced by the worker
+    CSceneFrame m_latest_frame;                 // the last published, guarded by m_mutex
+    bool m_is_latest_new;
+    uint64_t m_num_frames;
+    std::mutex m_mutex;
+    std::mutex m_update_mutex;                  // held while a frame is produced
+    std::condition_variable m_work_available;
+    std::thread m_thread;
+};
+
+#endif // CSCENEUPDATER_H
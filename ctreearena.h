@@ -0,0 +1,243 @@
+#ifndef CTREEARENA_H
+#define CTREEARENA_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+
+/*
+ * The ways the memory of a tree is allocated.
+ * Default: every array and branch is allocated individually from the heap.
+ * Arena: everything is carved from a per-tree monotonic arena, sized up front
+ *        from the input, and released in one go when the tree is destroyed.
+*/
+enum class TreeAllocMode {
+    Default,
+    Arena
+};
+
+/*
+ * The memory held by a tree, in bytes requested from the heap.
+*/
+struct CTreeMemoryStats {
+    size_t m_current_bytes;     // the bytes currently held
+    size_t m_peak_bytes;        // the largest number of bytes held at any time
+};
+
+/*
+ * A memory resource forwarding to an upstream resource while counting
+ * the bytes currently allocated and their high-water mark.
+ * It is created with create() and lives on until its owner has called release() and
+ * every allocation made through it is returned, so that memory handed out by its owner,
+ * e.g. a branch of a tree, can still be freed, and counted, after the owner is gone.
+*/
+class CCountingResource : public std::pmr::memory_resource {
+public:
+    static CCountingResource* create(std::pmr::memory_resource* aUpstream = std::pmr::new_delete_resource()) {
+        return new CCountingResource(aUpstream);
+    }
+    CCountingResource(const CCountingResource&)=delete;
+    CCountingResource& operator=(const CCountingResource&)=delete;
+    // the owner gives the resource up, it is deleted once the last allocation is returned
+    void release() {
+        if(m_num_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+public:
+    size_t get_current_bytes() const {
+        return m_current_bytes.load(std::memory_order_relaxed);
+    }
+    size_t get_peak_bytes() const {
+        return m_peak_bytes.load(std::memory_order_relaxed);
+    }
+protected:
+    explicit CCountingResource(std::pmr::memory_resource* aUpstream)
+        : m_upstream(aUpstream), m_current_bytes(0), m_peak_bytes(0), m_num_refs(1) {}
+    ~CCountingResource() {}
+    void* do_allocate(size_t aBytes, size_t aAlignment) override {
+        void* p = m_upstream->allocate(aBytes, aAlignment);
+        m_num_refs.fetch_add(1, std::memory_order_relaxed);
+        size_t current = m_current_bytes.fetch_add(aBytes, std::memory_order_relaxed) + aBytes;
+        size_t peak = m_peak_bytes.load(std::memory_order_relaxed);
+        while(current > peak && !m_peak_bytes.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+            ;
+        return p;
+    }
+    void do_deallocate(void* p, size_t aBytes, size_t aAlignment) override {
+        m_upstream->deallocate(p, aBytes, aAlignment);
+        m_current_bytes.fetch_sub(aBytes, std::memory_order_relaxed);
+        release();
+    }
+    bool do_is_equal(const std::pmr::memory_resource& aOther) const noexcept override {
+        return this == &aOther;
+    }
+private:
+    std::pmr::memory_resource* m_upstream;
+    std::atomic<size_t> m_current_bytes;
+    std::atomic<size_t> m_peak_bytes;
+    std::atomic<size_t> m_num_refs;     // the owner and the allocations not returned
+};
+
+/*
+ * A memory resource serializing the calls to an upstream resource which is not thread-safe.
+*/
+class CLockedResource : public std::pmr::memory_resource {
+public:
+    explicit CLockedResource(std::pmr::memory_resource* aUpstream) : m_upstream(aUpstream) {}
+protected:
+    void* do_allocate(size_t aBytes, size_t aAlignment) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_upstream->allocate(aBytes, aAlignment);
+    }
+    void do_deallocate(void* p, size_t aBytes, size_t aAlignment) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_upstream->deallocate(p, aBytes, aAlignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& aOther) const noexcept override {
+        return this == &aOther;
+    }
+private:
+    std::pmr::memory_resource* m_upstream;
+    std::mutex m_mutex;
+};
+
+/*
+ * A monotonic arena carving the allocations from chunks of an upstream resource.
+ * Unlike std::pmr::monotonic_buffer_resource, whose chunks grow geometrically and
+ * leave the tail of the last one unused, the next chunk can be sized from the input
+ * with reserve(); an owner which reserves its arrays exactly before filling them
+ * takes about the bytes it uses. Without a reservation the chunks grow as in
+ * std::pmr::monotonic_buffer_resource. Deallocation does nothing, the chunks are
+ * returned when the arena is destroyed. Not thread-safe.
+*/
+class CArenaResource : public std::pmr::memory_resource {
+public:
+    explicit CArenaResource(std::pmr::memory_resource* aUpstream)
+        : m_upstream(aUpstream), m_chunks(nullptr), m_current(0), m_end(0), m_next_chunk_size(INITIAL_CHUNK_SIZE) {}
+    ~CArenaResource() {
+        while(m_chunks != nullptr) {
+            CChunk* a_chunk = m_chunks;
+            m_chunks = a_chunk->m_next;
+            m_upstream->deallocate(a_chunk, a_chunk->m_size, alignof(std::max_align_t));
+        }
+    }
+    CArenaResource(const CArenaResource&)=delete;
+    CArenaResource& operator=(const CArenaResource&)=delete;
+public:
+    /*
+     * Make room for at least aBytes of allocations in the current chunk, starting a
+     * chunk of exactly that room if the current one has less left.
+    */
+    void reserve(size_t aBytes) {
+        if(m_end - m_current < aBytes)
+            add_chunk(aBytes);
+    }
+protected:
+    void* do_allocate(size_t aBytes, size_t aAlignment) override {
+        uintptr_t p = align_up(m_current, aAlignment);
+        if(p < m_current || p > m_end || m_end - p < aBytes) {
+            // the next chunk at least doubles, as in std::pmr::monotonic_buffer_resource
+            add_chunk(std::max(aBytes + aAlignment, m_next_chunk_size));
+            m_next_chunk_size *= 2;
+            p = align_up(m_current, aAlignment);
+        }
+        m_current = p + aBytes;
+        return reinterpret_cast<void*>(p);
+    }
+    void do_deallocate(void*, size_t, size_t) override {
+    }
+    bool do_is_equal(const std::pmr::memory_resource& aOther) const noexcept override {
+        return this == &aOther;
+    }
+private:
+    struct alignas(std::max_align_t) CChunk {
+        CChunk* m_next;
+        size_t m_size;                  // the bytes of the chunk, this header included
+    };
+    static const size_t INITIAL_CHUNK_SIZE = 1024;
+    static uintptr_t align_up(uintptr_t aAddress, size_t aAlignment) {
+        return (aAddress + aAlignment - 1) & ~uintptr_t(aAlignment - 1);
+    }
+    void add_chunk(size_t aBytes) {
+        const size_t chunk_size = sizeof(CChunk) + aBytes;
+        CChunk* a_chunk = static_cast<CChunk*>(m_upstream->allocate(chunk_size, alignof(std::max_align_t)));
+        a_chunk->m_next = m_chunks;
+        a_chunk->m_size = chunk_size;
+        m_chunks = a_chunk;
+        m_current = reinterpret_cast<uintptr_t>(a_chunk + 1);
+        m_end = m_current + aBytes;
+    }
+private:
+    std::pmr::memory_resource* m_upstream;
+    CChunk* m_chunks;                   // the chunks taken so far, the current one first
+    uintptr_t m_current, m_end;         // the free room of the current chunk
+    size_t m_next_chunk_size;
+};
+
+/*
+ * The memory resource owned by a tree.
+ * In the default mode the allocations go to the heap through a CCountingResource,
+ * which outlives this object until the last of them is freed, so memory handed out,
+ * e.g. a branch shared_ptr, stays valid after the tree is destroyed.
+ * In the arena mode the allocations are served by a CArenaResource, so
+ * deallocations are free and the whole arena is returned to the heap when
+ * this object is destroyed, with everything allocated from it. The owner sizes
+ * it with reserve() before filling its arrays. The arena itself is not
+ * thread-safe, concurrent users go through concurrent_resource() instead.
+ * Every byte requested from the heap is counted in both modes.
+*/
+class CTreeArena {
+public:
+    explicit CTreeArena(TreeAllocMode aMode) : m_mode(aMode), m_counting(CCountingResource::create()) {
+        if(m_mode == TreeAllocMode::Arena) {
+            m_arena_resource.reset(new CArenaResource(m_counting));
+            m_locked.reset(new CLockedResource(m_arena_resource.get()));
+        }
+    }
+    ~CTreeArena() {
+        // the arena returns its chunks through the counting resource first
+        m_locked.reset();
+        m_arena_resource.reset();
+        m_counting->release();
+    }
+    CTreeArena(const CTreeArena&)=delete;
+    CTreeArena& operator=(const CTreeArena&)=delete;
+public:
+    TreeAllocMode get_mode() const {
+        return m_mode;
+    }
+    /*
+     * Make room in the arena for aBytes of allocations to come, nothing in the default mode.
+    */
+    void reserve(size_t aBytes) {
+        if(m_arena_resource)
+            m_arena_resource->reserve(aBytes);
+    }
+    std::pmr::memory_resource* resource() {
+        if(m_arena_resource)
+            return m_arena_resource.get();
+        return m_counting;
+    }
+    /*
+     * The same memory as resource(), safe to use from several threads at once.
+    */
+    std::pmr::memory_resource* concurrent_resource() {
+        if(m_locked)
+            return m_locked.get();
+        return m_counting;
+    }
+    CTreeMemoryStats get_memory_stats() const {
+        return CTreeMemoryStats{m_counting->get_current_bytes(), m_counting->get_peak_bytes()};
+    }
+private:
+    TreeAllocMode m_mode;
+    CCountingResource* m_counting;                                  // counts the bytes taken from the heap, see release()
+    std::unique_ptr<CArenaResource> m_arena_resource;               // the arena, only in the arena mode
+    std::unique_ptr<CLockedResource> m_locked;                      // the arena behind a lock
+};
+
+#endif // CTREEARENA_H
@@ -0,0 +1,94 @@
+#include "ctreebatchloader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+CTreeBatchLoader::CTreeBatchLoader(size_t aMaxInFlight) :
+    m_max_in_flight(aMaxInFlight),
+    m_alloc_mode(TreeAllocMode::Default),
+    m_is_branch_cache_enabled(false)
+{
+
+}
+
+bool CTreeBatchLoader::load(const vector<string>& aFileNames, CWorkStealingPool& aPool,
+                            const ResultCallback& aCallback) {
+    const size_t num_files = aFileNames.size();
+    const size_t max_in_flight = m_max_in_flight > 0 ? m_max_in_flight : 2 * size_t(aPool.get_num_threads());
+    vector<CTreeBatchResult> results(num_files);
+    vector<char> are_done(num_files, 0);       // guarded by m_mutex
+    bool all_loaded(true);
+    size_t next_submit(0);
+    for(size_t next_result = 0; next_result < num_files; ++next_result) {
+        // keep the pool busy with the next files, as far as the bound allows
+        for(; next_submit < num_files && next_submit - next_result < max_in_flight; ++next_submit) {
+            const size_t i = next_submit;
+            results[i].m_file_name = aFileNames[i];
+            aPool.submit([this, &results, &are_done, i]() {
+                load_file(results[i]);
+                lock_guard<mutex> lock(m_mutex);
+                are_done[i] = 1;
+                m_result_ready.notify_all();
+            });
+        }
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_result_ready.wait(lock, [&are_done, next_result]() {
+                return are_done[next_result] != 0;
+            });
+        }
+        CTreeBatchResult& a_result = results[next_result];
+        all_loaded = all_loaded && a_result.m_tree_ptr != nullptr;
+        aCallback(a_result);
+        // free the slot for the next file
+        a_result.m_tree_ptr.reset();
+    }
+    return all_loaded;
+}
+
+void CTreeBatchLoader::load_file(CTreeBatchResult& aResult) {
+    using clock = chrono::steady_clock;
+    struct stat file_stat;
+    aResult.m_num_bytes = stat(aResult.m_file_name.c_str(), &file_stat) == 0 ? size_t(file_stat.st_size) : 0;
+    aResult.m_load_seconds = aResult.m_extract_seconds = 0.0;
+
+    shared_ptr<CDAGTree<float>> a_tree_ptr(new CDAGTree<float>(m_alloc_mode));
+    a_tree_ptr->set_branch_cache_enabled(m_is_branch_cache_enabled);
+    clock::time_point start = clock::now();
+    if(!a_tree_ptr->load_tree_file(aResult.m_file_name)) {
+        cerr << "ERROR: failed loading the tree file " << aResult.m_file_name << "\n";
+        return;
+    }
+    aResult.m_load_seconds = chrono::duration<double>(clock::now() - start).count();
+    start = clock::now();
+    a_tree_ptr->extract_branches();
+    aResult.m_extract_seconds = chrono::duration<double>(clock::now() - start).count();
+    aResult.m_tree_ptr = a_tree_ptr;
+}
+
+bool CTreeBatchLoader::list_tree_files(const string& aDirectory, vector<string>& aFileNames) {
+    DIR* a_dir = opendir(aDirectory.c_str());
+    if(a_dir == nullptr) {
+        cerr << "ERROR: failed read the directory " << aDirectory << "\n";
+        return false;
+    }
+    auto has_suffix = [](const string& aName, const string& aSuffix) {
+        return aName.size() > aSuffix.size() && aName.compare(aName.size() - aSuffix.size(), aSuffix.size(), aSuffix) == 0;
+    };
+    const string prefix = (aDirectory.empty() || aDirectory.back() == '/') ? aDirectory : aDirectory + "/";
+    vector<string> names;
+    while(const dirent* an_entry = readdir(a_dir)) {
+        const string a_name(an_entry->d_name);
+        if(has_suffix(a_name, ".tree") || has_suffix(a_name, ".treeb"))
+            names.push_back(prefix + a_name);
+    }
+    closedir(a_dir);
+    sort(names.begin(), names.end());
+    aFileNames.insert(aFileNames.end(), names.begin(), names.end());
+    return true;
+}
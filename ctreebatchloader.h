@@ -0,0 +1,82 @@
+#ifndef CTREEBATCHLOADER_H
+#define CTREEBATCHLOADER_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "cdagtree.h"
+#include "cworkstealingpool.h"
+
+/*
+ * One tree file of a batch, see CTreeBatchLoader.
+*/
+struct CTreeBatchResult {
+    std::string m_file_name;
+    std::shared_ptr<CDAGTree<float>> m_tree_ptr;    // the tree with its branches, null if it could not be loaded
+    size_t m_num_bytes;                             // the size of the file
+    double m_load_seconds;
+    double m_extract_seconds;
+};
+
+/*
+ * Load many tree files concurrently, e.g. all the trees of a plot.
+ * Every file is loaded and its branches extracted as one task on a work-stealing pool,
+ * with the sequential load_tree_file() and extract_branches(), so every tree is the same
+ * as when the files are loaded one after another; the files, not the lines of one file,
+ * are spread over the threads. At most a given number of files are in flight at a time,
+ * loading or loaded and not yet handed over, which bounds the memory of a batch.
+ * The trees are handed over on the calling thread in the order of the files.
+*/
+class CTreeBatchLoader
+{
+public:
+    typedef std::function<void(CTreeBatchResult&)> ResultCallback;
+public:
+    /*
+     * At most aMaxInFlight files are held at a time, at least one.
+     * Zero means twice the threads of the pool.
+    */
+    explicit CTreeBatchLoader(size_t aMaxInFlight = 0);
+    CTreeBatchLoader(const CTreeBatchLoader&)=delete;
+    CTreeBatchLoader& operator=(const CTreeBatchLoader&)=delete;
+public:
+    /*
+     * The allocation mode and branch cache setting of every loaded tree.
+    */
+    void set_alloc_mode(TreeAllocMode aAllocMode) {
+        m_alloc_mode = aAllocMode;
+    }
+    void set_branch_cache_enabled(bool aEnabled) {
+        m_is_branch_cache_enabled = aEnabled;
+    }
+    /*
+     * Load the files on aPool and pass each result to aCallback, in the order of the files.
+     * A tree is released once the callback returns unless the callback keeps m_tree_ptr.
+     * Must not be called from a task of aPool. Returns false if any file failed.
+    */
+    bool load(const std::vector<std::string>& aFileNames, CWorkStealingPool& aPool,
+              const ResultCallback& aCallback);
+    size_t get_max_in_flight() const {
+        return m_max_in_flight;
+    }
+
+    /*
+     * Append the .tree and .treeb files of a directory to aFileNames, sorted by name.
+     * Returns false if the directory can not be read.
+    */
+    static bool list_tree_files(const std::string& aDirectory, std::vector<std::string>& aFileNames);
+protected:
+    void load_file(CTreeBatchResult& aResult);
+private:
+    size_t m_max_in_flight;
+    TreeAllocMode m_alloc_mode;
+    bool m_is_branch_cache_enabled;
+    std::mutex m_mutex;
+    std::condition_variable m_result_ready;         // signalled when a file is done
+};
+
+#endif // CTREEBATCHLOADER_H
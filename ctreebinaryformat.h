@@ -0,0 +1,141 @@
+#ifndef CTREEBINARYFORMAT_H
+#define CTREEBINARYFORMAT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+
+/*
+ * The binary tree file format (.treeb), version 1.
+ * The file is a 128-byte header followed by fixed-width little-endian sections,
+ * each starting at a 64-byte aligned offset, in this order:
+ *  x, y, z, radius                 float32[num nodes] each
+ *  parent index                    int32[num nodes], -1 for the root
+ *  child offsets                   int32[num nodes + 1], CSR offsets into the child indices
+ *  child indices                   int32[num child indices]
+ * and, if TREEB_HAS_BRANCHES is set, the extracted branch table:
+ *  node branch levels              int32[num nodes]
+ *  branch set offsets              int32[num branch sets + 1], CSR offsets into the branches
+ *  branch levels                   int32[num branches]
+ *  branch node offsets             int32[num branches + 1], CSR offsets into the branch nodes
+ *  branch nodes                    int32[num branch nodes]
+ * and, if TREEB_HAS_ATTRIBUTES is set, the tag and order columns of the tree file:
+ *  node tags, node orders          int32[num nodes] each
+ * The sections hold the arrays of CDAGTree as they are in memory, so a reader maps
+ * the file and copies each section in one go without any parsing.
+*/
+
+static const char TREEB_MAGIC[8] = {'T', 'R', 'E', 'E', 'B', 'I', 'N', '\0'};
+static const uint32_t TREEB_VERSION = 1;
+static const uint32_t TREEB_HAS_BRANCHES = 1u;
+static const uint32_t TREEB_HAS_ATTRIBUTES = 2u;
+static const size_t TREEB_SECTION_ALIGNMENT = 64;
+
+struct CTreeBinaryHeader {
+    char m_magic[8];                // TREEB_MAGIC
+    uint32_t m_version;             // the schema version, TREEB_VERSION
+    uint32_t m_flags;               // TREEB_HAS_BRANCHES and TREEB_HAS_ATTRIBUTES for the optional sections
+    uint64_t m_num_nodes;
+    uint64_t m_num_child_indices;
+    uint64_t m_num_branch_sets;     // zero without the branch table
+    uint64_t m_num_branches;
+    uint64_t m_num_branch_nodes;
+    float m_bbox[6];                // x min, x max, y min, y max, z min, z max
+    uint8_t m_reserved[48];
+};
+static_assert(sizeof(CTreeBinaryHeader) == 128, "the .treeb header must be 128 bytes");
+
+/*
+ * The byte offsets of the sections of a .treeb file, derived from its header.
+*/
+struct CTreeBinaryLayout {
+    enum Section {
+        X, Y, Z, RADIUS, PARENT, CHILD_OFFSETS, CHILD_INDICES,
+        NODE_BRANCH_LEVELS, BRANCH_SET_OFFSETS, BRANCH_LEVELS, BRANCH_NODE_OFFSETS, BRANCH_NODES,
+        NODE_TAGS, NODE_ORDERS,
+        NUM_SECTIONS
+    };
+    uint64_t m_offsets[NUM_SECTIONS];
+    uint64_t m_sizes[NUM_SECTIONS];
+    uint64_t m_file_size;
+};
+
+inline uint64_t align_treeb_offset(uint64_t aOffset) {
+    return (aOffset + TREEB_SECTION_ALIGNMENT - 1) / TREEB_SECTION_ALIGNMENT * TREEB_SECTION_ALIGNMENT;
+}
+
+inline CTreeBinaryLayout compute_treeb_layout(const CTreeBinaryHeader& aHeader) {
+    CTreeBinaryLayout layout;
+    const uint64_t n = aHeader.m_num_nodes;
+    const bool has_branches = (aHeader.m_flags & TREEB_HAS_BRANCHES) != 0;
+    const bool has_attributes = (aHeader.m_flags & TREEB_HAS_ATTRIBUTES) != 0;
+    const uint64_t sizes[CTreeBinaryLayout::NUM_SECTIONS] = {
+        4*n, 4*n, 4*n, 4*n, 4*n, 4*(n + 1), 4*aHeader.m_num_child_indices,
+        has_branches ? 4*n : 0,
+        has_branches ? 4*(aHeader.m_num_branch_sets + 1) : 0,
+        4*aHeader.m_num_branches,
+        has_branches ? 4*(aHeader.m_num_branches + 1) : 0,
+        4*aHeader.m_num_branch_nodes,
+        has_attributes ? 4*n : 0,
+        has_attributes ? 4*n : 0
+    };
+    uint64_t offset = sizeof(CTreeBinaryHeader);
+    for(int i = 0; i < CTreeBinaryLayout::NUM_SECTIONS; ++i) {
+        // the empty sections take no space, so the file ends with the last data
+        if(sizes[i] > 0)
+            offset = align_treeb_offset(offset);
+        layout.m_offsets[i] = offset;
+        layout.m_sizes[i] = sizes[i];
+        offset += sizes[i];
+    }
+    layout.m_file_size = offset;
+    return layout;
+}
+
+/*
+ * Write a section at its offset, padding the stream from its current end.
+*/
+inline void write_treeb_section(std::ostream& aOutputs, uint64_t aOffset, const void* aData, uint64_t aSize) {
+    static const char padding[TREEB_SECTION_ALIGNMENT] = {};
+    aOutputs.write(padding, std::streamsize(aOffset - uint64_t(aOutputs.tellp())));
+    aOutputs.write(static_cast<const char*>(aData), std::streamsize(aSize));
+}
+
+/*
+ * Check that the CSR offsets start at 0, do not decrease and end at aTotal.
+*/
+inline bool is_valid_treeb_offsets(const int32_t* aOffsets, int aCount, int aTotal) {
+    if(aOffsets[0] != 0 || aOffsets[aCount] != aTotal)
+        return false;
+    for(int i = 0; i < aCount; ++i) {
+        if(aOffsets[i] > aOffsets[i+1])
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Check that the node indices are in [0, aNumNodes).
+*/
+inline bool is_valid_treeb_indices(const int32_t* aIndices, size_t aCount, int aNumNodes) {
+    for(size_t i = 0; i < aCount; ++i) {
+        if(aIndices[i] < 0 || aIndices[i] >= aNumNodes)
+            return false;
+    }
+    return true;
+}
+
+inline bool is_treeb_data(const char* aData, size_t aSize) {
+    return aSize >= sizeof(CTreeBinaryHeader) && std::memcmp(aData, TREEB_MAGIC, sizeof(TREEB_MAGIC)) == 0;
+}
+
+// the sections are stored in the host byte order, which must be little-endian
+inline bool is_little_endian_host() {
+    const uint32_t one(1);
+    uint8_t first_byte(0);
+    std::memcpy(&first_byte, &one, 1);
+    return first_byte == 1;
+}
+
+#endif // CTREEBINARYFORMAT_H
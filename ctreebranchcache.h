@@ -0,0 +1,99 @@
+#ifndef CTREEBRANCHCACHE_H
+#define CTREEBRANCHCACHE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "ctreebinaryformat.h"
+
+/*
+ * The branch cache file, stored next to a tree file as <tree file>.branches.
+ * It holds the result of the branch extraction of the tree file, keyed by the hash
+ * of the tree file content and the hash of the extraction parameters, so that it
+ * is only reused for the same tree extracted in the same way.
+ * The file is a 128-byte header followed by the branch table sections of the
+ * .treeb format (see ctreebinaryformat.h), each starting at a 64-byte aligned offset:
+ *  node branch levels              int32[num nodes]
+ *  branch set offsets              int32[num branch sets + 1]
+ *  branch levels                   int32[num branches]
+ *  branch node offsets             int32[num branches + 1]
+ *  branch nodes                    int32[num branch nodes]
+*/
+
+static const char TREEBC_MAGIC[8] = {'T', 'R', 'E', 'E', 'B', 'R', 'C', '\0'};
+static const uint32_t TREEBC_VERSION = 1;
+static const char* const TREEBC_FILE_SUFFIX = ".branches";
+// the version of the branch extraction, bump it whenever the extracted branches change
+static const int32_t TREE_BRANCH_EXTRACT_VERSION = 1;
+
+struct CTreeBranchCacheHeader {
+    char m_magic[8];                // TREEBC_MAGIC
+    uint32_t m_version;             // the schema version, TREEBC_VERSION
+    uint32_t m_reserved0;
+    uint64_t m_source_hash;         // the hash of the content of the tree file
+    uint64_t m_source_size;         // the size of the tree file in bytes
+    uint64_t m_params_hash;         // the hash of the extraction parameters
+    uint64_t m_num_nodes;
+    uint64_t m_num_branch_sets;
+    uint64_t m_num_branches;
+    uint64_t m_num_branch_nodes;
+    uint8_t m_reserved[56];
+};
+static_assert(sizeof(CTreeBranchCacheHeader) == 128, "the branch cache header must be 128 bytes");
+
+/*
+ * The byte offsets of the sections of a branch cache file, derived from its header.
+*/
+struct CTreeBranchCacheLayout {
+    enum Section {
+        NODE_BRANCH_LEVELS, BRANCH_SET_OFFSETS, BRANCH_LEVELS, BRANCH_NODE_OFFSETS, BRANCH_NODES,
+        NUM_SECTIONS
+    };
+    uint64_t m_offsets[NUM_SECTIONS];
+    uint64_t m_sizes[NUM_SECTIONS];
+    uint64_t m_file_size;
+};
+
+inline CTreeBranchCacheLayout compute_branch_cache_layout(const CTreeBranchCacheHeader& aHeader) {
+    CTreeBranchCacheLayout layout;
+    const uint64_t sizes[CTreeBranchCacheLayout::NUM_SECTIONS] = {
+        4*aHeader.m_num_nodes,
+        4*(aHeader.m_num_branch_sets + 1),
+        4*aHeader.m_num_branches,
+        4*(aHeader.m_num_branches + 1),
+        4*aHeader.m_num_branch_nodes
+    };
+    uint64_t offset = sizeof(CTreeBranchCacheHeader);
+    for(int i = 0; i < CTreeBranchCacheLayout::NUM_SECTIONS; ++i) {
+        offset = align_treeb_offset(offset);
+        layout.m_offsets[i] = offset;
+        layout.m_sizes[i] = sizes[i];
+        offset += sizes[i];
+    }
+    layout.m_file_size = offset;
+    return layout;
+}
+
+/*
+ * The 64-bit FNV-1a hash of a block of bytes, taken a word at a time.
+ * Chain blocks by passing the hash of the previous block as aSeed.
+*/
+static const uint64_t TREE_HASH_SEED = 14695981039346656037ull;
+
+inline uint64_t hash_tree_bytes(const void* aData, size_t aSize, uint64_t aSeed = TREE_HASH_SEED) {
+    const uint64_t prime = 1099511628211ull;
+    const unsigned char* p = static_cast<const unsigned char*>(aData);
+    uint64_t hash = aSeed;
+    size_t i(0);
+    for(; i + 8 <= aSize; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, p + i, 8);
+        hash = (hash ^ word) * prime;
+    }
+    for(; i < aSize; ++i)
+        hash = (hash ^ p[i]) * prime;
+    return hash;
+}
+
+#endif // CTREEBRANCHCACHE_H
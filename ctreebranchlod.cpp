@@ -0,0 +1,348 @@
+#include "ctreebranchlod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+using namespace std;
+
+typedef Eigen::Vector3f Vector3f;
+
+// the tolerance of level 1 relative to the diagonal of the tree's bounding box
+static const float LOD_FIRST_TOLERANCE_SCALE = 1.f / 65536.f;
+
+/*
+ * The distance of aPoint from the segment between aBegin and aEnd.
+*/
+static float distance_to_segment(const Vector3f& aPoint, const Vector3f& aBegin, const Vector3f& aEnd) {
+    const Vector3f segment = aEnd - aBegin;
+    const float length2 = segment.squaredNorm();
+    float t = length2 > 0.f ? (aPoint - aBegin).dot(segment) / length2 : 0.f;
+    t = min(max(t, 0.f), 1.f);
+    return (aPoint - (aBegin + t * segment)).norm();
+}
+
+/*
+ * Write the Douglas-Peucker error of every node of a branch to aErrors,
+ * infinite for the end nodes.
+*/
+static void compute_simplification_errors(const CDAGTree<float>& aTree, const pmr::vector<int>& aNodes,
+                                          float* aErrors) {
+    const size_t num_nodes = aNodes.size();
+    const float infinite_error = numeric_limits<float>::infinity();
+    for(size_t i = 0; i < num_nodes; ++i)
+        aErrors[i] = infinite_error;
+    if(num_nodes < 3)
+        return;
+    // the segments still to be split, each with the error of the node that made it
+    struct CSpan {
+        size_t m_begin;
+        size_t m_end;
+        float m_error;
+    };
+    vector<CSpan> spans;
+    spans.push_back({0, num_nodes - 1, infinite_error});
+    while(!spans.empty()) {
+        CSpan a_span = spans.back();
+        spans.pop_back();
+        if(a_span.m_end - a_span.m_begin < 2)
+            continue;
+        const Vector3f begin = aTree.get_node_position(aNodes[a_span.m_begin]);
+        const Vector3f end = aTree.get_node_position(aNodes[a_span.m_end]);
+        size_t split(a_span.m_begin + 1);
+        float max_distance(-1.f);
+        for(size_t i = a_span.m_begin + 1; i < a_span.m_end; ++i) {
+            float distance = distance_to_segment(aTree.get_node_position(aNodes[i]), begin, end);
+            if(distance > max_distance) {
+                max_distance = distance;
+                split = i;
+            }
+        }
+        // a node is never kept longer than the node that split its segment
+        const float error = min(max_distance, a_span.m_error);
+        aErrors[split] = error;
+        spans.push_back({a_span.m_begin, split, error});
+        spans.push_back({split, a_span.m_end, error});
+    }
+}
+
+CTreeBranchLOD::CTreeBranchLOD()
+{
+
+}
+
+CTreeBranchLOD::~CTreeBranchLOD() {
+    clear();
+}
+
+void CTreeBranchLOD::clear() {
+    m_element_indices.clear();
+    m_strip_firsts.clear();
+    m_strip_counts.clear();
+    m_tolerances.clear();
+    m_boxes.clear();
+    m_subtree_boxes.clear();
+    m_subtree_ends.clear();
+    m_radii.clear();
+    m_subtree_radii.clear();
+    m_branch_levels.clear();
+}
+
+void CTreeBranchLOD::swap(CTreeBranchLOD& aOther) {
+    m_element_indices.swap(aOther.m_element_indices);
+    m_strip_firsts.swap(aOther.m_strip_firsts);
+    m_strip_counts.swap(aOther.m_strip_counts);
+    m_tolerances.swap(aOther.m_tolerances);
+    m_boxes.swap(aOther.m_boxes);
+    m_subtree_boxes.swap(aOther.m_subtree_boxes);
+    m_subtree_ends.swap(aOther.m_subtree_ends);
+    m_radii.swap(aOther.m_radii);
+    m_subtree_radii.swap(aOther.m_subtree_radii);
+    m_branch_levels.swap(aOther.m_branch_levels);
+}
+
+Eigen::Vector3f CTreeBranchLOD::get_branch_center(size_t aBranch) const {
+    const float* box = m_boxes.data() + 6*aBranch;
+    return Vector3f(0.5f*(box[0] + box[3]), 0.5f*(box[1] + box[4]), 0.5f*(box[2] + box[5]));
+}
+
+size_t CTreeBranchLOD::get_num_level_elements(size_t aLevel) const {
+    const size_t num_branches = get_num_branches();
+    size_t num_elements(0);
+    for(size_t b = 0; b < num_branches; ++b)
+        num_elements += size_t(m_strip_counts[aLevel*num_branches + b]);
+    return num_elements;
+}
+
+void CTreeBranchLOD::build(const CDAGTree<float>& aTree, int aMaxLevels) {
+    clear();
+    vector<const pmr::vector<int>*> extracted_branches;
+    vector<int> extracted_levels;
+    for(const auto& bs : aTree.get_branches()) {
+        for(const auto& b : bs.get_branch_array()) {
+            extracted_branches.push_back(&b->get_branch_nodes());
+            extracted_levels.push_back(b->get_branch_level());
+        }
+    }
+    const size_t num_branches = extracted_branches.size();
+    if(num_branches == 0)
+        return;
+
+    // a branch starts at a node of the branch it grows from, which owns that node past its first one
+    const size_t num_nodes = aTree.get_total_num_of_nodes();
+    vector<int> node_branches(num_nodes, -1);
+    for(size_t b = 0; b < num_branches; ++b) {
+        const pmr::vector<int>& nodes = *extracted_branches[b];
+        for(size_t i = 1; i < nodes.size(); ++i)
+            node_branches[size_t(nodes[i])] = int(b);
+    }
+    // the child branches of every branch, and the branches growing from no other one
+    vector<int> parent_branches(num_branches, -1);
+    vector<size_t> child_offsets(num_branches + 1, 0);
+    for(size_t b = 0; b < num_branches; ++b) {
+        const pmr::vector<int>& nodes = *extracted_branches[b];
+        if(!nodes.empty() && node_branches[size_t(nodes[0])] >= 0) {
+            parent_branches[b] = node_branches[size_t(nodes[0])];
+            ++child_offsets[size_t(parent_branches[b]) + 1];
+        }
+    }
+    for(size_t b = 0; b < num_branches; ++b)
+        child_offsets[b+1] += child_offsets[b];
+    vector<int> child_branches(child_offsets[num_branches]);
+    vector<size_t> child_fill(child_offsets.begin(), child_offsets.end() - 1);
+    for(size_t b = 0; b < num_branches; ++b) {
+        if(parent_branches[b] >= 0)
+            child_branches[child_fill[size_t(parent_branches[b])]++] = int(b);
+    }
+
+    // order the branches depth first, so that every subtree of branches is a contiguous range
+    vector<int> branch_order;
+    branch_order.reserve(num_branches);
+    vector<int> new_indices(num_branches, -1);
+    m_subtree_ends.resize(num_branches);
+    vector<pair<int, size_t>> stack;    // a branch and its next child to visit
+    for(size_t r = 0; r < num_branches; ++r) {
+        if(parent_branches[r] >= 0)
+            continue;
+        stack.push_back({int(r), child_offsets[r]});
+        new_indices[r] = int(branch_order.size());
+        branch_order.push_back(int(r));
+        while(!stack.empty()) {
+            const size_t b = size_t(stack.back().first);
+            size_t& next_child = stack.back().second;
+            if(next_child < child_offsets[b+1]) {
+                const int child = child_branches[next_child++];
+                new_indices[size_t(child)] = int(branch_order.size());
+                branch_order.push_back(child);
+                stack.push_back({child, child_offsets[size_t(child)]});
+            } else {
+                m_subtree_ends[size_t(new_indices[b])] = uint32_t(branch_order.size());
+                stack.pop_back();
+            }
+        }
+    }
+    vector<const pmr::vector<int>*> branches(num_branches);
+    m_branch_levels.resize(num_branches);
+    for(size_t b = 0; b < num_branches; ++b) {
+        branches[b] = extracted_branches[size_t(branch_order[b])];
+        m_branch_levels[b] = extracted_levels[size_t(branch_order[b])];
+    }
+
+    // the box of every branch, then the boxes of the subtrees merged from the last branch backwards
+    m_boxes.resize(6*num_branches);
+    for(size_t b = 0; b < num_branches; ++b) {
+        Vector3f box_min = Vector3f::Constant(numeric_limits<float>::max());
+        Vector3f box_max = Vector3f::Constant(numeric_limits<float>::lowest());
+        for(int n : *branches[b]) {
+            box_min = box_min.cwiseMin(aTree.get_node_position(n));
+            box_max = box_max.cwiseMax(aTree.get_node_position(n));
+        }
+        if(branches[b]->empty())
+            box_min = box_max = Vector3f::Zero();
+        for(int i = 0; i < 3; ++i) {
+            m_boxes[6*b+i] = box_min[i];
+            m_boxes[6*b+3+i] = box_max[i];
+        }
+    }
+    m_subtree_boxes = m_boxes;
+    for(size_t b = num_branches; b-- > 0; ) {
+        const int parent = parent_branches[size_t(branch_order[b])];
+        if(parent < 0)
+            continue;
+        float* parent_box = m_subtree_boxes.data() + 6*size_t(new_indices[size_t(parent)]);
+        const float* child_box = m_subtree_boxes.data() + 6*b;
+        for(int i = 0; i < 3; ++i) {
+            parent_box[i] = min(parent_box[i], child_box[i]);
+            parent_box[3+i] = max(parent_box[3+i], child_box[3+i]);
+        }
+    }
+
+    // the errors of the nodes of all the branches, and the bounding spheres of every branch
+    vector<size_t> error_offsets(num_branches + 1, 0);
+    for(size_t b = 0; b < num_branches; ++b)
+        error_offsets[b+1] = error_offsets[b] + branches[b]->size();
+    vector<float> errors(error_offsets[num_branches]);
+    m_radii.resize(num_branches);
+    m_subtree_radii.resize(num_branches);
+    for(size_t b = 0; b < num_branches; ++b) {
+        const pmr::vector<int>& nodes = *branches[b];
+        compute_simplification_errors(aTree, nodes, errors.data() + error_offsets[b]);
+        const Vector3f center = get_branch_center(b);
+        float radius(0.f);
+        for(int n : nodes)
+            radius = max(radius, (aTree.get_node_position(n) - center).norm());
+        m_radii[b] = radius;
+        // the sphere around the branch centre holding the boxes of its subtree
+        const Vector3f subtree_min = Eigen::Map<const Vector3f>(m_subtree_boxes.data() + 6*b);
+        const Vector3f subtree_max = Eigen::Map<const Vector3f>(m_subtree_boxes.data() + 6*b + 3);
+        m_subtree_radii[b] = max((subtree_min - center).cwiseAbs().cwiseMax((subtree_max - center).cwiseAbs()).norm(),
+                                 radius);
+    }
+
+    CBBox<float> tree_box;
+    aTree.compute_bounding_box(tree_box);
+    const float diagonal = Vector3f(tree_box.m_x_max - tree_box.m_x_min,
+                                    tree_box.m_y_max - tree_box.m_y_min,
+                                    tree_box.m_z_max - tree_box.m_z_min).norm();
+    float tolerance(0.f);
+    for(int k = 0; k < max(aMaxLevels, 1); ++k) {
+        m_tolerances.push_back(tolerance);
+        bool is_coarsest(true);
+        for(size_t b = 0; b < num_branches; ++b) {
+            const pmr::vector<int>& nodes = *branches[b];
+            const float* node_errors = errors.data() + error_offsets[b];
+            int count(0);
+            for(size_t i = 0; i < nodes.size(); ++i)
+                count += node_errors[i] > tolerance ? 1 : 0;
+            is_coarsest = is_coarsest && count <= 2;
+            // the nodes of a level are a subset of the ones of the previous level,
+            // so the strip of the previous level is reused if no node is dropped
+            if(k > 0 && count == m_strip_counts[(size_t(k) - 1)*num_branches + b]) {
+                m_strip_firsts.push_back(m_strip_firsts[(size_t(k) - 1)*num_branches + b]);
+                m_strip_counts.push_back(count);
+                continue;
+            }
+            m_strip_firsts.push_back(uint32_t(m_element_indices.size()));
+            m_strip_counts.push_back(count);
+            for(size_t i = 0; i < nodes.size(); ++i) {
+                if(node_errors[i] > tolerance)
+                    m_element_indices.push_back(uint32_t(nodes[i]));
+            }
+        }
+        // no level beyond the one where every branch is a single segment
+        if(is_coarsest || diagonal <= 0.f)
+            break;
+        tolerance = (k == 0) ? diagonal * LOD_FIRST_TOLERANCE_SCALE : 2.f * tolerance;
+    }
+}
+
+size_t CTreeBranchLOD::select(const Eigen::Vector3f& aEye, float aPixelScale, float aMaxPixelError, int aMaxBranchLevel,
+                              const CFrustum* aFrustum, vector<uint32_t>& aFirsts, vector<int>& aCounts,
+                              size_t* aNumCulled) const {
+    const size_t num_branches = get_num_branches();
+    const size_t num_levels = get_num_levels();
+    size_t num_culled(0);
+    size_t num_elements(0);
+    const float first_tolerance = num_levels > 1 ? m_tolerances[1] : 0.f;
+    // the world size of aMaxPixelError pixels at unit distance
+    const float error_per_distance = aMaxPixelError / max(aPixelScale, numeric_limits<float>::min());
+    // the branches before this one are inside the frustum, so are their subtrees
+    size_t inside_end(0);
+    size_t b(0);
+    while(num_levels > 0 && b < num_branches) {
+        // the branches growing from a branch are one level higher
+        if(aMaxBranchLevel > 0 && m_branch_levels[b] > aMaxBranchLevel) {
+            b = m_subtree_ends[b];
+            continue;
+        }
+        const Vector3f center = get_branch_center(b);
+        const float center_distance = (center - aEye).norm();
+        // the branch and all the branches growing from it are within the error
+        if(center_distance > m_subtree_radii[b]
+                && 2.f * m_subtree_radii[b] <= error_per_distance * (center_distance - m_subtree_radii[b])) {
+            b = m_subtree_ends[b];
+            continue;
+        }
+        if(aFrustum && b >= inside_end) {
+            const float* subtree_box = m_subtree_boxes.data() + 6*b;
+            CFrustum::Containment containment =
+                    aFrustum->classify_box(Eigen::Map<const Vector3f>(subtree_box),
+                                           Eigen::Map<const Vector3f>(subtree_box + 3));
+            if(containment == CFrustum::Outside) {
+                num_culled += m_subtree_ends[b] - b;
+                b = m_subtree_ends[b];
+                continue;
+            }
+            if(containment == CFrustum::Inside) {
+                inside_end = m_subtree_ends[b];
+            } else {
+                // the subtree is partly visible, the branch itself may not be
+                const float* box = m_boxes.data() + 6*b;
+                if(aFrustum->classify_box(Eigen::Map<const Vector3f>(box),
+                                          Eigen::Map<const Vector3f>(box + 3)) == CFrustum::Outside) {
+                    ++num_culled;
+                    ++b;
+                    continue;
+                }
+            }
+        }
+        const float distance = center_distance - m_radii[b];
+        size_t level(0);
+        if(distance > 0.f) {
+            const float allowed_error = error_per_distance * distance;
+            if(first_tolerance > 0.f && allowed_error >= first_tolerance) {
+                // the tolerances double from level 1
+                level = 1 + size_t(log2f(allowed_error / first_tolerance));
+                level = min(level, num_levels - 1);
+            }
+        }
+        const size_t strip = level*num_branches + b;
+        aFirsts.push_back(m_strip_firsts[strip]);
+        aCounts.push_back(m_strip_counts[strip]);
+        num_elements += size_t(m_strip_counts[strip]);
+        ++b;
+    }
+    if(aNumCulled)
+        *aNumCulled = num_culled;
+    return num_elements;
+}
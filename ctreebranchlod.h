@@ -0,0 +1,103 @@
+#ifndef CTREEBRANCHLOD_H
+#define CTREEBRANCHLOD_H
+
+#include <cstdint>
+#include <vector>
+#include "cdagtree.h"
+#include "cfrustum.h"
+
+/*
+ * The levels of detail of the branch polylines of a tree, built on the CPU without OpenGL.
+ * Every interior node of a branch gets the error of the Douglas-Peucker simplification
+ * at which it is dropped: the distance from the segment it splits, clamped to the error
+ * of the node that split the enclosing segment. Keeping the nodes whose error exceeds
+ * a tolerance then gives the Douglas-Peucker polyline of that tolerance, which is
+ * within the tolerance of the branch.
+ * From the errors a ladder of discrete levels is stored, level 0 holding every node
+ * and level k > 0 the nodes above a tolerance doubling with k, until all the branches
+ * are down to their end nodes. Every level is a line strip per branch, indexing the
+ * vertex of every node at its node index (as CTreeSkeletonArrays does); a strip that
+ * loses no node from one level to the next is stored once and shared.
+ * The branches are kept depth first along the hierarchy of the branches growing from
+ * one another, each with its bounding box and the box of its subtree, so that a subtree
+ * is a contiguous range of branches and can be skipped at once.
+ * Per frame, select() culls the subtrees outside the view frustum and picks a level for
+ * every remaining branch from its projected size.
+*/
+class CTreeBranchLOD
+{
+public:
+    CTreeBranchLOD();
+    ~CTreeBranchLOD();
+public:
+    /*
+     * Build the levels of the extracted branches of the tree, replacing the content.
+     * At most aMaxLevels levels are stored.
+    */
+    void build(const CDAGTree<float>& aTree, int aMaxLevels = 16);
+    void clear();
+    // exchange the levels with aOther without copying them
+    void swap(CTreeBranchLOD& aOther);
+
+    /*
+     * Choose the coarsest level of every branch whose tolerance is within aMaxPixelError
+     * pixels at the distance of the branch from aEye, and append the first element and
+     * the element count of its strip to aFirsts and aCounts.
+     * aPixelScale converts a size at unit distance to pixels, i.e. the viewport height
+     * divided by 2*tan(fovy/2). A branch is left out if it would cover no more than
+     * aMaxPixelError pixels together with all the branches growing from it; a pixel error
+     * of 0 chooses the full branches. If aMaxBranchLevel is above 0, the branches of
+     * higher branch levels are left out too.
+     * If aFrustum is given, the branches outside it are left out and their number is written
+     * to aNumCulled. Returns the number of elements chosen.
+    */
+    size_t select(const Eigen::Vector3f& aEye, float aPixelScale, float aMaxPixelError, int aMaxBranchLevel,
+                  const CFrustum* aFrustum, std::vector<uint32_t>& aFirsts, std::vector<int>& aCounts,
+                  size_t* aNumCulled = nullptr) const;
+
+    const std::vector<uint32_t>& get_element_indices() const {
+        return m_element_indices;
+    }
+    size_t get_num_branches() const {
+        return m_branch_levels.size();
+    }
+    size_t get_num_levels() const {
+        return m_tolerances.size();
+    }
+    // the world space tolerance of a level, 0 for the full level
+    float get_tolerance(size_t aLevel) const {
+        return m_tolerances[aLevel];
+    }
+    // the number of elements of all the strips of a level
+    size_t get_num_level_elements(size_t aLevel) const;
+    /*
+     * The bounding box of a branch, and of the branch together with all the branches
+     * growing from it, as x, y, z of the minimum then of the maximum.
+     * The branches are in depth first order, see get_subtree_end().
+    */
+    const float* get_branch_box(size_t aBranch) const {
+        return m_boxes.data() + 6*aBranch;
+    }
+    const float* get_subtree_box(size_t aBranch) const {
+        return m_subtree_boxes.data() + 6*aBranch;
+    }
+    // one past the last branch growing directly or indirectly from aBranch
+    size_t get_subtree_end(size_t aBranch) const {
+        return m_subtree_ends[aBranch];
+    }
+protected:
+    Eigen::Vector3f get_branch_center(size_t aBranch) const;
+private:
+    std::vector<uint32_t> m_element_indices;    // the distinct strips of all the levels
+    std::vector<uint32_t> m_strip_firsts;       // the first element of branch b at level k, at k*branches+b
+    std::vector<int> m_strip_counts;            // the element count of branch b at level k, at k*branches+b
+    std::vector<float> m_tolerances;            // the tolerance of every level
+    std::vector<float> m_boxes;                 // the bounding box of every branch, min x, y, z, max x, y, z
+    std::vector<float> m_subtree_boxes;         // the bounding box of every branch with its subtree
+    std::vector<uint32_t> m_subtree_ends;       // one past the last branch of the subtree of every branch
+    std::vector<float> m_radii;                 // the bounding sphere of every branch around its box centre
+    std::vector<float> m_subtree_radii;         // the sphere around the centre holding the branches growing from it too
+    std::vector<int> m_branch_levels;           // the branch level of every branch
+};
+
+#endif // CTREEBRANCHLOD_H
@@ -0,0 +1,204 @@
+#ifndef CTREEFILEREADER_H
+#define CTREEFILEREADER_H
+
+#include <string>
+#include <sstream>
+#include <istream>
+#include <charconv>
+#include <cstring>
+
+/*
+ * The values stored on one line of a tree file:
+ * the 3d position, the radius, the number of child nodes and two integer attributes.
+*/
+template<typename T>
+struct CTreeRecord {
+    T m_x;
+    T m_y;
+    T m_z;
+    T m_radius;
+    int m_num_children;
+    int m_tag;              // the 6th column, 0 to 15 on the leaf nodes and 0 on the others in the TestData trees
+    int m_order;            // the 7th column, the order of a node, 0 on the leaf nodes in the TestData trees
+};
+
+/*
+ * A column of a tree file line, stored in the member aMember of the record type R.
+*/
+template<typename R, typename V, V R::*aMember>
+struct CTreeColumn {
+    typedef V value_type;
+    static V& field(R& aRecord) {
+        return aRecord.*aMember;
+    }
+};
+
+/*
+ * The columns of a tree file line, in order.
+ * The readers parse a line with one expression expanded from the column list at compile time,
+ * so the parse loop has no per-field dispatch.
+*/
+template<typename... Columns>
+struct CTreeSchema {
+    static const int num_columns = int(sizeof...(Columns));
+
+    /*
+     * Parse the columns into aRecord one after another with aParseField(field),
+     * stopping at the first one it fails on. Returns the number of columns parsed.
+    */
+    template<typename R, typename ParseField>
+    static int parse(R& aRecord, ParseField&& aParseField) {
+        int num_parsed(0);
+        ((aParseField(Columns::field(aRecord)) && ++num_parsed) && ...);
+        return num_parsed;
+    }
+};
+
+/*
+ * The seven columns of the tree files.
+*/
+template<typename T>
+using CTreeFileSchema = CTreeSchema<
+    CTreeColumn<CTreeRecord<T>, T, &CTreeRecord<T>::m_x>,
+    CTreeColumn<CTreeRecord<T>, T, &CTreeRecord<T>::m_y>,
+    CTreeColumn<CTreeRecord<T>, T, &CTreeRecord<T>::m_z>,
+    CTreeColumn<CTreeRecord<T>, T, &CTreeRecord<T>::m_radius>,
+    CTreeColumn<CTreeRecord<T>, int, &CTreeRecord<T>::m_num_children>,
+    CTreeColumn<CTreeRecord<T>, int, &CTreeRecord<T>::m_tag>,
+    CTreeColumn<CTreeRecord<T>, int, &CTreeRecord<T>::m_order>>;
+
+/*
+ * Count the line ends from the current position of an input stream to its end,
+ * reading it block by block. The stream is left at its end.
+*/
+inline size_t count_stream_lines(std::istream& aInputs) {
+    char a_block[1 << 16];
+    size_t num_lines(0);
+    while(aInputs) {
+        aInputs.read(a_block, sizeof(a_block));
+        const char* p = a_block;
+        const char* end = a_block + aInputs.gcount();
+        while((p = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)))) != nullptr) {
+            ++num_lines;
+            ++p;
+        }
+    }
+    return num_lines;
+}
+
+/*
+ * Read tree records line by line from an input stream.
+ * Every line is copied into a string and parsed through a string stream.
+*/
+template<typename T, typename Schema = CTreeFileSchema<T>>
+class CTreeStreamReader {
+public:
+    explicit CTreeStreamReader(std::istream& aInputs) : m_inputs(aInputs), m_num_columns(0) {}
+public:
+    bool eof() const {
+        return m_inputs.eof();
+    }
+    // the number of columns parsed from the last line
+    int get_num_columns_read() const {
+        return m_num_columns;
+    }
+    /*
+     * Read the next line into aRecord.
+     * Returns false if the line is empty, in which case aRecord is zeroed.
+    */
+    bool read_record(CTreeRecord<T>& aRecord) {
+        std::string str_line;
+        std::getline(m_inputs, str_line, '\n');
+        std::stringstream ss(str_line);
+        aRecord = CTreeRecord<T>();
+        m_num_columns = Schema::parse(aRecord, [&ss](auto& aValue) {
+            return bool(ss >> aValue);
+        });
+        return !str_line.empty();
+    }
+private:
+    std::istream& m_inputs;
+    int m_num_columns;
+};
+
+/*
+ * Read tree records in place from a memory block, e.g. a memory mapped file.
+ * The numbers are parsed with std::from_chars, so no string or stream
+ * is created per line. Both '\n' and "\r\n" line endings are accepted.
+*/
+template<typename T, typename Schema = CTreeFileSchema<T>>
+class CTreeMappedReader {
+public:
+    CTreeMappedReader(const char* aBegin, const char* aEnd) :
+        m_cursor(aBegin), m_end(aEnd), m_num_columns(0), m_is_eof(false) {}
+public:
+    /*
+     * As std::getline of the stream reader sets eof: once a line is read up to the end of
+     * the block without a line end, or a read is tried at the end of the block. A last line
+     * ending with '\n' does not set it.
+    */
+    bool eof() const {
+        return m_is_eof;
+    }
+    // all the lines of the block are read
+    bool at_end() const {
+        return m_cursor >= m_end;
+    }
+    // the number of columns parsed from the last line
+    int get_num_columns_read() const {
+        return m_num_columns;
+    }
+    const char* cursor() const {
+        return m_cursor;
+    }
+    /*
+     * Read the next line into aRecord.
+     * Returns false if the line is empty, in which case aRecord is zeroed.
+     * As with the stream reader, the fields after a malformed one are left zero.
+    */
+    bool read_record(CTreeRecord<T>& aRecord) {
+        aRecord = CTreeRecord<T>();
+        m_num_columns = 0;
+        // the block may be empty, with no memory behind it
+        if(m_cursor >= m_end) {
+            m_is_eof = true;
+            return false;
+        }
+        const char* line_end = static_cast<const char*>(
+                    std::memchr(m_cursor, '\n', size_t(m_end - m_cursor)));
+        if(line_end == nullptr) {
+            line_end = m_end;
+            m_is_eof = true;
+        }
+        const char* p = m_cursor;
+        bool is_empty = (p == line_end) || (*p == '\r' && p+1 == line_end);
+        if(!is_empty) {
+            m_num_columns = Schema::parse(aRecord, [&p, line_end](auto& aValue) {
+                return parse_field(p, line_end, aValue);
+            });
+        }
+        // move to the beginning of the next line
+        m_cursor = (line_end == m_end) ? m_end : line_end + 1;
+        return !is_empty;
+    }
+private:
+    template<typename V>
+    static bool parse_field(const char*& p, const char* aLineEnd, V& aValue) {
+        while(p < aLineEnd && (*p == ' ' || *p == '\t'))
+            ++p;
+        std::from_chars_result result = std::from_chars(p, aLineEnd, aValue);
+        if(result.ec != std::errc()) {
+            aValue = V();
+            return false;
+        }
+        p = result.ptr;
+        return true;
+    }
+private:
+    const char* m_cursor;   // the beginning of the next unread line
+    const char* m_end;      // one past the last byte of the block
+    int m_num_columns;      // the number of columns parsed from the last line
+    bool m_is_eof;          // see eof()
+};
+
+#endif // CTREEFILEREADER_H
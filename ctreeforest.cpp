@@ -0,0 +1,245 @@
+#include "ctreeforest.h"
+#include "GL/glew.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+using namespace std;
+
+/*
+ * The layout of the commands of glMultiDrawElementsIndirect.
+*/
+struct CDrawElementsCommand {
+    uint32_t m_count;
+    uint32_t m_instance_count;
+    uint32_t m_first_index;
+    int32_t m_base_vertex;
+    uint32_t m_base_instance;
+};
+
+CTreeForest::CTreeForest() :
+    m_vao(0),
+    m_vbo(0),
+    m_ebo(0),
+    m_instance_vbo(0),
+    m_indirect_buffer(0),
+    m_num_commands(0),
+    m_is_branch_cache_enabled(false)
+{
+
+}
+
+CTreeForest::~CTreeForest() {
+    delete_buffers();
+}
+
+void CTreeForest::delete_buffers() {
+    if(m_vao == 0)
+        return;
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteBuffers(1, &m_ebo);
+    glDeleteBuffers(1, &m_instance_vbo);
+    glDeleteBuffers(1, &m_indirect_buffer);
+    glDeleteVertexArrays(1, &m_vao);
+    m_vao = m_vbo = m_ebo = m_instance_vbo = m_indirect_buffer = 0;
+    m_num_commands = 0;
+}
+
+bool CTreeForest::read_forest_file(const string& aFileName) {
+    ifstream inputs(aFileName);
+    if(!inputs) {
+        cerr << "ERROR: failed open the forest file " << aFileName << "\n";
+        return false;
+    }
+    const size_t slash = aFileName.find_last_of('/');
+    const string directory = (slash == string::npos) ? string() : aFileName.substr(0, slash + 1);
+    map<string, int> tree_indices;
+    string line;
+    int line_number(0);
+    while(getline(inputs, line)) {
+        ++line_number;
+        istringstream fields(line);
+        string tree_file;
+        if(!(fields >> tree_file) || tree_file[0] == '#')
+            continue;
+        float x, y, z, yaw(0.f), scale(1.f);
+        if(!(fields >> x >> y >> z)) {
+            cerr << "ERROR: no position at line " << line_number << " of the forest file " << aFileName << "\n";
+            return false;
+        }
+        if(fields >> yaw)
+            fields >> scale;
+        if(tree_file[0] != '/')
+            tree_file = directory + tree_file;
+
+        map<string, int>::const_iterator found = tree_indices.find(tree_file);
+        if(found == tree_indices.end()) {
+            CDAGTree<float> a_tree;
+            a_tree.set_branch_cache_enabled(m_is_branch_cache_enabled);
+            if(!a_tree.load_tree_file(tree_file)) {
+                cerr << "ERROR: failed read the tree file " << tree_file << " of the forest\n";
+                return false;
+            }
+            a_tree.extract_branches();
+            CTreeSkeletonArrays arrays;
+            arrays.build(a_tree);
+            found = tree_indices.insert(make_pair(tree_file, add_tree(arrays))).first;
+        }
+        // scale, then turn around the y axis, then move into place
+        const float radians = yaw * float(M_PI) / 180.f;
+        Eigen::Matrix4f model_mat = Eigen::Matrix4f::Identity();
+        model_mat(0, 0) = scale * cos(radians);
+        model_mat(0, 2) = scale * sin(radians);
+        model_mat(1, 1) = scale;
+        model_mat(2, 0) = -scale * sin(radians);
+        model_mat(2, 2) = scale * cos(radians);
+        model_mat(0, 3) = x;
+        model_mat(1, 3) = y;
+        model_mat(2, 3) = z;
+        add_instance(found->second, model_mat);
+    }
+    return true;
+}
+
+int CTreeForest::add_tree(CTreeSkeletonArrays& aArrays) {
+    float box[6] = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f};
+    const vector<float>& positions = aArrays.get_vertex_positions();
+    for(size_t v = 0; v < aArrays.get_num_vertices(); ++v) {
+        for(int i = 0; i < 3; ++i) {
+            const float value = positions[3*v + i];
+            box[i] = (v == 0) ? value : min(box[i], value);
+            box[3+i] = (v == 0) ? value : max(box[3+i], value);
+        }
+    }
+    m_tree_boxes.insert(m_tree_boxes.end(), box, box + 6);
+    m_tree_vertex_counts.push_back(aArrays.get_num_vertices());
+    m_trees.emplace_back();
+    m_trees.back().swap(aArrays);
+    return int(m_trees.size()) - 1;
+}
+
+void CTreeForest::add_instance(int aTreeIndex, const Eigen::Matrix4f& aModelMat) {
+    m_instance_trees.push_back(aTreeIndex);
+    m_instance_matrices.insert(m_instance_matrices.end(), aModelMat.data(), aModelMat.data() + 16);
+    // grow the forest box by the corners of the placed tree box
+    const float* tree_box = m_tree_boxes.data() + 6*size_t(aTreeIndex);
+    for(int c = 0; c < 8; ++c) {
+        const Eigen::Vector4f corner(tree_box[(c & 1) ? 3 : 0], tree_box[(c & 2) ? 4 : 1],
+                                     tree_box[(c & 4) ? 5 : 2], 1.f);
+        const Eigen::Vector4f placed = aModelMat * corner;
+        if(m_box.empty())
+            m_box.assign({placed.x(), placed.y(), placed.z(), placed.x(), placed.y(), placed.z()});
+        for(int i = 0; i < 3; ++i) {
+            m_box[i] = min(m_box[i], placed[i]);
+            m_box[3+i] = max(m_box[3+i], placed[i]);
+        }
+    }
+}
+
+bool CTreeForest::get_bounding_box(CBBox<float>& aBox) const {
+    if(m_box.empty())
+        return false;
+    aBox.m_x_min = m_box[0];
+    aBox.m_y_min = m_box[1];
+    aBox.m_z_min = m_box[2];
+    aBox.m_x_max = m_box[3];
+    aBox.m_y_max = m_box[4];
+    aBox.m_z_max = m_box[5];
+    return true;
+}
+
+void CTreeForest::create_buffers() {
+    delete_buffers();
+    // the trees one after another, each drawn from its first element and base vertex
+    size_t num_vertices(0), num_elements(0);
+    for(const CTreeSkeletonArrays& a_tree : m_trees) {
+        num_vertices += a_tree.get_num_vertices();
+        num_elements += a_tree.get_num_elements();
+    }
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_vbo);
+    glGenBuffers(1, &m_ebo);
+    glGenBuffers(1, &m_instance_vbo);
+    glGenBuffers(1, &m_indirect_buffer);
+
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float)*3*num_vertices, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t)*num_elements, nullptr, GL_STATIC_DRAW);
+    vector<CDrawElementsCommand> commands(m_trees.size());
+    size_t first_vertex(0), first_element(0);
+    for(size_t t = 0; t < m_trees.size(); ++t) {
+        const CTreeSkeletonArrays& a_tree = m_trees[t];
+        glBufferSubData(GL_ARRAY_BUFFER, GLintptr(sizeof(float)*3*first_vertex),
+                        GLsizeiptr(sizeof(float)*a_tree.get_vertex_positions().size()),
+                        a_tree.get_vertex_positions().data());
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, GLintptr(sizeof(uint32_t)*first_element),
+                        GLsizeiptr(sizeof(uint32_t)*a_tree.get_num_elements()),
+                        a_tree.get_element_indices().data());
+        commands[t].m_count = uint32_t(a_tree.get_num_elements());
+        commands[t].m_instance_count = 0;
+        commands[t].m_first_index = uint32_t(first_element);
+        commands[t].m_base_vertex = int32_t(first_vertex);
+        commands[t].m_base_instance = 0;
+        first_vertex += a_tree.get_num_vertices();
+        first_element += a_tree.get_num_elements();
+    }
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    vector<CTreeSkeletonArrays>().swap(m_trees);
+
+    // the instances sorted by tree, so that the instances of a tree are a range from its first instance
+    const size_t num_instances = m_instance_trees.size();
+    for(int t : m_instance_trees)
+        ++commands[size_t(t)].m_instance_count;
+    uint32_t first_instance(0);
+    for(CDrawElementsCommand& a_command : commands) {
+        a_command.m_base_instance = first_instance;
+        first_instance += a_command.m_instance_count;
+    }
+    vector<float> sorted_matrices(m_instance_matrices.size());
+    vector<uint32_t> next_instances(commands.size());
+    for(size_t t = 0; t < commands.size(); ++t)
+        next_instances[t] = commands[t].m_base_instance;
+    for(size_t i = 0; i < num_instances; ++i) {
+        const size_t slot = next_instances[size_t(m_instance_trees[i])]++;
+        copy(m_instance_matrices.begin() + 16*i, m_instance_matrices.begin() + 16*(i + 1),
+             sorted_matrices.begin() + 16*slot);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, m_instance_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float)*sorted_matrices.size(), sorted_matrices.data(), GL_STATIC_DRAW);
+    // a matrix attribute takes a location per column
+    for(int c = 0; c < 4; ++c) {
+        glVertexAttribPointer(2 + c, 4, GL_FLOAT, GL_FALSE, 16*sizeof(float), (void*)(4*c*sizeof(float)));
+        glVertexAttribDivisor(2 + c, 1);
+        glEnableVertexAttribArray(2 + c);
+    }
+    glBindVertexArray(0);
+
+    // the trees without instances are not drawn
+    commands.erase(remove_if(commands.begin(), commands.end(),
+                             [](const CDrawElementsCommand& aCommand) {
+        return aCommand.m_instance_count == 0 || aCommand.m_count == 0;
+    }), commands.end());
+    m_num_commands = commands.size();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(CDrawElementsCommand)*commands.size(), commands.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void CTreeForest::draw() {
+    if(m_num_commands == 0)
+        return;
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
+    // the restart index is compared before the base vertex is added
+    glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    glMultiDrawElementsIndirect(GL_LINE_STRIP, GL_UNSIGNED_INT, (void*)0, GLsizei(m_num_commands), 0);
+    glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,93 @@
+#ifndef CTREEFOREST_H
+#define CTREEFOREST_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cdagtree.h"
+#include "ctreeskeletonarrays.h"
+
+/*
+ * A forest of placed copies of a few distinct trees, rendered in OpenGL.
+ * The skeleton arrays of every distinct tree are uploaded once, one after another,
+ * into a vertex buffer and an element buffer shared by all the trees. Every placement
+ * is an instance with its own model matrix, kept in an instance buffer sorted by tree
+ * and read by the vertex shader as a per-instance attribute (locations 2 to 5).
+ * A draw command per tree (its elements, base vertex, instance count and first instance)
+ * is stored in an indirect buffer, and the whole forest is drawn with a single
+ * glMultiDrawElementsIndirect, however many instances there are. Needs OpenGL 4.3.
+*/
+class CTreeForest
+{
+public:
+    CTreeForest();
+    ~CTreeForest();
+    CTreeForest(const CTreeForest&)=delete;
+    CTreeForest& operator=(const CTreeForest&)=delete;
+public:
+    /*
+     * Read a forest file, one placement per line:
+     *  tree_file x y z [yaw [scale]]
+     * The tree is rotated by yaw degrees around the y axis, scaled, then moved to (x, y, z).
+     * A relative tree file is taken from the directory of the forest file, and every
+     * distinct tree file is loaded once. Empty lines and lines starting with # are skipped.
+     * Returns false if the forest file or one of its trees could not be read.
+    */
+    bool read_forest_file(const std::string& aFileName);
+    /*
+     * Read and write the branch cache next to the tree files of read_forest_file()
+     * (see CDAGTree::set_branch_cache_enabled()). Disabled by default.
+    */
+    void set_branch_cache_enabled(bool aEnabled) {
+        m_is_branch_cache_enabled = aEnabled;
+    }
+    /*
+     * Add a distinct tree from its skeleton arrays, whose content is taken over.
+     * Returns the index of the tree for add_instance().
+    */
+    int add_tree(CTreeSkeletonArrays& aArrays);
+    /*
+     * Place a copy of the tree aTreeIndex with the given model matrix.
+    */
+    void add_instance(int aTreeIndex, const Eigen::Matrix4f& aModelMat);
+    /*
+     * Upload the trees and the instances into the OpenGL buffers, once all of them
+     * are added. The skeleton arrays are released.
+    */
+    void create_buffers();
+    /*
+     * Draw all the instances with one indirect multi-draw call.
+    */
+    void draw();
+
+    size_t get_num_trees() const {
+        return m_tree_vertex_counts.size();
+    }
+    size_t get_num_instances() const {
+        return m_instance_trees.size();
+    }
+    // the draw commands of the indirect call, one per tree with instances
+    size_t get_num_draw_commands() const {
+        return m_num_commands;
+    }
+    // the box around all the placed trees, false if there is none
+    bool get_bounding_box(CBBox<float>& aBox) const;
+protected:
+    void delete_buffers();
+private:
+    unsigned m_vao;
+    unsigned m_vbo;
+    unsigned m_ebo;
+    unsigned m_instance_vbo;
+    unsigned m_indirect_buffer;
+    size_t m_num_commands;
+    bool m_is_branch_cache_enabled;
+    std::vector<CTreeSkeletonArrays> m_trees;       // the trees not yet uploaded
+    std::vector<size_t> m_tree_vertex_counts;
+    std::vector<float> m_tree_boxes;                // the box of every tree, min x, y, z, max x, y, z
+    std::vector<int> m_instance_trees;              // the tree of every instance
+    std::vector<float> m_instance_matrices;         // the model matrix of every instance, column major
+    std::vector<float> m_box;                       // the box of all the instances, empty without any
+};
+
+#endif // CTREEFOREST_H
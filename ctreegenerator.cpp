@@ -0,0 +1,163 @@
+#include "ctreegenerator.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <random>
+using namespace std;
+
+namespace {
+
+// a uniform float in [-0.5, 0.5) from the top 24 bits of the generator
+inline float uniform_jitter(mt19937& aRng) {
+    return float(aRng() >> 8) * (1.f / 16777216.f) - 0.5f;
+}
+
+inline void normalize(float* v) {
+    float len = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+    for(int k = 0; k < 3; ++k)
+        v[k] /= (len > 0.f ? len : 1.f);
+}
+
+// a branch being written, positioned at its next node
+struct CBranchState {
+    float m_pos[3];
+    float m_dir[3];
+    float m_radius;
+    int m_order;
+    long m_length;          // the number of nodes of this branch
+    long m_next;            // the index of the next node to write in this branch
+    long m_num_forks;       // the number of nodes the side branches fork off at
+    long m_next_fork;       // the index of the next fork node
+    long m_num_sides;       // the number of side branches
+    long m_side_budget;     // the nodes shared by all the side branches
+};
+
+}
+
+CTreeGenerator::CTreeGenerator(const CTreeGeneratorParams& aParams) :
+    m_params(aParams),
+    m_file(nullptr),
+    m_buffer(size_t(1) << 20),
+    m_buffer_size(0),
+    m_is_write_failed(false),
+    m_num_nodes_written(0),
+    m_num_leaves_written(0),
+    m_max_order_written(0)
+{
+
+}
+
+CTreeGenerator::~CTreeGenerator() {
+    if(m_file)
+        fclose(m_file);
+}
+
+bool CTreeGenerator::flush() {
+    if(m_buffer_size > 0 && fwrite(m_buffer.data(), 1, m_buffer_size, m_file) != m_buffer_size)
+        m_is_write_failed = true;
+    m_buffer_size = 0;
+    return !m_is_write_failed;
+}
+
+void CTreeGenerator::write_node(const float* aPos, float aRadius, int aNumChildren, int aOrder) {
+    // a line takes at most 4 floats and 3 ints with their separators
+    if(m_buffer.size() - m_buffer_size < 256)
+        flush();
+    char* p = m_buffer.data() + m_buffer_size;
+    char* end = m_buffer.data() + m_buffer.size();
+    // the fixed 6-digit format of "%f"
+    const float values[4] = {aPos[0], aPos[1], aPos[2], aRadius};
+    for(float v : values) {
+        p = to_chars(p, end, v, chars_format::fixed, 6).ptr;
+        *p++ = ' ';
+    }
+    const bool is_leaf = aNumChildren == 0;
+    p = to_chars(p, end, aNumChildren).ptr;
+    *p++ = ' ';
+    *p++ = is_leaf ? '1' : '0';
+    *p++ = ' ';
+    p = to_chars(p, end, is_leaf ? 0 : aOrder).ptr;
+    *p++ = '\n';
+    m_buffer_size = size_t(p - m_buffer.data());
+
+    ++m_num_nodes_written;
+    m_num_leaves_written += is_leaf ? 1 : 0;
+    m_max_order_written = max(m_max_order_written, aOrder);
+}
+
+bool CTreeGenerator::write_tree_file(const std::string& aFileName) {
+    if(m_params.m_num_nodes < 1 || m_params.m_fan_out < 1 || m_params.m_max_depth < 0)
+        return false;
+    m_file = fopen(aFileName.c_str(), "wb");
+    if(!m_file)
+        return false;
+    m_buffer_size = 0;
+    m_is_write_failed = false;
+    m_num_nodes_written = 0;
+    m_num_leaves_written = 0;
+    m_max_order_written = 0;
+
+    mt19937 rng(m_params.m_seed);
+    const long fan_out = m_params.m_fan_out;
+    auto make_branch = [this, fan_out](const float* aPos, const float* aDir, float aRadius, int aOrder, long aBudget) {
+        CBranchState b{{aPos[0], aPos[1], aPos[2]}, {aDir[0], aDir[1], aDir[2]}, aRadius, aOrder, 0, 0, 0, 0, 0, 0};
+        const bool is_last_order = m_params.m_max_depth > 0 && aOrder >= m_params.m_max_depth;
+        b.m_length = is_last_order ? aBudget : min(aBudget, max(2L, long(2.0*sqrt(double(aBudget)))));
+        b.m_side_budget = aBudget - b.m_length;
+        // about one side branch per branch length of budget, as many per node as the fan-out allows
+        b.m_num_sides = min((b.m_length - 1)*fan_out, (b.m_side_budget + b.m_length - 1) / b.m_length);
+        b.m_num_forks = (b.m_num_sides + fan_out - 1) / fan_out;
+        return b;
+    };
+
+    const float origin[3] = {0.f, 0.f, 0.f};
+    const float up[3] = {0.f, 1.f, 0.f};
+    vector<CBranchState> open_branches;
+    open_branches.push_back(make_branch(origin, up, 1.f, 1, m_params.m_num_nodes));
+    while(!open_branches.empty()) {
+        CBranchState b = open_branches.back();
+        open_branches.pop_back();
+
+        // the side branches fork at the evenly spaced fork nodes along the branch
+        bool is_fork = b.m_next_fork < b.m_num_forks
+                && b.m_next == (2*b.m_next_fork + 1)*(b.m_length - 1) / (2*b.m_num_forks);
+        // the side branches are dealt to the fork nodes in turn
+        long num_sides = is_fork ? (b.m_num_sides - b.m_next_fork + b.m_num_forks - 1) / b.m_num_forks : 0;
+        bool has_next = b.m_next + 1 < b.m_length;
+        write_node(b.m_pos, b.m_radius, int(has_next) + int(num_sides), b.m_order);
+
+        // the continuation of this branch is written after the side branch subtrees
+        if(has_next) {
+            CBranchState a_next = b;
+            ++a_next.m_next;
+            a_next.m_next_fork += is_fork ? 1 : 0;
+            for(int k = 0; k < 3; ++k)
+                a_next.m_dir[k] += m_params.m_jitter*uniform_jitter(rng);
+            normalize(a_next.m_dir);
+            for(int k = 0; k < 3; ++k)
+                a_next.m_pos[k] += m_params.m_step_length*a_next.m_dir[k];
+            a_next.m_radius = max(0.2f, 0.995f*b.m_radius);
+            open_branches.push_back(a_next);
+        }
+        // the side branches are pushed in reverse, so the first one is written first
+        const size_t first_side = open_branches.size();
+        for(long s = 0; s < num_sides; ++s) {
+            // the side branch index over the whole branch, in the order they are dealt
+            long side_index = b.m_next_fork + s*b.m_num_forks;
+            long budget = b.m_side_budget / b.m_num_sides + (side_index < b.m_side_budget % b.m_num_sides ? 1 : 0);
+            float a_dir[3];
+            float a_pos[3];
+            for(int k = 0; k < 3; ++k)
+                a_dir[k] = b.m_dir[k] + m_params.m_spread*uniform_jitter(rng);
+            normalize(a_dir);
+            for(int k = 0; k < 3; ++k)
+                a_pos[k] = b.m_pos[k] + m_params.m_step_length*a_dir[k];
+            open_branches.push_back(make_branch(a_pos, a_dir, max(0.2f, 0.6f*b.m_radius), b.m_order + 1, budget));
+        }
+        reverse(open_branches.begin() + long(first_side), open_branches.end());
+    }
+    bool is_written = flush() && fclose(m_file) == 0;
+    m_file = nullptr;
+    return is_written && m_num_nodes_written == m_params.m_num_nodes;
+}
@@ -0,0 +1,79 @@
+#ifndef CTREEGENERATOR_H
+#define CTREEGENERATOR_H
+
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/*
+ * The parameters of a synthetic random-branching tree.
+*/
+struct CTreeGeneratorParams {
+    long m_num_nodes;           // exactly this many nodes are written
+    uint32_t m_seed;            // the same seed and parameters always give the same file
+    int m_max_depth;            // the highest branch order, the trunk is order 1; 0 for no limit
+    int m_fan_out;              // the most side branches forking off at one node, at least 1
+    float m_step_length;        // the distance between consecutive nodes of a branch
+    float m_jitter;             // the random bend of a branch at every node
+    float m_spread;             // the random deviation of a side branch from its parent branch
+
+    CTreeGeneratorParams() : m_num_nodes(100000), m_seed(1), m_max_depth(0), m_fan_out(1),
+        m_step_length(0.5f), m_jitter(0.2f), m_spread(1.5f) {}
+};
+
+/*
+ * Write synthetic trees in the 7-column pre-order .tree format.
+ * A branch with a budget of B nodes keeps about 2*sqrt(B) nodes for itself and splits
+ * the rest evenly among its side branches, which fork off at evenly spaced nodes along it,
+ * up to m_fan_out at one node. So the nesting depth grows like log(log(B)). A branch at
+ * the highest order keeps its whole budget. The 6th column is the tag of a node: the
+ * TestData trees carry a small integer tag (0 to 15) on their leaf nodes and 0 on the
+ * internal nodes; here every leaf node is tagged 1. The 7th column is the branch order
+ * of the internal nodes and 0 on the leaf nodes, as in the TestData trees.
+ * The tree is written depth first while it is generated, so the memory stays bounded by
+ * the nesting depth whatever the size of the file. The random numbers come from
+ * std::mt19937 mapped to floats without the standard distributions, whose output differs
+ * between library implementations, so a file is reproducible on every platform.
+*/
+class CTreeGenerator
+{
+public:
+    explicit CTreeGenerator(const CTreeGeneratorParams& aParams);
+    ~CTreeGenerator();
+    CTreeGenerator(const CTreeGenerator&)=delete;
+    CTreeGenerator& operator=(const CTreeGenerator&)=delete;
+public:
+    /*
+     * Write the tree to the given file.
+     * Returns false if the parameters are not valid or the file can not be written.
+    */
+    bool write_tree_file(const std::string& aFileName);
+
+    long get_num_nodes_written() const {
+        return m_num_nodes_written;
+    }
+    long get_num_leaves_written() const {
+        return m_num_leaves_written;
+    }
+    int get_max_order_written() const {
+        return m_max_order_written;
+    }
+protected:
+    /*
+     * Append one node line to the output buffer, flushing it to the file when full.
+    */
+    void write_node(const float* aPos, float aRadius, int aNumChildren, int aOrder);
+    bool flush();
+private:
+    CTreeGeneratorParams m_params;
+    FILE* m_file;
+    std::vector<char> m_buffer;         // the lines not yet written to the file
+    size_t m_buffer_size;
+    bool m_is_write_failed;
+    long m_num_nodes_written;
+    long m_num_leaves_written;
+    int m_max_order_written;
+};
+
+#endif // CTREEGENERATOR_H
@@ -0,0 +1,102 @@
+#include "ctreegeometrybuilder.h"
+
+#include <chrono>
+
+using namespace std;
+
+CTreeGeometryBuilder::CTreeGeometryBuilder(unsigned aNumThreads) :
+    m_pool(aNumThreads),
+    m_radial_segments(8),
+    m_is_building(false),
+    m_is_stopping(false),
+    m_is_mesh_published(false),
+    m_mesh_seconds(0.0),
+    m_bvh_seconds(0.0)
+{
+    // started last, once every member it reads is initialized
+    m_thread = thread(&CTreeGeometryBuilder::run, this);
+}
+
+CTreeGeometryBuilder::~CTreeGeometryBuilder() {
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_is_stopping = true;
+    }
+    m_work_available.notify_one();
+    m_thread.join();
+}
+
+void CTreeGeometryBuilder::request_tube_mesh(const shared_ptr<const CDAGTree<float>>& aTreePtr, int aRadialSegments) {
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_tube_tree_ptr = aTreePtr;
+        m_radial_segments = aRadialSegments;
+    }
+    m_work_available.notify_one();
+}
+
+void CTreeGeometryBuilder::request_segment_bvh(const shared_ptr<const CDAGTree<float>>& aTreePtr) {
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_bvh_tree_ptr = aTreePtr;
+    }
+    m_work_available.notify_one();
+}
+
+bool CTreeGeometryBuilder::take_tube_mesh(CTreeTubeMesh& aMesh, double& aSeconds) {
+    lock_guard<mutex> lock(m_mutex);
+    if(!m_is_mesh_published)
+        return false;
+    aMesh.swap(m_published_mesh);
+    aSeconds = m_mesh_seconds;
+    m_is_mesh_published = false;
+    return true;
+}
+
+shared_ptr<CTreeSegmentBVH> CTreeGeometryBuilder::take_segment_bvh(double& aSeconds) {
+    lock_guard<mutex> lock(m_mutex);
+    aSeconds = m_bvh_seconds;
+    return move(m_published_bvh);
+}
+
+bool CTreeGeometryBuilder::is_busy() {
+    lock_guard<mutex> lock(m_mutex);
+    return m_tube_tree_ptr || m_bvh_tree_ptr || m_is_building || m_is_mesh_published || m_published_bvh;
+}
+
+void CTreeGeometryBuilder::run() {
+    using clock = chrono::steady_clock;
+    unique_lock<mutex> lock(m_mutex);
+    while(true) {
+        m_work_available.wait(lock, [this]{ return m_is_stopping || m_tube_tree_ptr || m_bvh_tree_ptr; });
+        if(m_is_stopping)
+            return;
+        // the request is taken under the lock, and built without it
+        m_is_building = true;
+        if(m_tube_tree_ptr) {
+            shared_ptr<const CDAGTree<float>> a_tree_ptr = move(m_tube_tree_ptr);
+            const int radial_segments = m_radial_segments;
+            lock.unlock();
+            clock::time_point start = clock::now();
+            m_back_mesh.build_parallel(*a_tree_ptr, m_pool, radial_segments);
+            const double seconds = chrono::duration<double>(clock::now() - start).count();
+            lock.lock();
+            // a mesh published before and not taken is replaced
+            m_published_mesh.swap(m_back_mesh);
+            m_back_mesh.clear();
+            m_is_mesh_published = true;
+            m_mesh_seconds = seconds;
+        } else {
+            shared_ptr<const CDAGTree<float>> a_tree_ptr = move(m_bvh_tree_ptr);
+            lock.unlock();
+            clock::time_point start = clock::now();
+            shared_ptr<CTreeSegmentBVH> a_bvh_ptr(new CTreeSegmentBVH());
+            a_bvh_ptr->build_parallel(*a_tree_ptr, m_pool);
+            const double seconds = chrono::duration<double>(clock::now() - start).count();
+            lock.lock();
+            m_published_bvh = a_bvh_ptr;
+            m_bvh_seconds = seconds;
+        }
+        m_is_building = false;
+    }
+}
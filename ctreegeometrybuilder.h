@@ -0,0 +1,77 @@
+#ifndef CTREEGEOMETRYBUILDER_H
+#define CTREEGEOMETRYBUILDER_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "cdagtree.h"
+#include "ctreetubemesh.h"
+#include "ctreesegmentbvh.h"
+#include "cworkstealingpool.h"
+
+/*
+ * Build the tube mesh and the segment hierarchy of a tree on a background thread, so the
+ * rendering thread keeps drawing while they are built. The builds of the requests run one
+ * after another on the thread, each spread over a work-stealing pool kept for the life of
+ * the builder. A finished build is published under a mutex and taken by the rendering
+ * thread: the tube mesh is built into a mesh of the builder and swapped with the published
+ * one, then swapped out of it by take_tube_mesh(), so no array is copied, and the rendering
+ * thread only uploads it. No OpenGL call is made here.
+*/
+class CTreeGeometryBuilder
+{
+public:
+    // starts the thread and a pool of aNumThreads, zero for one per hardware thread
+    explicit CTreeGeometryBuilder(unsigned aNumThreads = 0);
+    // drops the requests not started and waits for the build running
+    ~CTreeGeometryBuilder();
+    CTreeGeometryBuilder(const CTreeGeometryBuilder&)=delete;
+    CTreeGeometryBuilder& operator=(const CTreeGeometryBuilder&)=delete;
+public:
+    /*
+     * Ask for the tube mesh of the extracted branches of a tree, see CTreeTubeMesh::build().
+     * The tree is kept alive and must stay unchanged until the mesh is published.
+    */
+    void request_tube_mesh(const std::shared_ptr<const CDAGTree<float>>& aTreePtr, int aRadialSegments);
+    /*
+     * Ask for the segment hierarchy of a tree, see CTreeSegmentBVH::build().
+     * The tree is kept alive and must stay unchanged until the hierarchy is published.
+    */
+    void request_segment_bvh(const std::shared_ptr<const CDAGTree<float>>& aTreePtr);
+    /*
+     * Swap the published tube mesh into aMesh, with the seconds it took to build.
+     * Returns false, leaving aMesh unchanged, if no mesh was published since the last call.
+    */
+    bool take_tube_mesh(CTreeTubeMesh& aMesh, double& aSeconds);
+    /*
+     * Take the published segment hierarchy, with the seconds it took to build.
+     * Returns null if no hierarchy was published since the last call.
+    */
+    std::shared_ptr<CTreeSegmentBVH> take_segment_bvh(double& aSeconds);
+    // a request is queued or being built, or its result is not taken yet
+    bool is_busy();
+protected:
+    void run();
+private:
+    CWorkStealingPool m_pool;
+    // the requests, guarded by m_mutex
+    std::shared_ptr<const CDAGTree<float>> m_tube_tree_ptr;     // the tree of the requested mesh, null if none
+    int m_radial_segments;
+    std::shared_ptr<const CDAGTree<float>> m_bvh_tree_ptr;      // the tree of the requested hierarchy, null if none
+    bool m_is_building;
+    bool m_is_stopping;
+    // the results
+    CTreeTubeMesh m_back_mesh;                  // being built, by the builder thread only
+    CTreeTubeMesh m_published_mesh;             // guarded by m_mutex, as the rest
+    bool m_is_mesh_published;
+    double m_mesh_seconds;
+    std::shared_ptr<CTreeSegmentBVH> m_published_bvh;
+    double m_bvh_seconds;
+    std::mutex m_mutex;
+    std::condition_variable m_work_available;
+    std::thread m_thread;
+};
+
+#endif // CTREEGEOMETRYBUILDER_H
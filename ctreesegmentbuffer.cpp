@@ -0,0 +1,71 @@
+#include "ctreesegmentbuffer.h"
+#include "GL/glew.h"
+
+#include <algorithm>
+using namespace std;
+
+CTreeSegmentBuffer::CTreeSegmentBuffer(size_t aInitialNumSegments) :
+    m_vao(0),
+    m_vbo(0),
+    m_num_vertices(0),
+    m_capacity_vertices(max(aInitialNumSegments, size_t(1))*2)
+{
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_vbo);
+
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(3*sizeof(float)*m_capacity_vertices), nullptr, GL_DYNAMIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+}
+
+CTreeSegmentBuffer::~CTreeSegmentBuffer() {
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteVertexArrays(1, &m_vao);
+}
+
+void CTreeSegmentBuffer::append(const vector<float>& aVertices) {
+    const size_t num_vertices = aVertices.size() / 3;
+    if(num_vertices == 0)
+        return;
+    if(m_num_vertices + num_vertices > m_capacity_vertices)
+        grow(m_num_vertices + num_vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    GLintptr(3*sizeof(float)*m_num_vertices),
+                    GLsizeiptr(3*sizeof(float)*num_vertices),
+                    aVertices.data());
+    m_num_vertices += num_vertices;
+}
+
+void CTreeSegmentBuffer::draw() {
+    if(m_num_vertices == 0)
+        return;
+    glBindVertexArray(m_vao);
+    glDrawArrays(GL_LINES, 0, GLsizei(m_num_vertices));
+}
+
+void CTreeSegmentBuffer::grow(size_t aNumVertices) {
+    size_t new_capacity = m_capacity_vertices;
+    while(new_capacity < aNumVertices)
+        new_capacity *= 2;
+
+    unsigned new_vbo(0);
+    glGenBuffers(1, &new_vbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, new_vbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(3*sizeof(float)*new_capacity), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, m_vbo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                        GLsizeiptr(3*sizeof(float)*m_num_vertices));
+    glDeleteBuffers(1, &m_vbo);
+    m_vbo = new_vbo;
+    m_capacity_vertices = new_capacity;
+
+    // point the vertex array object to the new buffer
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
+    glBindVertexArray(0);
+}
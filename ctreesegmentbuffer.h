@@ -0,0 +1,46 @@
+#ifndef CTREESEGMENTBUFFER_H
+#define CTREESEGMENTBUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * A growing OpenGL buffer of line segments, two vertices (x, y, z each) per segment.
+ * It shows the raw parent-child segments of a tree while the tree is streamed in
+ * (see CTreeStreamLoader). New segments are appended with glBufferSubData behind the
+ * ones already uploaded; when the buffer is full its capacity is doubled and the old
+ * content is copied on the GPU, so every vertex is sent from the CPU only once.
+*/
+class CTreeSegmentBuffer
+{
+public:
+    explicit CTreeSegmentBuffer(size_t aInitialNumSegments = 65536);
+    ~CTreeSegmentBuffer();
+    CTreeSegmentBuffer(const CTreeSegmentBuffer&)=delete;
+    CTreeSegmentBuffer& operator=(const CTreeSegmentBuffer&)=delete;
+public:
+    /*
+     * Upload the segments of aVertices behind the ones already in the buffer.
+    */
+    void append(const std::vector<float>& aVertices);
+    /*
+     * Draw all the segments uploaded so far as lines.
+    */
+    void draw();
+
+    size_t get_num_segments() const {
+        return m_num_vertices / 2;
+    }
+protected:
+    /*
+     * Move the buffer content into a new buffer holding at least aNumVertices vertices.
+    */
+    void grow(size_t aNumVertices);
+private:
+    unsigned m_vao;
+    unsigned m_vbo;
+    size_t m_num_vertices;              // the vertices uploaded
+    size_t m_capacity_vertices;         // the vertices the buffer can hold
+};
+
+#endif // CTREESEGMENTBUFFER_H
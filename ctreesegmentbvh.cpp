@@ -0,0 +1,401 @@
+#include "ctreesegmentbvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+using namespace std;
+
+typedef Eigen::Vector3f Vector3f;
+
+// the centroid bins of the surface area heuristic along every axis
+static const int BVH_NUM_BINS = 16;
+// the capsules a leaf may keep when a split does not pay off, more are always split
+static const uint32_t BVH_MAX_LEAF_SIZE = 8;
+// the cost of visiting an inner node relative to the intersection of a capsule
+static const float BVH_TRAVERSAL_COST = 1.f;
+// the deepest node, which bounds the traversal stack
+static const int BVH_MAX_DEPTH = 64;
+// the smallest subtree worth a task of its own
+static const uint32_t BVH_MIN_TASK_SEGMENTS = 16384;
+
+/*
+ * The surface area of the box between aMin and aMax, 0 for an empty box.
+*/
+static float box_area(const Vector3f& aMin, const Vector3f& aMax) {
+    const Vector3f extent = (aMax - aMin).cwiseMax(Vector3f::Zero());
+    return 2.f * (extent.x()*extent.y() + extent.y()*extent.z() + extent.z()*extent.x());
+}
+
+/*
+ * The distance at which the ray enters the box grown by aGrowth, or infinity if it misses
+ * the box or enters it beyond aMaxDistance.
+*/
+static float intersect_box(const float* aMin, const float* aMax, float aGrowth, const Vector3f& aOrigin,
+                           const Vector3f& aInvDir, float aMaxDistance) {
+    float t_near(0.f), t_far(aMaxDistance);
+    for(int i = 0; i < 3; ++i) {
+        float t0 = (aMin[i] - aGrowth - aOrigin[i]) * aInvDir[i];
+        float t1 = (aMax[i] + aGrowth - aOrigin[i]) * aInvDir[i];
+        if(t0 > t1)
+            std::swap(t0, t1);
+        // NaN, from a ray in the plane of a slab, leaves the interval as it is
+        t_near = t0 > t_near ? t0 : t_near;
+        t_far = t1 < t_far ? t1 : t_far;
+        if(t_near > t_far)
+            return numeric_limits<float>::infinity();
+    }
+    return t_near;
+}
+
+/*
+ * The distance at which the ray hits the capsule of radius aRadius around the segment
+ * from aBegin to aEnd, or a negative value if it misses it.
+*/
+static float intersect_capsule(const Vector3f& aOrigin, const Vector3f& aDir, const Vector3f& aBegin,
+                               const Vector3f& aEnd, float aRadius) {
+    const Vector3f ba = aEnd - aBegin;
+    const Vector3f oa = aOrigin - aBegin;
+    const float baba = ba.dot(ba);
+    const float bard = ba.dot(aDir);
+    const float baoa = ba.dot(oa);
+    const float rdoa = aDir.dot(oa);
+    const float oaoa = oa.dot(oa);
+    // the infinite cylinder around the segment
+    const float a = baba - bard*bard;
+    float b = baba*rdoa - baoa*bard;
+    float c = baba*oaoa - baoa*baoa - aRadius*aRadius*baba;
+    float h = b*b - a*c;
+    if(h < 0.f)
+        return -1.f;
+    // the position of the hit along the segment, times baba
+    float y = (bard > 0.f) ? 0.f : baba;
+    if(a > 0.f) {
+        const float t = (-b - sqrt(h)) / a;
+        y = baoa + t*bard;
+        if(y > 0.f && y < baba)
+            return t;
+    }
+    // the sphere around the end where the cylinder is left
+    const Vector3f oc = (y <= 0.f) ? oa : Vector3f(aOrigin - aEnd);
+    b = aDir.dot(oc);
+    c = oc.dot(oc) - aRadius*aRadius;
+    h = b*b - c;
+    if(h < 0.f)
+        return -1.f;
+    return -b - sqrt(h);
+}
+
+CTreeSegmentBVH::CTreeSegmentBVH() :
+    m_depth(0),
+    m_num_build_nodes(0),
+    m_build_depth(0)
+{
+
+}
+
+CTreeSegmentBVH::~CTreeSegmentBVH() {
+    clear();
+}
+
+void CTreeSegmentBVH::clear() {
+    m_nodes.clear();
+    m_segments.clear();
+    m_depth = 0;
+}
+
+void CTreeSegmentBVH::swap(CTreeSegmentBVH& aOther) {
+    m_nodes.swap(aOther.m_nodes);
+    m_segments.swap(aOther.m_segments);
+    std::swap(m_depth, aOther.m_depth);
+}
+
+void CTreeSegmentBVH::build(const CDAGTree<float>& aTree) {
+    generate(aTree, nullptr);
+}
+
+void CTreeSegmentBVH::build_parallel(const CDAGTree<float>& aTree, CWorkStealingPool& aPool) {
+    generate(aTree, &aPool);
+}
+
+void CTreeSegmentBVH::generate(const CDAGTree<float>& aTree, CWorkStealingPool* aPool) {
+    clear();
+    // a capsule from the parent of every node but the root
+    vector<CSegment> segments;
+    segments.reserve(aTree.get_total_num_of_nodes());
+    for(size_t i = 0; i < aTree.get_total_num_of_nodes(); ++i) {
+        const int parent_index = aTree.get_parent_index(int(i));
+        if(parent_index < 0)
+            continue;
+        CSegment a_segment;
+        a_segment.m_begin[0] = aTree.get_node_x(parent_index);
+        a_segment.m_begin[1] = aTree.get_node_y(parent_index);
+        a_segment.m_begin[2] = aTree.get_node_z(parent_index);
+        a_segment.m_end[0] = aTree.get_node_x(int(i));
+        a_segment.m_end[1] = aTree.get_node_y(int(i));
+        a_segment.m_end[2] = aTree.get_node_z(int(i));
+        a_segment.m_radius = max(aTree.get_node_radius(parent_index), aTree.get_node_radius(int(i)));
+        a_segment.m_begin_node = parent_index;
+        a_segment.m_end_node = int(i);
+        segments.push_back(a_segment);
+    }
+    const uint32_t num_segments = uint32_t(segments.size());
+    if(num_segments == 0)
+        return;
+
+    m_build_refs.resize(num_segments);
+    for(uint32_t s = 0; s < num_segments; ++s) {
+        const CSegment& a_segment = segments[s];
+        CBuildRef& a_ref = m_build_refs[s];
+        for(int i = 0; i < 3; ++i) {
+            a_ref.m_min[i] = min(a_segment.m_begin[i], a_segment.m_end[i]) - a_segment.m_radius;
+            a_ref.m_max[i] = max(a_segment.m_begin[i], a_segment.m_end[i]) + a_segment.m_radius;
+        }
+        a_ref.m_segment = s;
+    }
+    // a binary tree with a capsule per leaf at most has 2n-1 nodes
+    m_nodes.resize(2*size_t(num_segments) - 1);
+    m_num_build_nodes.store(1);
+    m_build_depth.store(0);
+    CBuildBounds root_bounds;
+    reset_bounds(root_bounds);
+    for(const CBuildRef& a_ref : m_build_refs)
+        add_to_bounds(root_bounds, a_ref);
+    build_node(0, 0, num_segments, root_bounds, 1, aPool);
+    if(aPool)
+        aPool->wait();
+    m_nodes.resize(m_num_build_nodes.load());
+    m_nodes.shrink_to_fit();
+    m_depth = m_build_depth.load();
+
+    // the capsules in the order of the leaves
+    m_segments.resize(num_segments);
+    for(uint32_t s = 0; s < num_segments; ++s)
+        m_segments[s] = segments[m_build_refs[s].m_segment];
+    vector<CBuildRef>().swap(m_build_refs);
+}
+
+void CTreeSegmentBVH::reset_bounds(CBuildBounds& aBounds) {
+    aBounds.m_min = aBounds.m_centroid_min = Vector3f::Constant(numeric_limits<float>::max());
+    aBounds.m_max = aBounds.m_centroid_max = Vector3f::Constant(numeric_limits<float>::lowest());
+}
+
+void CTreeSegmentBVH::add_to_bounds(CBuildBounds& aBounds, const CBuildRef& aRef) {
+    const Vector3f ref_min = Eigen::Map<const Vector3f>(aRef.m_min);
+    const Vector3f ref_max = Eigen::Map<const Vector3f>(aRef.m_max);
+    const Vector3f centroid = 0.5f * (ref_min + ref_max);
+    aBounds.m_min = aBounds.m_min.cwiseMin(ref_min);
+    aBounds.m_max = aBounds.m_max.cwiseMax(ref_max);
+    aBounds.m_centroid_min = aBounds.m_centroid_min.cwiseMin(centroid);
+    aBounds.m_centroid_max = aBounds.m_centroid_max.cwiseMax(centroid);
+}
+
+void CTreeSegmentBVH::update_depth(int aDepth) {
+    int depth = m_build_depth.load(memory_order_relaxed);
+    while(depth < aDepth && !m_build_depth.compare_exchange_weak(depth, aDepth, memory_order_relaxed)) {}
+}
+
+void CTreeSegmentBVH::build_node(uint32_t aNodeIndex, uint32_t aBegin, uint32_t aEnd, const CBuildBounds& aBounds,
+                                 int aDepth, CWorkStealingPool* aPool) {
+    const Vector3f& centroid_min = aBounds.m_centroid_min;
+    CNode& a_node = m_nodes[aNodeIndex];
+    for(int i = 0; i < 3; ++i) {
+        a_node.m_min[i] = aBounds.m_min[i];
+        a_node.m_max[i] = aBounds.m_max[i];
+    }
+    const uint32_t count = aEnd - aBegin;
+    const Vector3f centroid_extent = aBounds.m_centroid_max - centroid_min;
+    // the capsules cannot be told apart by their centroids, or the stack would overflow
+    if(count <= 1 || centroid_extent.maxCoeff() <= 0.f || aDepth >= BVH_MAX_DEPTH) {
+        a_node.m_index = aBegin;
+        a_node.m_count = count;
+        update_depth(aDepth);
+        return;
+    }
+
+    // the capsules binned by their centroids along all the axes in one pass,
+    // into fewer bins when there are only a few capsules
+    const int num_bins = int(min(count, uint32_t(BVH_NUM_BINS)));
+    Vector3f bin_scales;
+    for(int axis = 0; axis < 3; ++axis)
+        bin_scales[axis] = centroid_extent[axis] > 0.f ? float(num_bins) / centroid_extent[axis] : 0.f;
+    uint32_t bin_counts[3][BVH_NUM_BINS] = {};
+    Vector3f bin_mins[3][BVH_NUM_BINS], bin_maxs[3][BVH_NUM_BINS];
+    for(int axis = 0; axis < 3; ++axis) {
+        for(int k = 0; k < num_bins; ++k) {
+            bin_mins[axis][k] = Vector3f::Constant(numeric_limits<float>::max());
+            bin_maxs[axis][k] = Vector3f::Constant(numeric_limits<float>::lowest());
+        }
+    }
+    for(uint32_t r = aBegin; r < aEnd; ++r) {
+        const Vector3f segment_min = Eigen::Map<const Vector3f>(m_build_refs[r].m_min);
+        const Vector3f segment_max = Eigen::Map<const Vector3f>(m_build_refs[r].m_max);
+        const Vector3f centroid = 0.5f * (segment_min + segment_max);
+        for(int axis = 0; axis < 3; ++axis) {
+            const int k = min(num_bins - 1, int((centroid[axis] - centroid_min[axis]) * bin_scales[axis]));
+            ++bin_counts[axis][k];
+            bin_mins[axis][k] = bin_mins[axis][k].cwiseMin(segment_min);
+            bin_maxs[axis][k] = bin_maxs[axis][k].cwiseMax(segment_max);
+        }
+    }
+
+    // the cheapest split between the bins of every axis
+    int best_axis(-1), best_split(0);
+    float best_cost = numeric_limits<float>::max();
+    for(int axis = 0; axis < 3; ++axis) {
+        if(centroid_extent[axis] <= 0.f)
+            continue;
+        // the areas and counts to the right of every split, then swept from the left
+        float right_areas[BVH_NUM_BINS];
+        uint32_t right_counts[BVH_NUM_BINS];
+        Vector3f sweep_min = Vector3f::Constant(numeric_limits<float>::max());
+        Vector3f sweep_max = Vector3f::Constant(numeric_limits<float>::lowest());
+        uint32_t sweep_count(0);
+        for(int k = num_bins - 1; k > 0; --k) {
+            sweep_min = sweep_min.cwiseMin(bin_mins[axis][k]);
+            sweep_max = sweep_max.cwiseMax(bin_maxs[axis][k]);
+            sweep_count += bin_counts[axis][k];
+            right_areas[k] = box_area(sweep_min, sweep_max);
+            right_counts[k] = sweep_count;
+        }
+        sweep_min = Vector3f::Constant(numeric_limits<float>::max());
+        sweep_max = Vector3f::Constant(numeric_limits<float>::lowest());
+        sweep_count = 0;
+        for(int k = 1; k < num_bins; ++k) {
+            sweep_min = sweep_min.cwiseMin(bin_mins[axis][k-1]);
+            sweep_max = sweep_max.cwiseMax(bin_maxs[axis][k-1]);
+            sweep_count += bin_counts[axis][k-1];
+            if(sweep_count == 0 || right_counts[k] == 0)
+                continue;
+            const float cost = float(sweep_count) * box_area(sweep_min, sweep_max)
+                    + float(right_counts[k]) * right_areas[k];
+            if(cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = k;
+            }
+        }
+    }
+
+    const float node_area = box_area(aBounds.m_min, aBounds.m_max);
+    const float leaf_cost = float(count) * node_area;
+    const float split_cost = BVH_TRAVERSAL_COST * node_area + best_cost;
+    if(best_axis < 0 || (count <= BVH_MAX_LEAF_SIZE && leaf_cost <= split_cost)) {
+        a_node.m_index = aBegin;
+        a_node.m_count = count;
+        update_depth(aDepth);
+        return;
+    }
+
+    // the capsules of the bins left of the split go first, the bounds of both sides are
+    // gathered on the way
+    const float bin_scale = bin_scales[best_axis];
+    const float axis_min = centroid_min[best_axis];
+    CBuildBounds left_bounds, right_bounds;
+    reset_bounds(left_bounds);
+    reset_bounds(right_bounds);
+    uint32_t split(aBegin), last(aEnd);
+    while(split < last) {
+        CBuildRef& a_ref = m_build_refs[split];
+        const float centroid = 0.5f * (a_ref.m_min[best_axis] + a_ref.m_max[best_axis]);
+        if(min(num_bins - 1, int((centroid - axis_min) * bin_scale)) < best_split) {
+            add_to_bounds(left_bounds, a_ref);
+            ++split;
+        } else {
+            add_to_bounds(right_bounds, a_ref);
+            std::swap(a_ref, m_build_refs[--last]);
+        }
+    }
+
+    const uint32_t first_child = m_num_build_nodes.fetch_add(2, memory_order_relaxed);
+    a_node.m_index = first_child;
+    a_node.m_count = 0;
+    if(aPool && aEnd - split >= BVH_MIN_TASK_SEGMENTS) {
+        aPool->submit([this, first_child, split, aEnd, right_bounds, aDepth, aPool]() {
+            build_node(first_child + 1, split, aEnd, right_bounds, aDepth + 1, aPool);
+        });
+    } else {
+        build_node(first_child + 1, split, aEnd, right_bounds, aDepth + 1, aPool);
+    }
+    build_node(first_child, aBegin, split, left_bounds, aDepth + 1, aPool);
+}
+
+bool CTreeSegmentBVH::get_bounding_box(Eigen::Vector3f& aMin, Eigen::Vector3f& aMax) const {
+    if(m_nodes.empty())
+        return false;
+    aMin = Eigen::Map<const Vector3f>(m_nodes[0].m_min);
+    aMax = Eigen::Map<const Vector3f>(m_nodes[0].m_max);
+    return true;
+}
+
+bool CTreeSegmentBVH::intersect(const Eigen::Vector3f& aOrigin, const Eigen::Vector3f& aDir, float aMinRadius,
+                                CSegmentHit& aHit, float aMaxDistance) const {
+    if(m_nodes.empty())
+        return false;
+    const Vector3f inv_dir(1.f / aDir.x(), 1.f / aDir.y(), 1.f / aDir.z());
+    const float growth = max(aMinRadius, 0.f);
+    float best_distance = aMaxDistance;
+    const CSegment* best_segment(nullptr);
+
+    // the nodes still to visit with the distance where the ray enters them, the nearest on top
+    struct CEntry {
+        uint32_t m_node;
+        float m_distance;
+    };
+    CEntry stack[BVH_MAX_DEPTH + 1];
+    int stack_size(0);
+    float root_distance = intersect_box(m_nodes[0].m_min, m_nodes[0].m_max, growth, aOrigin, inv_dir, best_distance);
+    if(root_distance == numeric_limits<float>::infinity())
+        return false;
+    stack[stack_size++] = {0, root_distance};
+    while(stack_size > 0) {
+        const CEntry entry = stack[--stack_size];
+        if(entry.m_distance > best_distance)
+            continue;
+        const CNode& a_node = m_nodes[entry.m_node];
+        if(a_node.m_count > 0) {
+            for(uint32_t s = a_node.m_index; s < a_node.m_index + a_node.m_count; ++s) {
+                const CSegment& a_segment = m_segments[s];
+                const float distance = intersect_capsule(aOrigin, aDir, Eigen::Map<const Vector3f>(a_segment.m_begin),
+                                                         Eigen::Map<const Vector3f>(a_segment.m_end),
+                                                         max(a_segment.m_radius, growth));
+                if(distance >= 0.f && distance < best_distance) {
+                    best_distance = distance;
+                    best_segment = &a_segment;
+                }
+            }
+            continue;
+        }
+        const uint32_t left = a_node.m_index, right = a_node.m_index + 1;
+        float left_distance = intersect_box(m_nodes[left].m_min, m_nodes[left].m_max, growth,
+                                            aOrigin, inv_dir, best_distance);
+        float right_distance = intersect_box(m_nodes[right].m_min, m_nodes[right].m_max, growth,
+                                             aOrigin, inv_dir, best_distance);
+        // the farther child is pushed first, so the nearer one is visited first
+        if(left_distance < right_distance) {
+            if(right_distance != numeric_limits<float>::infinity())
+                stack[stack_size++] = {right, right_distance};
+            stack[stack_size++] = {left, left_distance};
+        } else {
+            if(left_distance != numeric_limits<float>::infinity())
+                stack[stack_size++] = {left, left_distance};
+            if(right_distance != numeric_limits<float>::infinity())
+                stack[stack_size++] = {right, right_distance};
+        }
+    }
+    if(!best_segment)
+        return false;
+
+    // the end of the segment nearer to the hit
+    const Vector3f begin = Eigen::Map<const Vector3f>(best_segment->m_begin);
+    const Vector3f end = Eigen::Map<const Vector3f>(best_segment->m_end);
+    const Vector3f point = aOrigin + best_distance * aDir;
+    const float length2 = (end - begin).squaredNorm();
+    const float t = length2 > 0.f ? (point - begin).dot(end - begin) / length2 : 1.f;
+    aHit.m_parent_index = best_segment->m_begin_node;
+    aHit.m_child_index = best_segment->m_end_node;
+    aHit.m_node_index = t < 0.5f ? best_segment->m_begin_node : best_segment->m_end_node;
+    aHit.m_distance = best_distance;
+    return true;
+}
@@ -0,0 +1,121 @@
+#ifndef CTREESEGMENTBVH_H
+#define CTREESEGMENTBVH_H
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "cdagtree.h"
+#include "cworkstealingpool.h"
+
+/*
+ * The closest segment of a tree hit by a ray, see CTreeSegmentBVH::intersect().
+*/
+struct CSegmentHit {
+    int m_node_index;           // the end node of the segment closest to the hit
+    int m_parent_index;         // the parent node the segment starts at
+    int m_child_index;          // the child node the segment ends at
+    float m_distance;           // the distance along the ray
+};
+
+/*
+ * A bounding volume hierarchy over the parent-child segments of a tree, for picking.
+ * Every node but the root makes a capsule from its parent to itself, with the larger
+ * of the two node radii. The hierarchy is split by the surface area heuristic over
+ * binned capsule centroids; the nodes are 32 bytes, the two children of a node are
+ * stored next to each other, and the capsules are stored in the order of the leaves.
+ * The tree's branches need not be extracted.
+*/
+class CTreeSegmentBVH
+{
+public:
+    CTreeSegmentBVH();
+    ~CTreeSegmentBVH();
+public:
+    /*
+     * Build the hierarchy over the segments of the tree, replacing the content.
+    */
+    void build(const CDAGTree<float>& aTree);
+    /*
+     * Build the hierarchy as build() does, on the given work-stealing pool.
+     * The subtrees of the hierarchy above a minimum size are built as separate tasks,
+     * so the hierarchy may be laid out differently from build(), but it holds the same capsules.
+    */
+    void build_parallel(const CDAGTree<float>& aTree, CWorkStealingPool& aPool);
+    void clear();
+    // exchange the hierarchy with aOther without copying it
+    void swap(CTreeSegmentBVH& aOther);
+
+    /*
+     * Find the closest capsule hit by the ray from aOrigin along the unit direction aDir,
+     * at a distance from 0 to aMaxDistance. Every capsule is at least aMinRadius thick,
+     * so that thin branches can be picked too.
+     * Returns false if no capsule is hit.
+    */
+    bool intersect(const Eigen::Vector3f& aOrigin, const Eigen::Vector3f& aDir, float aMinRadius,
+                   CSegmentHit& aHit, float aMaxDistance = std::numeric_limits<float>::max()) const;
+
+    size_t get_num_segments() const {
+        return m_segments.size();
+    }
+    size_t get_num_nodes() const {
+        return m_nodes.size();
+    }
+    // the bounding box of all the capsules, false if there is none
+    bool get_bounding_box(Eigen::Vector3f& aMin, Eigen::Vector3f& aMax) const;
+    // the depth of the deepest leaf, the root at depth 1
+    int get_depth() const {
+        return m_depth;
+    }
+protected:
+    struct CNode {
+        float m_min[3];
+        uint32_t m_index;       // the first capsule of a leaf, or the first of the two children
+        float m_max[3];
+        uint32_t m_count;       // the capsules of a leaf, 0 for an inner node
+    };
+    struct CSegment {
+        float m_begin[3];
+        float m_end[3];
+        float m_radius;
+        int m_begin_node;
+        int m_end_node;
+    };
+    /*
+     * The building of build() and build_parallel(), run on aPool if it is not null.
+    */
+    void generate(const CDAGTree<float>& aTree, CWorkStealingPool* aPool);
+    struct CBuildRef {
+        float m_min[3];
+        float m_max[3];
+        uint32_t m_segment;
+    };
+    // the box of some capsules and the box of their centroids
+    struct CBuildBounds {
+        Eigen::Vector3f m_min;
+        Eigen::Vector3f m_max;
+        Eigen::Vector3f m_centroid_min;
+        Eigen::Vector3f m_centroid_max;
+    };
+    /*
+     * Split the capsules [aBegin, aEnd) of m_build_refs, bounded by aBounds, under the
+     * node aNodeIndex, recursing into the children, or submitting them to aPool when
+     * they are large.
+    */
+    void build_node(uint32_t aNodeIndex, uint32_t aBegin, uint32_t aEnd, const CBuildBounds& aBounds,
+                    int aDepth, CWorkStealingPool* aPool);
+    static void reset_bounds(CBuildBounds& aBounds);
+    static void add_to_bounds(CBuildBounds& aBounds, const CBuildRef& aRef);
+    // raise the depth of the hierarchy to that of a new leaf
+    void update_depth(int aDepth);
+private:
+    std::vector<CNode> m_nodes;
+    std::vector<CSegment> m_segments;
+    int m_depth;
+    // the building state
+    std::vector<CBuildRef> m_build_refs;        // the capsules with their boxes in the order of the leaves
+    std::atomic<uint32_t> m_num_build_nodes;
+    std::atomic<int> m_build_depth;
+};
+
+#endif // CTREESEGMENTBVH_H
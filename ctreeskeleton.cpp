@@ -4,50 +4,110 @@
 #include <vector>
 using namespace std;
 
-CTreeSkeleton::CTreeSkeleton(const shared_ptr<CDAGTree<float>>& aTreePtr)
+CTreeSkeleton::CTreeSkeleton(const shared_ptr<CDAGTree<float>>& aTreePtr) :
+    m_num_culled_branches(0)
 {
-    // reserve memories for the arrays
-    m_first_indices.reserve(aTreePtr->get_total_num_of_branches());
-    m_count_vertices.reserve(aTreePtr->get_total_num_of_branches());
-    m_vertex_positions.reserve(3*aTreePtr->get_total_num_of_nodes());
-
     // create the tree skeleton
     create_tree_skeleton(aTreePtr);
+    create_buffers();
+}
+
+CTreeSkeleton::CTreeSkeleton(CTreeSkeletonArrays& aArrays, CTreeBranchLOD& aLod) :
+    m_num_culled_branches(0)
+{
+    m_arrays.swap(aArrays);
+    m_lod.swap(aLod);
+    create_buffers();
+}
 
-    // create the vertex array object and vertex buffer object
+void CTreeSkeleton::create_buffers() {
+    // create the vertex array object, the vertex buffer object and the element buffer object
+    const vector<float>& vertex_positions = m_arrays.get_vertex_positions();
+    const vector<uint32_t>& element_indices = m_arrays.get_element_indices();
     glGenVertexArrays(1, &m_vao);
     glGenBuffers(1, &m_vbo);
+    glGenBuffers(1, &m_ebo);
 
     glBindVertexArray(m_vao);
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
     glBufferData(GL_ARRAY_BUFFER,
-                 sizeof(float)*m_vertex_positions.size(),
-                 m_vertex_positions.data(),
+                 sizeof(float)*vertex_positions.size(),
+                 vertex_positions.data(),
                  GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
+    // the element buffer binding is part of the vertex array object state
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 sizeof(uint32_t)*element_indices.size(),
+                 element_indices.data(),
+                 GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    // the levels of detail index the same vertices
+    const vector<uint32_t>& lod_indices = m_lod.get_element_indices();
+    glGenVertexArrays(1, &m_lod_vao);
+    glGenBuffers(1, &m_lod_ebo);
+    glBindVertexArray(m_lod_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_lod_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 sizeof(uint32_t)*lod_indices.size(),
+                 lod_indices.data(),
+                 GL_STATIC_DRAW);
     glBindVertexArray(0);
 }
 
 CTreeSkeleton::~CTreeSkeleton(){
-    m_vertex_positions.clear();
+    m_arrays.clear();
     glDeleteBuffers(1, &m_vbo);
-    glDeleteBuffers(1, &m_vao);
+    glDeleteBuffers(1, &m_ebo);
+    glDeleteBuffers(1, &m_lod_ebo);
+    glDeleteVertexArrays(1, &m_vao);
+    glDeleteVertexArrays(1, &m_lod_vao);
 }
 
 
 void CTreeSkeleton::draw() {
-    glBindVertexArray(m_vao);
-    //glDrawArrays(GL_LINE_STRIP, 0, m_total_vertices);
-    glMultiDrawArrays(GL_LINE_STRIP,
-                      m_first_indices.data(),
-                      m_count_vertices.data(),
-                      m_first_indices.size()
-                      );
+    draw_elements(m_arrays.get_num_elements());
 }
 
 void CTreeSkeleton::draw_to_level(int aLevel) {
+    draw_elements(m_arrays.get_num_elements_to_level(aLevel));
+}
+
+size_t CTreeSkeleton::draw_lod(const Eigen::Vector3f& aEye, float aPixelScale, float aMaxPixelError,
+                               const CFrustum* aFrustum, int aLevel) {
+    m_lod_firsts.clear();
+    m_lod_counts.clear();
+    size_t num_elements = m_lod.select(aEye, aPixelScale, aMaxPixelError, aLevel, aFrustum,
+                                       m_lod_firsts, m_lod_counts, &m_num_culled_branches);
+    draw_lod_strips(m_lod_firsts, m_lod_counts);
+    return num_elements;
+}
 
+void CTreeSkeleton::draw_lod_strips(const vector<uint32_t>& aFirsts, const vector<int>& aCounts) {
+    if(aCounts.empty())
+        return;
+    // the first elements as byte offsets into the element buffer
+    m_lod_offsets.resize(aFirsts.size());
+    for(size_t i = 0; i < aFirsts.size(); ++i)
+        m_lod_offsets[i] = (const void*)(sizeof(uint32_t)*size_t(aFirsts[i]));
+    glBindVertexArray(m_lod_vao);
+    glMultiDrawElements(GL_LINE_STRIP, aCounts.data(), GL_UNSIGNED_INT,
+                        m_lod_offsets.data(), GLsizei(aCounts.size()));
+}
+
+void CTreeSkeleton::draw_elements(size_t aNumElements) {
+    if(aNumElements == 0)
+        return;
+    glBindVertexArray(m_vao);
+    // all the strips in one call, split at SKELETON_RESTART_INDEX
+    glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    glDrawElements(GL_LINE_STRIP, GLsizei(aNumElements), GL_UNSIGNED_INT, (void*)0);
+    glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
 }
 
 //void CTreeSkeleton::create_tree_skeleton(const shared_ptr<CDAGTree<float> > &aTreePtr) {
@@ -80,26 +140,7 @@ void CTreeSkeleton::draw_to_level(int aLevel) {
 //}
 
 void CTreeSkeleton::create_tree_skeleton(const shared_ptr<CDAGTree<float> > &aTreePtr) {
-    int vertex_count(0);
-    const vector<CBranchLevelSet<float>>& branch_set = aTreePtr->get_branches();
-    // the branches with the same tree level are stored in a branch set
-    // iterate through each branch set (bs) at different levels
-    for(const auto& bs : branch_set){
-        const vector<shared_ptr<CBranch<float>>>& branch_array = bs.get_branch_array();
-        // iterate through all the branches in the smae branch set
-        for(const auto& b : branch_array) {
-            // the start index of the first node in the current branch b
-            m_first_indices.push_back(vertex_count);
-            // the number of branch nodes for the current branch b
-            m_count_vertices.push_back(int(b->get_branch_nodes_nums()));
-
-            // iterate through all the branch nodes in the current branch
-            for(const auto& n : b->get_branch_nodes()) {
-                m_vertex_positions.push_back(n->m_x);
-                m_vertex_positions.push_back(n->m_y);
-                m_vertex_positions.push_back(n->m_z);
-                ++vertex_count;
-            }
-        }
-    }
+    // the vertex arrays are packed on the CPU, see CTreeSkeletonArrays
+    m_arrays.build(*aTreePtr);
+    m_lod.build(*aTreePtr);
 }
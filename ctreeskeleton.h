@@ -4,6 +4,8 @@
 #include <vector>
 #include <memory>
 #include "cdagtree.h"
+#include "ctreeskeletonarrays.h"
+#include "ctreebranchlod.h"
 
 
 /*
@@ -17,6 +19,11 @@ class CTreeSkeleton
 {
 public:
     CTreeSkeleton(const std::shared_ptr<CDAGTree<float>>& aTreePtr);
+    /*
+     * Create the skeleton from arrays and levels of detail already built, e.g. on a loader thread.
+     * The contents of aArrays and aLod are taken over.
+    */
+    CTreeSkeleton(CTreeSkeletonArrays& aArrays, CTreeBranchLOD& aLod);
     ~CTreeSkeleton();
     CTreeSkeleton(const CTreeSkeleton& aCopy)=delete;
     CTreeSkeleton& operator=(const CTreeSkeleton& aRhs)=delete;
@@ -27,20 +34,65 @@ public:
     void draw();
     /*
      * Draw the tree skeleton's branches with level less than and equal to
-     * the given level.
+     * the given level. The strips are grouped by level, so this is one draw
+     * call over a prefix of the elements.
     */
     void draw_to_level(int aLevel);
+    /*
+     * Draw the branches simplified to at most aMaxPixelError pixels as seen from aEye,
+     * see CTreeBranchLOD::select(). aPixelScale is the viewport height divided by
+     * 2*tan(fovy/2). A pixel error of 0 draws the full branches. If aLevel is above 0
+     * only the branches up to that level are drawn. If aFrustum is given the branches
+     * outside it are culled. The chosen strips are drawn with one glMultiDrawElements.
+     * Returns the number of elements drawn.
+    */
+    size_t draw_lod(const Eigen::Vector3f& aEye, float aPixelScale, float aMaxPixelError,
+                    const CFrustum* aFrustum = nullptr, int aLevel = 0);
+    /*
+     * Draw strips of the levels of detail already chosen by get_branch_lod().select(),
+     * e.g. on another thread, with one glMultiDrawElements.
+    */
+    void draw_lod_strips(const std::vector<uint32_t>& aFirsts, const std::vector<int>& aCounts);
+    // the levels of detail, unchanged once the skeleton is created
+    const CTreeBranchLOD& get_branch_lod() const {
+        return m_lod;
+    }
+    // the highest branch level of the skeleton
+    int get_num_levels() const {
+        return m_arrays.get_num_levels();
+    }
+    size_t get_num_branches() const {
+        return m_lod.get_num_branches();
+    }
+    // the branches culled by the frustum at the last draw_lod()
+    size_t get_num_culled_branches() const {
+        return m_num_culled_branches;
+    }
 protected:
     /*
      * Create a tree skeleton from the dagtree.
     */
     void create_tree_skeleton(const std::shared_ptr<CDAGTree<float>>& aTreePtr);
+    /*
+     * Upload the packed arrays into the vertex and element buffers.
+    */
+    void create_buffers();
+    /*
+     * Draw the first aNumElements elements as line strips with primitive restart.
+    */
+    void draw_elements(size_t aNumElements);
 private:
     unsigned m_vao;
     unsigned m_vbo;
-    std::vector<int> m_first_indices;
-    std::vector<int> m_count_vertices;
-    std::vector<float> m_vertex_positions;
+    unsigned m_ebo;
+    unsigned m_lod_vao;                 // m_vbo with the element buffer of the levels of detail
+    unsigned m_lod_ebo;
+    CTreeSkeletonArrays m_arrays;       // the vertex and element arrays uploaded to m_vbo and m_ebo
+    CTreeBranchLOD m_lod;               // the levels of detail uploaded to m_lod_ebo
+    std::vector<uint32_t> m_lod_firsts; // the strips chosen for the current frame
+    std::vector<int> m_lod_counts;
+    std::vector<const void*> m_lod_offsets;
+    size_t m_num_culled_branches;
 //    std::vector<unsigned> m_vbos;
 //    int m_total_vertices;
 //    std::vector<unsigned> m_vertex_indices;
@@ -0,0 +1,136 @@
+#include "ctreeskeletonarrays.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+using namespace std;
+
+CTreeSkeletonArrays::CTreeSkeletonArrays() : m_num_strips(0)
+{
+
+}
+
+CTreeSkeletonArrays::~CTreeSkeletonArrays() {
+    clear();
+}
+
+void CTreeSkeletonArrays::clear() {
+    m_vertex_positions.clear();
+    m_element_indices.clear();
+    m_level_element_ends.clear();
+    m_num_strips = 0;
+}
+
+void CTreeSkeletonArrays::swap(CTreeSkeletonArrays& aOther) {
+    m_vertex_positions.swap(aOther.m_vertex_positions);
+    m_element_indices.swap(aOther.m_element_indices);
+    m_level_element_ends.swap(aOther.m_level_element_ends);
+    std::swap(m_num_strips, aOther.m_num_strips);
+}
+
+void CTreeSkeletonArrays::build(const CDAGTree<float>& aTree) {
+    pack(aTree, nullptr);
+}
+
+void CTreeSkeletonArrays::build_parallel(const CDAGTree<float>& aTree, CWorkStealingPool& aPool) {
+    pack(aTree, &aPool);
+}
+
+void CTreeSkeletonArrays::pack(const CDAGTree<float>& aTree, CWorkStealingPool* aPool) {
+    // the smallest pieces of work worth a task
+    static const size_t MIN_CHUNK_BRANCHES = 1024;
+    static const size_t MIN_CHUNK_NODES = 65536;
+    clear();
+
+    // the branches in the order of the branch sets, each with its level from 0
+    struct CStripSource {
+        const CBranch<float>* m_branch;
+        size_t m_level;
+    };
+    vector<CStripSource> strips;
+    strips.reserve(aTree.get_total_num_of_branches());
+    size_t num_levels(0);
+    for(const auto& bs : aTree.get_branches()) {
+        for(const auto& b : bs.get_branch_array()) {
+            size_t level = size_t(max(b->get_branch_level(), 1)) - 1;
+            num_levels = max(num_levels, level + 1);
+            strips.push_back({b.get(), level});
+        }
+    }
+    m_num_strips = strips.size();
+
+    const size_t num_threads = aPool ? aPool->get_num_threads() : 1;
+    const size_t num_chunks = max<size_t>(1, min(4*num_threads, strips.size() / MIN_CHUNK_BRANCHES));
+    const size_t chunk_size = (strips.size() + num_chunks - 1) / max<size_t>(num_chunks, 1);
+    // run aTask(i) for i in [0, aCount), on the pool if there is one
+    auto run_tasks = [aPool](size_t aCount, const function<void(size_t)>& aTask) {
+        if(aPool == nullptr || aCount < 2) {
+            for(size_t i = 0; i < aCount; ++i)
+                aTask(i);
+            return;
+        }
+        for(size_t i = 0; i < aCount; ++i)
+            aPool->submit([&aTask, i]{ aTask(i); });
+        aPool->wait();
+    };
+
+    // the elements of every level in every chunk, a strip takes its nodes and one restart index
+    vector<size_t> chunk_level_elements(num_chunks*num_levels, 0);
+    run_tasks(num_chunks, [&](size_t c) {
+        size_t* level_elements = chunk_level_elements.data() + c*num_levels;
+        const size_t end = min(strips.size(), (c + 1)*chunk_size);
+        for(size_t i = c*chunk_size; i < end; ++i)
+            level_elements[strips[i].m_level] += strips[i].m_branch->get_branch_nodes_nums() + 1;
+    });
+
+    // the exclusive scan: the levels one after another, the chunks in order within a level
+    size_t num_elements(0);
+    m_level_element_ends.resize(num_levels);
+    for(size_t l = 0; l < num_levels; ++l) {
+        for(size_t c = 0; c < num_chunks; ++c) {
+            size_t count = chunk_level_elements[c*num_levels + l];
+            chunk_level_elements[c*num_levels + l] = num_elements;
+            num_elements += count;
+        }
+        // the restart index behind the last strip of the level is not drawn
+        m_level_element_ends[l] = num_elements > 0 ? num_elements - 1 : 0;
+    }
+
+    // one vertex per tree node, indexed by the node index
+    const size_t num_nodes = aTree.get_total_num_of_nodes();
+    m_vertex_positions.resize(3*num_nodes);
+    m_element_indices.resize(num_elements);
+    const size_t num_node_chunks = max<size_t>(1, min(4*num_threads, num_nodes / MIN_CHUNK_NODES));
+    const size_t node_chunk_size = (num_nodes + num_node_chunks - 1) / num_node_chunks;
+    const float* xs = aTree.get_node_xs().data();
+    const float* ys = aTree.get_node_ys().data();
+    const float* zs = aTree.get_node_zs().data();
+
+    // the strip chunks first, then the node chunks, all filled at their own offsets
+    run_tasks(num_chunks + num_node_chunks, [&](size_t t) {
+        if(t < num_chunks) {
+            size_t* element_cursors = chunk_level_elements.data() + t*num_levels;
+            const size_t end = min(strips.size(), (t + 1)*chunk_size);
+            for(size_t i = t*chunk_size; i < end; ++i) {
+                const pmr::vector<int>& branch_nodes = strips[i].m_branch->get_branch_nodes();
+                size_t& cursor = element_cursors[strips[i].m_level];
+                uint32_t* p = m_element_indices.data() + cursor;
+                for(int n : branch_nodes)
+                    *p++ = uint32_t(n);
+                *p = SKELETON_RESTART_INDEX;
+                cursor += branch_nodes.size() + 1;
+            }
+            return;
+        }
+        const size_t begin = (t - num_chunks)*node_chunk_size;
+        const size_t end = min(num_nodes, begin + node_chunk_size);
+        for(size_t i = begin; i < end; ++i) {
+            m_vertex_positions[3*i] = xs[i];
+            m_vertex_positions[3*i+1] = ys[i];
+            m_vertex_positions[3*i+2] = zs[i];
+        }
+    });
+    // the last element is the restart index of the last strip
+    if(!m_element_indices.empty())
+        m_element_indices.pop_back();
+}
@@ -0,0 +1,88 @@
+#ifndef CTREESKELETONARRAYS_H
+#define CTREESKELETONARRAYS_H
+
+#include <cstdint>
+#include <vector>
+#include "cdagtree.h"
+#include "cworkstealingpool.h"
+
+// the element separating two strips, the fixed primitive restart index of GL_UNSIGNED_INT
+static const uint32_t SKELETON_RESTART_INDEX = 0xFFFFFFFFu;
+
+/*
+ * The vertex arrays of a tree skeleton, built on the CPU without OpenGL.
+ * Every tree node is one vertex (x, y, z), at the index of the node in the tree,
+ * so a node shared by several branches, e.g. the branch root taken from the parent
+ * branch, is stored once. Every branch becomes a line strip of the element indices
+ * of its nodes, and the strips are separated by SKELETON_RESTART_INDEX in one element
+ * array, drawn with a single glDrawElements and primitive restart.
+ * The strips are grouped by branch level, the trunk first, keeping the order of the
+ * branch sets within a level. So the branches up to any level are a prefix of the
+ * elements and can be drawn with one call (see get_num_elements_to_level()).
+*/
+class CTreeSkeletonArrays
+{
+public:
+    CTreeSkeletonArrays();
+    ~CTreeSkeletonArrays();
+public:
+    /*
+     * Pack the branches of the tree into the vertex arrays, replacing their content.
+     * The branches must have been extracted.
+    */
+    void build(const CDAGTree<float>& aTree);
+    /*
+     * Pack the branches as build() does, on the given work-stealing pool.
+     * The branches are split into chunks and the element counts of every level are summed
+     * per chunk in parallel. An exclusive scan over these sums gives the offset at which
+     * every chunk writes each level, so the chunks and the vertex positions are then filled
+     * concurrently into the presized arrays. The arrays are identical to the ones of build().
+    */
+    void build_parallel(const CDAGTree<float>& aTree, CWorkStealingPool& aPool);
+    void clear();
+    // exchange the arrays with aOther without copying them
+    void swap(CTreeSkeletonArrays& aOther);
+
+    const std::vector<float>& get_vertex_positions() const {
+        return m_vertex_positions;
+    }
+    const std::vector<uint32_t>& get_element_indices() const {
+        return m_element_indices;
+    }
+    size_t get_num_strips() const {
+        return m_num_strips;
+    }
+    size_t get_num_vertices() const {
+        return m_vertex_positions.size() / 3;
+    }
+    size_t get_num_elements() const {
+        return m_element_indices.size();
+    }
+    // the highest branch level, 0 if there is no branch
+    int get_num_levels() const {
+        return int(m_level_element_ends.size());
+    }
+    /*
+     * The number of elements of the strips of the branches with a level less than
+     * or equal to aLevel, not counting the restart index behind the last strip.
+    */
+    size_t get_num_elements_to_level(int aLevel) const {
+        if(aLevel < 1)
+            return 0;
+        if(aLevel > get_num_levels())
+            return get_num_elements();
+        return size_t(m_level_element_ends[size_t(aLevel - 1)]);
+    }
+protected:
+    /*
+     * The packing of build() and build_parallel(), run on aPool if it is not null.
+    */
+    void pack(const CDAGTree<float>& aTree, CWorkStealingPool* aPool);
+private:
+    std::vector<float> m_vertex_positions;      // the positions of the tree nodes
+    std::vector<uint32_t> m_element_indices;    // the strips separated by SKELETON_RESTART_INDEX
+    std::vector<size_t> m_level_element_ends;   // the end of the last strip of every level, from level 1
+    size_t m_num_strips;
+};
+
+#endif // CTREESKELETONARRAYS_H
@@ -0,0 +1,86 @@
+#include "ctreestreamloader.h"
+
+#include <iostream>
+
+using namespace std;
+
+CTreeStreamLoader::CTreeStreamLoader() :
+    m_state(Idle),
+    m_is_cancelled(false),
+    m_num_nodes_loaded(0),
+    m_is_branch_cache_enabled(false)
+{
+
+}
+
+CTreeStreamLoader::~CTreeStreamLoader() {
+    cancel();
+    if(m_thread.joinable())
+        m_thread.join();
+}
+
+bool CTreeStreamLoader::start(const string& aFileName) {
+    if(get_state() != Idle)
+        return false;
+    m_state.store(Loading, memory_order_release);
+    m_thread = thread(&CTreeStreamLoader::run, this, aFileName);
+    return true;
+}
+
+void CTreeStreamLoader::cancel() {
+    m_is_cancelled.store(true, memory_order_relaxed);
+}
+
+size_t CTreeStreamLoader::take_segments(vector<float>& aVertices) {
+    lock_guard<mutex> lock(m_segments_mutex);
+    size_t num_segments = m_pending_segments.size() / 6;
+    aVertices.insert(aVertices.end(), m_pending_segments.begin(), m_pending_segments.end());
+    m_pending_segments.clear();
+    return num_segments;
+}
+
+void CTreeStreamLoader::run(const string& aFileName) {
+    m_tree_ptr.reset(new CDAGTree<float>());
+    // the source file is hashed by the branch extraction, after the last segments are queued
+    m_tree_ptr->set_branch_cache_enabled(m_is_branch_cache_enabled);
+    m_tree_ptr->set_load_progress_callback([this](int aBegin, int aEnd) {
+        return queue_segments(aBegin, aEnd);
+    });
+    if(!m_tree_ptr->load_tree_file(aFileName)) {
+        if(!m_is_cancelled.load(memory_order_relaxed))
+            cerr << "Failed read the tree file " << aFileName << "\n";
+        m_state.store(Failed, memory_order_release);
+        return;
+    }
+    m_tree_ptr->set_load_progress_callback(nullptr);
+
+    m_state.store(Extracting, memory_order_release);
+    m_tree_ptr->extract_branches();
+    m_skeleton_arrays.build(*m_tree_ptr);
+    m_branch_lod.build(*m_tree_ptr);
+    m_state.store(Finished, memory_order_release);
+}
+
+bool CTreeStreamLoader::queue_segments(int aBegin, int aEnd) {
+    if(m_is_cancelled.load(memory_order_relaxed))
+        return false;
+    // build the batch without the lock, so the rendering thread is never kept waiting for the parser
+    const CDAGTree<float>& a_tree = *m_tree_ptr;
+    m_batch_segments.clear();
+    for(int i = aBegin; i < aEnd; ++i) {
+        int parent_index = a_tree.get_parent_index(i);
+        if(parent_index < 0)
+            continue;
+        const float segment[6] = {
+            a_tree.get_node_x(parent_index), a_tree.get_node_y(parent_index), a_tree.get_node_z(parent_index),
+            a_tree.get_node_x(i), a_tree.get_node_y(i), a_tree.get_node_z(i)
+        };
+        m_batch_segments.insert(m_batch_segments.end(), segment, segment + 6);
+    }
+    {
+        lock_guard<mutex> lock(m_segments_mutex);
+        m_pending_segments.insert(m_pending_segments.end(), m_batch_segments.begin(), m_batch_segments.end());
+    }
+    m_num_nodes_loaded.store(size_t(aEnd), memory_order_relaxed);
+    return true;
+}
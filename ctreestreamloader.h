@@ -0,0 +1,100 @@
+#ifndef CTREESTREAMLOADER_H
+#define CTREESTREAMLOADER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cdagtree.h"
+#include "ctreeskeletonarrays.h"
+#include "ctreebranchlod.h"
+
+/*
+ * Load a tree file on a background thread, so that the tree can be shown while it is read.
+ * While the file is parsed, every node is turned into the line segment from its parent
+ * to itself, and the segments are queued for the rendering thread to take in batches.
+ * Once the file is read, the branches are extracted and packed into skeleton arrays
+ * and levels of detail on the same thread, ready to replace the segments.
+ * No OpenGL call is made here.
+*/
+class CTreeStreamLoader
+{
+public:
+    enum State {
+        Idle,           // not started
+        Loading,        // parsing the file, the segments are streaming in
+        Extracting,     // the file is read, the branches are being extracted
+        Finished,       // the tree and the skeleton arrays are ready
+        Failed          // the file could not be read, or the load was cancelled
+    };
+public:
+    CTreeStreamLoader();
+    // cancels a running load and waits for the thread
+    ~CTreeStreamLoader();
+    CTreeStreamLoader(const CTreeStreamLoader&)=delete;
+    CTreeStreamLoader& operator=(const CTreeStreamLoader&)=delete;
+public:
+    /*
+     * Start loading the tree file on the background thread.
+     * Returns false if a load has already been started.
+    */
+    bool start(const std::string& aFileName);
+    /*
+     * Read and write the branch cache next to the tree file (see CDAGTree::set_branch_cache_enabled()).
+     * Disabled by default. Set before start().
+    */
+    void set_branch_cache_enabled(bool aEnabled) {
+        m_is_branch_cache_enabled = aEnabled;
+    }
+    /*
+     * Stop parsing as soon as possible. The load then ends in the Failed state.
+    */
+    void cancel();
+    State get_state() const {
+        return m_state.load(std::memory_order_acquire);
+    }
+    size_t get_num_nodes_loaded() const {
+        return m_num_nodes_loaded.load(std::memory_order_relaxed);
+    }
+    /*
+     * Move the segments parsed since the last call to the end of aVertices,
+     * two vertices (x, y, z each) per segment. Returns the number of segments moved.
+    */
+    size_t take_segments(std::vector<float>& aVertices);
+    /*
+     * The loaded tree with its branches, and the skeleton arrays and levels of detail built from them.
+     * Only valid in the Finished state.
+    */
+    const std::shared_ptr<CDAGTree<float>>& get_tree() const {
+        return m_tree_ptr;
+    }
+    CTreeSkeletonArrays& get_skeleton_arrays() {
+        return m_skeleton_arrays;
+    }
+    CTreeBranchLOD& get_branch_lod() {
+        return m_branch_lod;
+    }
+protected:
+    void run(const std::string& aFileName);
+    /*
+     * Queue the segments of the nodes [aBegin, aEnd) of the tree being loaded.
+    */
+    bool queue_segments(int aBegin, int aEnd);
+private:
+    std::thread m_thread;
+    std::atomic<State> m_state;
+    std::atomic<bool> m_is_cancelled;
+    std::atomic<size_t> m_num_nodes_loaded;
+    bool m_is_branch_cache_enabled;
+    std::mutex m_segments_mutex;
+    std::vector<float> m_pending_segments;          // the segments not yet taken, guarded by m_segments_mutex
+    std::vector<float> m_batch_segments;            // the segments of the batch being queued, loader thread only
+    std::shared_ptr<CDAGTree<float>> m_tree_ptr;    // written by the loader thread until Finished
+    CTreeSkeletonArrays m_skeleton_arrays;
+    CTreeBranchLOD m_branch_lod;
+};
+
+#endif // CTREESTREAMLOADER_H
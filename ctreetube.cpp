@@ -0,0 +1,48 @@
+#include "ctreetube.h"
+#include "GL/glew.h"
+
+#include <vector>
+using namespace std;
+
+CTreeTube::CTreeTube(CTreeTubeMesh& aMesh)
+{
+    // the mesh is only needed until it is uploaded
+    CTreeTubeMesh a_mesh;
+    a_mesh.swap(aMesh);
+    m_num_indices = a_mesh.get_indices().size();
+
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(2, m_vbos);
+    glGenBuffers(1, &m_ebo);
+
+    glBindVertexArray(m_vao);
+    const vector<float>* attributes[2] = {&a_mesh.get_positions(), &a_mesh.get_normals()};
+    for(unsigned i = 0; i < 2; ++i) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbos[i]);
+        glBufferData(GL_ARRAY_BUFFER,
+                     sizeof(float)*attributes[i]->size(),
+                     attributes[i]->data(),
+                     GL_STATIC_DRAW);
+        glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
+        glEnableVertexAttribArray(i);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 sizeof(uint32_t)*m_num_indices,
+                 a_mesh.get_indices().data(),
+                 GL_STATIC_DRAW);
+    glBindVertexArray(0);
+}
+
+CTreeTube::~CTreeTube() {
+    glDeleteBuffers(2, m_vbos);
+    glDeleteBuffers(1, &m_ebo);
+    glDeleteVertexArrays(1, &m_vao);
+}
+
+void CTreeTube::draw() {
+    if(m_num_indices == 0)
+        return;
+    glBindVertexArray(m_vao);
+    glDrawElements(GL_TRIANGLES, GLsizei(m_num_indices), GL_UNSIGNED_INT, (void*)0);
+}
@@ -0,0 +1,34 @@
+#ifndef CTREETUBE_H
+#define CTREETUBE_H
+
+#include "ctreetubemesh.h"
+
+/*
+ * The tube mesh of a tree (see CTreeTubeMesh) rendered in OpenGL.
+ * The positions go to attribute 0 and the normals to attribute 1,
+ * and the triangles are drawn with one glDrawElements.
+*/
+class CTreeTube
+{
+public:
+    /*
+     * Upload the mesh. The content of aMesh is taken over.
+    */
+    explicit CTreeTube(CTreeTubeMesh& aMesh);
+    ~CTreeTube();
+    CTreeTube(const CTreeTube& aCopy)=delete;
+    CTreeTube& operator=(const CTreeTube& aRhs)=delete;
+public:
+    void draw();
+
+    size_t get_num_triangles() const {
+        return m_num_indices / 3;
+    }
+private:
+    unsigned m_vao;
+    unsigned m_vbos[2];         // the positions and the normals
+    unsigned m_ebo;
+    size_t m_num_indices;
+};
+
+#endif // CTREETUBE_H
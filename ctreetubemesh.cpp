@@ -0,0 +1,181 @@
+#include "ctreetubemesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+using namespace std;
+
+typedef Eigen::Vector3f Vector3f;
+
+// the squared lengths below which a segment or a tangent change counts as zero
+static const float TUBE_EPSILON = 1e-12f;
+
+CTreeTubeMesh::CTreeTubeMesh() : m_radial_segments(0)
+{
+
+}
+
+CTreeTubeMesh::~CTreeTubeMesh() {
+    clear();
+}
+
+void CTreeTubeMesh::clear() {
+    m_positions.clear();
+    m_normals.clear();
+    m_indices.clear();
+}
+
+void CTreeTubeMesh::swap(CTreeTubeMesh& aOther) {
+    m_positions.swap(aOther.m_positions);
+    m_normals.swap(aOther.m_normals);
+    m_indices.swap(aOther.m_indices);
+    std::swap(m_radial_segments, aOther.m_radial_segments);
+    m_ring_cosines.swap(aOther.m_ring_cosines);
+    m_ring_sines.swap(aOther.m_ring_sines);
+}
+
+void CTreeTubeMesh::build(const CDAGTree<float>& aTree, int aRadialSegments) {
+    generate(aTree, aRadialSegments, nullptr);
+}
+
+void CTreeTubeMesh::build_parallel(const CDAGTree<float>& aTree, CWorkStealingPool& aPool, int aRadialSegments) {
+    generate(aTree, aRadialSegments, &aPool);
+}
+
+void CTreeTubeMesh::generate(const CDAGTree<float>& aTree, int aRadialSegments, CWorkStealingPool* aPool) {
+    // the smallest number of branches worth a task
+    static const size_t MIN_CHUNK_BRANCHES = 256;
+    clear();
+    m_radial_segments = max(aRadialSegments, 3);
+    const size_t num_segments = size_t(m_radial_segments);
+    m_ring_cosines.resize(num_segments);
+    m_ring_sines.resize(num_segments);
+    for(size_t k = 0; k < num_segments; ++k) {
+        double angle = 2.0 * M_PI * double(k) / double(num_segments);
+        m_ring_cosines[k] = float(cos(angle));
+        m_ring_sines[k] = float(sin(angle));
+    }
+
+    // the first vertex and the first index of every tube, an exclusive scan over the branch sizes
+    vector<const pmr::vector<int>*> branches;
+    vector<size_t> first_vertices, first_indices;
+    branches.reserve(aTree.get_total_num_of_branches());
+    first_vertices.reserve(aTree.get_total_num_of_branches() + 1);
+    first_indices.reserve(aTree.get_total_num_of_branches() + 1);
+    size_t num_vertices(0), num_indices(0);
+    for(const auto& bs : aTree.get_branches()) {
+        for(const auto& b : bs.get_branch_array()) {
+            const size_t num_nodes = b->get_branch_nodes_nums();
+            // a single node makes no tube
+            if(num_nodes < 2)
+                continue;
+            branches.push_back(&b->get_branch_nodes());
+            first_vertices.push_back(num_vertices);
+            first_indices.push_back(num_indices);
+            num_vertices += num_nodes * num_segments;
+            num_indices += (num_nodes - 1) * num_segments * 6;
+        }
+    }
+    m_positions.resize(3*num_vertices);
+    m_normals.resize(3*num_vertices);
+    m_indices.resize(num_indices);
+
+    const size_t num_threads = aPool ? aPool->get_num_threads() : 1;
+    const size_t num_chunks = max<size_t>(1, min(4*num_threads, branches.size() / MIN_CHUNK_BRANCHES));
+    const size_t chunk_size = (branches.size() + num_chunks - 1) / num_chunks;
+    auto generate_chunk = [&](size_t c) {
+        const size_t end = min(branches.size(), (c + 1)*chunk_size);
+        for(size_t i = c*chunk_size; i < end; ++i)
+            generate_branch(aTree, *branches[i], first_vertices[i], first_indices[i]);
+    };
+    if(aPool == nullptr || num_chunks < 2) {
+        for(size_t c = 0; c < num_chunks; ++c)
+            generate_chunk(c);
+    } else {
+        for(size_t c = 0; c < num_chunks; ++c)
+            aPool->submit([&generate_chunk, c]{ generate_chunk(c); });
+        aPool->wait();
+    }
+}
+
+void CTreeTubeMesh::generate_branch(const CDAGTree<float>& aTree, const pmr::vector<int>& aBranchNodes,
+                                    size_t aFirstVertex, size_t aFirstIndex) {
+    const size_t num_nodes = aBranchNodes.size();
+    const size_t num_segments = size_t(m_radial_segments);
+    // the tangent at a node, along its neighbouring nodes
+    auto tangent_at = [&](size_t i) {
+        Vector3f a_tangent = aTree.get_node_position(aBranchNodes[min(i + 1, num_nodes - 1)])
+                           - aTree.get_node_position(aBranchNodes[i > 0 ? i - 1 : 0]);
+        float length = a_tangent.norm();
+        return length > 0.f ? Vector3f(a_tangent / length) : Vector3f(0.f, 1.f, 0.f);
+    };
+
+    Vector3f prev_position = aTree.get_node_position(aBranchNodes[0]);
+    Vector3f prev_tangent = tangent_at(0);
+    // the first frame normal, from the axis furthest from the tangent
+    Vector3f axis(0.f, 0.f, 0.f);
+    int min_axis(0);
+    prev_tangent.cwiseAbs().minCoeff(&min_axis);
+    axis[min_axis] = 1.f;
+    Vector3f frame_normal = (axis - axis.dot(prev_tangent) * prev_tangent).normalized();
+
+    float* positions = m_positions.data() + 3*aFirstVertex;
+    float* normals = m_normals.data() + 3*aFirstVertex;
+    for(size_t i = 0; i < num_nodes; ++i) {
+        const Vector3f position = aTree.get_node_position(aBranchNodes[i]);
+        const Vector3f a_tangent = i == 0 ? prev_tangent : tangent_at(i);
+        if(i > 0) {
+            // double reflection: reflect the frame across the plane between the two nodes,
+            // then across the plane between the reflected and the new tangent
+            Vector3f reflected_normal(frame_normal), reflected_tangent(prev_tangent);
+            const Vector3f v1 = position - prev_position;
+            const float c1 = v1.dot(v1);
+            if(c1 > TUBE_EPSILON) {
+                reflected_normal -= (2.f / c1) * v1.dot(frame_normal) * v1;
+                reflected_tangent -= (2.f / c1) * v1.dot(prev_tangent) * v1;
+            }
+            const Vector3f v2 = a_tangent - reflected_tangent;
+            const float c2 = v2.dot(v2);
+            frame_normal = reflected_normal;
+            if(c2 > TUBE_EPSILON)
+                frame_normal -= (2.f / c2) * v2.dot(reflected_normal) * v2;
+            // keep the frame orthonormal against the rounding errors
+            Vector3f orthogonal = frame_normal - frame_normal.dot(a_tangent) * a_tangent;
+            if(orthogonal.squaredNorm() > TUBE_EPSILON)
+                frame_normal = orthogonal.normalized();
+        }
+        const Vector3f frame_binormal = a_tangent.cross(frame_normal);
+        const float radius = aTree.get_node_radius(aBranchNodes[i]);
+        for(size_t k = 0; k < num_segments; ++k) {
+            const Vector3f direction = m_ring_cosines[k] * frame_normal + m_ring_sines[k] * frame_binormal;
+            const Vector3f vertex = position + radius * direction;
+            *positions++ = vertex.x();
+            *positions++ = vertex.y();
+            *positions++ = vertex.z();
+            *normals++ = direction.x();
+            *normals++ = direction.y();
+            *normals++ = direction.z();
+        }
+        prev_position = position;
+        prev_tangent = a_tangent;
+    }
+
+    // two triangles per quad between neighbouring rings, counter-clockwise seen from outside
+    uint32_t* indices = m_indices.data() + aFirstIndex;
+    for(size_t i = 0; i + 1 < num_nodes; ++i) {
+        const uint32_t ring = uint32_t(aFirstVertex + i*num_segments);
+        for(size_t k = 0; k < num_segments; ++k) {
+            const uint32_t a = ring + uint32_t(k);
+            const uint32_t b = ring + uint32_t((k + 1) % num_segments);
+            const uint32_t c = a + uint32_t(num_segments);
+            const uint32_t d = b + uint32_t(num_segments);
+            *indices++ = a;
+            *indices++ = b;
+            *indices++ = c;
+            *indices++ = b;
+            *indices++ = d;
+            *indices++ = c;
+        }
+    }
+}
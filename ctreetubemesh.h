@@ -0,0 +1,78 @@
+#ifndef CTREETUBEMESH_H
+#define CTREETUBEMESH_H
+
+#include <cstdint>
+#include <vector>
+#include "cdagtree.h"
+#include "cworkstealingpool.h"
+
+/*
+ * A triangle mesh of the branches of a tree, built on the CPU without OpenGL.
+ * Every branch with at least two nodes becomes a generalized cylinder: a ring of
+ * vertices around each node, at the radius of the node, joined to the next ring by
+ * quads of two triangles. The rings are oriented by frames transported along the
+ * branch (double reflection), so the tube does not twist where the branch bends.
+ * The tubes are open at both ends. The positions and normals (x, y, z per vertex)
+ * and the triangle indices of all the branches are packed into contiguous arrays,
+ * the branches in the order of the branch sets.
+*/
+class CTreeTubeMesh
+{
+public:
+    CTreeTubeMesh();
+    ~CTreeTubeMesh();
+public:
+    /*
+     * Build the tubes of the extracted branches of the tree, replacing the content.
+     * aRadialSegments is the number of vertices of every ring, at least 3.
+    */
+    void build(const CDAGTree<float>& aTree, int aRadialSegments = 8);
+    /*
+     * Build the tubes as build() does, on the given work-stealing pool.
+     * The vertex and index offsets of every branch are summed up first, so the
+     * branches are then written concurrently into the preallocated arrays.
+     * The arrays are identical to the ones of build().
+    */
+    void build_parallel(const CDAGTree<float>& aTree, CWorkStealingPool& aPool, int aRadialSegments = 8);
+    void clear();
+    // exchange the arrays with aOther without copying them
+    void swap(CTreeTubeMesh& aOther);
+
+    const std::vector<float>& get_positions() const {
+        return m_positions;
+    }
+    const std::vector<float>& get_normals() const {
+        return m_normals;
+    }
+    const std::vector<uint32_t>& get_indices() const {
+        return m_indices;
+    }
+    size_t get_num_vertices() const {
+        return m_positions.size() / 3;
+    }
+    size_t get_num_triangles() const {
+        return m_indices.size() / 3;
+    }
+    int get_radial_segments() const {
+        return m_radial_segments;
+    }
+protected:
+    /*
+     * The building of build() and build_parallel(), run on aPool if it is not null.
+    */
+    void generate(const CDAGTree<float>& aTree, int aRadialSegments, CWorkStealingPool* aPool);
+    /*
+     * Write the rings and triangles of one branch from the given vertex and index offsets.
+    */
+    void generate_branch(const CDAGTree<float>& aTree, const std::pmr::vector<int>& aBranchNodes,
+                         size_t aFirstVertex, size_t aFirstIndex);
+private:
+    std::vector<float> m_positions;
+    std::vector<float> m_normals;           // the unit normals of the vertices
+    std::vector<uint32_t> m_indices;        // three vertex indices per triangle
+    int m_radial_segments;
+    std::vector<float> m_ring_cosines;      // the cosine and sine of every vertex angle of a ring
+    std::vector<float> m_ring_sines;
+};
+
+#endif // CTREETUBEMESH_H
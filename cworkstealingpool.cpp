@@ -0,0 +1,101 @@
+#include "cworkstealingpool.h"
+
+using namespace std;
+
+namespace {
+// the pool and the worker index of the current thread, if it is a worker
+thread_local const CWorkStealingPool* t_worker_pool = nullptr;
+thread_local unsigned t_worker_index = 0;
+}
+
+CWorkStealingPool::CWorkStealingPool(unsigned aNumThreads)
+    : m_num_queued(0), m_num_pending(0), m_next_deque(0), m_is_stopping(false)
+{
+    if(aNumThreads == 0)
+        aNumThreads = max(1u, thread::hardware_concurrency());
+    for(unsigned i = 0; i < aNumThreads; ++i)
+        m_deques.emplace_back(new CTaskDeque());
+    for(unsigned i = 0; i < aNumThreads; ++i)
+        m_workers.emplace_back(&CWorkStealingPool::worker_loop, this, i);
+}
+
+CWorkStealingPool::~CWorkStealingPool() {
+    wait();
+    {
+        lock_guard<mutex> lock(m_sleep_mutex);
+        m_is_stopping = true;
+    }
+    m_work_available.notify_all();
+    for(auto& w : m_workers)
+        w.join();
+}
+
+void CWorkStealingPool::submit(function<void()> aTask) {
+    unsigned target = (t_worker_pool == this)
+            ? t_worker_index
+            : m_next_deque.fetch_add(1, memory_order_relaxed) % unsigned(m_deques.size());
+    m_num_pending.fetch_add(1);
+    {
+        // counted before the push so the count never drops below zero, and under the
+        // lock so that a worker can not miss the wake-up between its check and its wait
+        lock_guard<mutex> lock(m_sleep_mutex);
+        m_num_queued.fetch_add(1);
+    }
+    {
+        lock_guard<mutex> lock(m_deques[target]->m_mutex);
+        m_deques[target]->m_tasks.push_back(move(aTask));
+    }
+    m_work_available.notify_one();
+}
+
+void CWorkStealingPool::wait() {
+    unique_lock<mutex> lock(m_sleep_mutex);
+    m_all_done.wait(lock, [this]{ return m_num_pending.load() == 0; });
+}
+
+bool CWorkStealingPool::take_task(unsigned aWorkerIndex, function<void()>& aTask) {
+    // the newest task of the own deque
+    {
+        CTaskDeque& own = *m_deques[aWorkerIndex];
+        lock_guard<mutex> lock(own.m_mutex);
+        if(!own.m_tasks.empty()) {
+            aTask = move(own.m_tasks.back());
+            own.m_tasks.pop_back();
+            return true;
+        }
+    }
+    // the oldest task of another deque
+    const unsigned num_deques = unsigned(m_deques.size());
+    for(unsigned k = 1; k < num_deques; ++k) {
+        CTaskDeque& victim = *m_deques[(aWorkerIndex + k) % num_deques];
+        lock_guard<mutex> lock(victim.m_mutex);
+        if(!victim.m_tasks.empty()) {
+            aTask = move(victim.m_tasks.front());
+            victim.m_tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void CWorkStealingPool::worker_loop(unsigned aWorkerIndex) {
+    t_worker_pool = this;
+    t_worker_index = aWorkerIndex;
+    function<void()> a_task;
+    while(true) {
+        if(take_task(aWorkerIndex, a_task)) {
+            m_num_queued.fetch_sub(1);
+            a_task();
+            a_task = nullptr;
+            if(m_num_pending.fetch_sub(1) == 1) {
+                lock_guard<mutex> lock(m_sleep_mutex);
+                m_all_done.notify_all();
+            }
+            continue;
+        }
+        unique_lock<mutex> lock(m_sleep_mutex);
+        m_work_available.wait(lock, [this]{ return m_is_stopping || m_num_queued.load() > 0; });
+        if(m_is_stopping && m_num_queued.load() == 0)
+            return;
+    }
+}
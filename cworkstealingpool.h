@@ -0,0 +1,68 @@
+#ifndef CWORKSTEALINGPOOL_H
+#define CWORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * A fixed-size thread pool where every worker owns a task deque.
+ * A task submitted from a worker thread goes to the back of that worker's deque
+ * and is popped from the back again (LIFO), which keeps a task and its subtasks
+ * on one core. An idle worker steals from the front of the other deques (FIFO),
+ * i.e. it takes the oldest and usually largest pending work.
+ * Tasks submitted from other threads are spread over the deques round-robin.
+*/
+class CWorkStealingPool
+{
+public:
+    /*
+     * Start the given number of worker threads, at least one.
+     * Zero means one worker per hardware thread.
+    */
+    explicit CWorkStealingPool(unsigned aNumThreads = 0);
+    ~CWorkStealingPool();
+    CWorkStealingPool(const CWorkStealingPool&)=delete;
+    CWorkStealingPool& operator=(const CWorkStealingPool&)=delete;
+public:
+    /*
+     * Queue a task. Tasks may submit further tasks.
+    */
+    void submit(std::function<void()> aTask);
+    /*
+     * Block until every submitted task, including the ones submitted by tasks, has finished.
+    */
+    void wait();
+
+    unsigned get_num_threads() const {
+        return unsigned(m_workers.size());
+    }
+protected:
+    void worker_loop(unsigned aWorkerIndex);
+    /*
+     * Pop a task from the own deque, or steal one from another deque.
+     * Returns false if all the deques are empty.
+    */
+    bool take_task(unsigned aWorkerIndex, std::function<void()>& aTask);
+private:
+    struct CTaskDeque {
+        std::mutex m_mutex;
+        std::deque<std::function<void()>> m_tasks;
+    };
+    std::vector<std::unique_ptr<CTaskDeque>> m_deques;  // one deque per worker
+    std::vector<std::thread> m_workers;
+    std::atomic<size_t> m_num_queued;                   // the tasks waiting in the deques
+    std::atomic<size_t> m_num_pending;                  // the tasks queued or running
+    std::atomic<unsigned> m_next_deque;                 // the round-robin target of external submits
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_work_available;           // signalled when a task is queued or on stop
+    std::condition_variable m_all_done;                 // signalled when no task is pending
+    bool m_is_stopping;
+};
+
+#endif // CWORKSTEALINGPOOL_H
@@ -5,6 +5,17 @@ using namespace std;
 
 int main(int argc, char** argv)
 {
+    // --forest <file> shows the placed trees of a forest file
+    // --frame-stats <file> appends the frame time percentiles to a file as JSON lines
+    // --branch-cache reads and writes the extracted branches next to the tree files
+    for(int i = 1; i < argc; ++i) {
+        if(string(argv[i]) == "--forest" && i + 1 < argc)
+            CGLScene::set_forest_file(argv[i+1]);
+        else if(string(argv[i]) == "--frame-stats" && i + 1 < argc)
+            CGLScene::set_frame_stats_file(argv[i+1]);
+        else if(string(argv[i]) == "--branch-cache")
+            CGLScene::set_branch_cache_enabled(true);
+    }
 
     CGLScene gl_scene(800, 600);
     gl_scene.setup(&argc, argv);